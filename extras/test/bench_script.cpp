@@ -0,0 +1,37 @@
+/**
+ * bench_script.cpp - Script interpreter speed
+ *
+ * Runs a tight counting loop through serviceScript(), one slice of
+ * AT_SCRIPT_SLICE_OPS instructions per call as in handleATCommands(), and
+ * reports the instructions executed per second of host wall time.
+ */
+
+#include <chrono>
+#include "MoeSimpleATInternal.h"
+
+int main() {
+    initATCommands();
+
+    // 9 instructions per iteration
+    registerScript("bench", "while i < 2000000; let i = i + 1; end");
+
+    ScriptStats before = getScriptStats();
+    if (!runScript("bench")) {
+        printf("bench_script: failed to start\n");
+        return 1;
+    }
+
+    unsigned long calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (isScriptRunning()) {
+        serviceScript();
+        calls++;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint32_t ops = getScriptStats().ops - before.ops;
+    printf("bench_script: %lu ops in %lu calls, %.1f ms, %.2f Mops/s, %.1f ns/op\n",
+           (unsigned long)ops, calls, seconds * 1000, ops / seconds / 1e6, seconds * 1e9 / ops);
+    return getScriptStats().errors == before.errors ? 0 : 1;
+}
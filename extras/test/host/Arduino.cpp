@@ -0,0 +1,27 @@
+/**
+ * Arduino.cpp - Host stand-in for the Arduino core (see Arduino.h)
+ */
+
+#include "Arduino.h"
+#include <cstdarg>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+unsigned long hostNowUs = 0;
+
+unsigned long millis() { return hostNowUs / 1000; }
+unsigned long micros() { return hostNowUs; }
+void delay(unsigned long ms) { hostNowUs += ms * 1000; }
+void delayMicroseconds(unsigned int us) { hostNowUs += us; }
+void yield() {}
+
+size_t Print::printf(const char* fmt, ...) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    return write(buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
@@ -0,0 +1,204 @@
+/**
+ * Arduino.h - Host stand-in for the Arduino core subset used by MoeSimpleAT
+ *
+ * Only for the host tests in extras/test. Serial is an in-memory port:
+ * feed() queues input, take() returns and clears what was written; the
+ * driver calls and the rate of each written byte are recorded too. Time
+ * only moves when a test calls delay() / delayMicroseconds().
+ */
+
+#ifndef MOE_SIMPLE_AT_HOST_ARDUINO_H
+#define MOE_SIMPLE_AT_HOST_ARDUINO_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <string>
+#include <deque>
+#include <vector>
+#include <unistd.h>
+
+typedef uint8_t byte;
+#define F(x) (x)
+#define SERIAL_8N1 0x800001c
+#define SERIAL_8N2 0x800003c
+#define SERIAL_7N1 0x8000018
+#define SERIAL_8E1 0x800001e
+#define SERIAL_8O1 0x800001f
+#define SERIAL_5N1 0x8000010
+#define SERIAL_6N1 0x8000014
+#define SERIAL_7N2 0x8000038
+#define SERIAL_8E2 0x800003e
+#define SERIAL_8O2 0x800003f
+#define SERIAL_7E1 0x800001a
+#define SERIAL_7O1 0x800001b
+#define SERIAL_7E2 0x800003a
+#define SERIAL_7O2 0x800003b
+#define SERIAL_5N2 0x8000030
+#define SERIAL_6N2 0x8000034
+#define SERIAL_5E1 0x8000012
+#define SERIAL_5O1 0x8000013
+#define SERIAL_6E1 0x8000016
+#define SERIAL_6O1 0x8000017
+#define SERIAL_5E2 0x8000032
+#define SERIAL_5O2 0x8000033
+#define SERIAL_6E2 0x8000036
+#define SERIAL_6O2 0x8000037
+#define DEC 10
+#define HEX 16
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+inline bool isDigit(int c) { return c >= 0x30 && c <= 0x39; }
+inline bool isSpace(int c) { return isspace(c); }
+inline bool isPrintable(int c) { return c >= 32 && c < 127; }
+extern unsigned long hostNowUs;
+
+class String {
+public:
+    std::string s;
+    String() {}
+    String(const char* c) : s(c ? c : "") {}
+    String(const std::string& x) : s(x) {}
+    String(char c) : s(1, c) {}
+    String(int v, unsigned char base = 10) { fromLong(v, base); }
+    String(unsigned int v, unsigned char base = 10) { fromULong(v, base); }
+    String(long v, unsigned char base = 10) { fromLong(v, base); }
+    String(unsigned long v, unsigned char base = 10) { fromULong(v, base); }
+    String(double v, unsigned char dec = 2) { char b[64]; snprintf(b, sizeof b, "%.*f", dec, v); s = b; }
+    void fromLong(long v, int base) { char b[40]; if (base == 16) snprintf(b, sizeof b, "%lx", v); else snprintf(b, sizeof b, "%ld", v); s = b; }
+    void fromULong(unsigned long v, int base) { char b[40]; if (base == 16) snprintf(b, sizeof b, "%lx", v); else snprintf(b, sizeof b, "%lu", v); s = b; }
+    unsigned int length() const { return s.size(); }
+    const char* c_str() const { return s.c_str(); }
+    bool reserve(unsigned int n) { s.reserve(n); return true; }
+    bool isEmpty() const { return s.empty(); }
+    void trim() { size_t a = 0; while (a < s.size() && isspace((unsigned char)s[a])) a++; size_t b = s.size(); while (b > a && isspace((unsigned char)s[b-1])) b--; s = s.substr(a, b - a); }
+    void toUpperCase() { for (auto& c : s) c = toupper((unsigned char)c); }
+    void toLowerCase() { for (auto& c : s) c = tolower((unsigned char)c); }
+    bool startsWith(const String& p) const { return s.compare(0, p.s.size(), p.s) == 0 && s.size() >= p.s.size(); }
+    bool endsWith(const String& p) const { return s.size() >= p.s.size() && s.compare(s.size() - p.s.size(), p.s.size(), p.s) == 0; }
+    bool equals(const String& o) const { return s == o.s; }
+    bool equalsIgnoreCase(const String& o) const { if (s.size() != o.s.size()) return false; for (size_t i = 0; i < s.size(); i++) if (tolower((unsigned char)s[i]) != tolower((unsigned char)o.s[i])) return false; return true; }
+    String substring(unsigned int a) const { return a >= s.size() ? String() : String(s.substr(a)); }
+    String substring(unsigned int a, unsigned int b) const { if (a > b) std::swap(a, b); if (a >= s.size()) return String(); return String(s.substr(a, b - a)); }
+    int indexOf(char c, unsigned int from = 0) const { auto p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+    int indexOf(const String& c, unsigned int from = 0) const { auto p = s.find(c.s, from); return p == std::string::npos ? -1 : (int)p; }
+    int lastIndexOf(char c) const { auto p = s.rfind(c); return p == std::string::npos ? -1 : (int)p; }
+    long toInt() const { return strtol(s.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(s.c_str(), nullptr); }
+    void remove(unsigned int i) { if (i < s.size()) s.erase(i); }
+    void remove(unsigned int i, unsigned int n) { if (i < s.size()) s.erase(i, n); }
+    char charAt(unsigned int i) const { return i < s.size() ? s[i] : 0; }
+    char operator[](unsigned int i) const { return charAt(i); }
+    char& operator[](unsigned int i) { return s[i]; }
+    void setCharAt(unsigned int i, char c) { if (i < s.size()) s[i] = c; }
+    bool concat(const String& o) { s += o.s; return true; }
+    bool concat(char c) { s += c; return true; }
+    bool concat(const char* c, unsigned int n) { s.append(c, n); return true; }
+    String& operator+=(const String& o) { s += o.s; return *this; }
+    String& operator+=(const char* o) { s += o; return *this; }
+    String& operator+=(char c) { s += c; return *this; }
+    String& operator+=(int v) { s += String(v).s; return *this; }
+    String& operator+=(unsigned int v) { s += String(v).s; return *this; }
+    String& operator+=(long v) { s += String(v).s; return *this; }
+    String& operator+=(unsigned long v) { s += String(v).s; return *this; }
+    bool operator==(const String& o) const { return s == o.s; }
+    bool operator==(const char* o) const { return s == o; }
+    bool operator!=(const String& o) const { return s != o.s; }
+    bool operator!=(const char* o) const { return s != o; }
+    bool operator<(const String& o) const { return s < o.s; }
+    void replace(const String& a, const String& b) { size_t p = 0; while ((p = s.find(a.s, p)) != std::string::npos) { s.replace(p, a.s.size(), b.s); p += b.s.size(); } }
+    void toCharArray(char* buf, unsigned int n) const { if (!n) return; strncpy(buf, s.c_str(), n - 1); buf[n - 1] = 0; }
+};
+inline String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+inline String operator+(const char* a, const String& b) { return String(std::string(a) + b.s); }
+inline String operator+(const String& a, const char* b) { return String(a.s + b); }
+inline String operator+(const String& a, char b) { return String(a.s + b); }
+inline String operator+(const String& a, int b) { return a + String(b); }
+inline String operator+(const String& a, long b) { return a + String(b); }
+inline String operator+(const String& a, unsigned long b) { return a + String(b); }
+inline String operator+(const String& a, unsigned int b) { return a + String(b); }
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* b, size_t n) { size_t r = 0; while (n--) r += write(*b++); return r; }
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* b, size_t n) { return write((const uint8_t*)b, n); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+    size_t print(const char* x) { return write(x); }
+    size_t print(const String& x) { return write(x.c_str(), x.length()); }
+    size_t print(char x) { return write((uint8_t)x); }
+    size_t print(int x, int base = DEC) { return print(String((long)x, base)); }
+    size_t print(unsigned int x, int base = DEC) { return print(String((unsigned long)x, base)); }
+    size_t print(long x, int base = DEC) { return print(String(x, base)); }
+    size_t print(unsigned long x, int base = DEC) { return print(String(x, base)); }
+    size_t print(long long x) { return print(String(std::to_string(x))); }
+    size_t print(unsigned long long x) { return print(String(std::to_string(x))); }
+    size_t print(double x, int d = 2) { return print(String(x, d)); }
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T& x) { size_t n = print(x); return n + println(); }
+    template <typename T> size_t println(const T& x, int b) { size_t n = print(x, b); return n + println(); }
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    unsigned long _timeout = 1000;
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long t) { _timeout = t; }
+    String readStringUntil(char t) { String r; while (available()) { int c = read(); if (c == t) break; r += (char)c; } return r; }
+    size_t readBytes(char* b, size_t n) { size_t i = 0; while (i < n && available()) b[i++] = (char)read(); return i; }
+};
+
+class HardwareSerial : public Stream {
+public:
+    std::deque<uint8_t> rx;
+    std::string tx;
+    std::vector<unsigned long> txBaud;  // Rate each byte of tx was written at
+    std::string calls;                  // Driver calls in order, e.g. "flush;update 9600;"
+    unsigned long baud = 0;
+    uint32_t config = SERIAL_8N1;
+    size_t rxBufSize = 256, txBufSize = 0;
+    bool hwFlow = false;
+    bool began = false;
+    bool overrun = false, rxError = false;  // Latched until read, as on ESP8266
+    void begin(unsigned long b, uint32_t cfg = SERIAL_8N1) { baud = b; config = cfg; began = true; calls += "begin " + std::to_string(b) + ";"; }
+    void end() { began = false; calls += "end;"; }
+    void updateBaudRate(unsigned long b) { baud = b; calls += "update " + std::to_string(b) + ";"; }
+    size_t setRxBufferSize(size_t n) { rxBufSize = n; return n; }
+    size_t setTxBufferSize(size_t n) { txBufSize = n; return n; }
+    bool hasOverrun() { bool r = overrun; overrun = false; return r; }
+    bool hasRxError() { bool r = rxError; rxError = false; return r; }
+    int available() override { return (int)rx.size(); }
+    int read() override { if (rx.empty()) return -1; int c = rx.front(); rx.pop_front(); return c; }
+    int peek() override { return rx.empty() ? -1 : rx.front(); }
+    size_t write(uint8_t c) override { tx += (char)c; txBaud.push_back(baud); return 1; }
+    using Print::write;
+    int availableForWrite() override { return 128; }
+    void flush() override { calls += "flush;"; }
+    operator bool() const { return true; }
+    void feed(const char* s) { while (*s) rx.push_back((uint8_t)*s++); }
+    std::string take() { std::string r; r.swap(tx); txBaud.clear(); return r; }
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+    void restart() { printf("[ESP.restart]\n"); }
+    uint32_t getFreeHeap() { return 20000; }
+    uint32_t getHeapSize() { return 32000; }
+};
+extern EspClass ESP;
+
+#endif // MOE_SIMPLE_AT_HOST_ARDUINO_H
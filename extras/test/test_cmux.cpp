@@ -0,0 +1,207 @@
+/**
+ * test_cmux.cpp - AT, log and shell multiplexed over Serial with AT+CMUX
+ *
+ * Plays the host: frames are encoded with cmuxEncodeFrame(), fed through
+ * Serial.feed() and the device's output is split up again with CMUXDecoder.
+ */
+
+#include <string>
+#include <vector>
+#include "MoeSimpleAT.h"
+#include "test_util.h"
+
+struct Frame {
+    uint8_t dlci;
+    uint8_t control;
+    std::string info;
+};
+
+static std::vector<Frame> frames;
+
+static void onFrame(uint8_t dlci, bool cr, uint8_t control, const uint8_t* info, size_t len, void*) {
+    frames.push_back({ dlci, (uint8_t)(control & ~CMUX_PF), std::string((const char*)info, len) });
+}
+
+static uint8_t rxBuf[AT_CMUX_MAX_FRAME];
+static CMUXDecoder decoder(rxBuf, sizeof(rxBuf), onFrame);
+
+static void send(uint8_t dlci, uint8_t control, const void* info = nullptr, size_t len = 0) {
+    uint8_t frame[AT_CMUX_MAX_FRAME + CMUX_FRAME_OVERHEAD];
+    size_t n = cmuxEncodeFrame(frame, sizeof(frame), dlci, true, control, (const uint8_t*)info, len);
+    Serial.rx.insert(Serial.rx.end(), frame, frame + n);
+}
+
+static void sendText(uint8_t dlci, const char* text) {
+    send(dlci, CMUX_UIH, text, strlen(text));
+}
+
+// MSC for one channel; fc set asks the device to stop sending on it
+static void sendMSC(uint8_t dlci, bool fc) {
+    const uint8_t msg[] = {
+        CMUX_MSG_MSC | CMUX_MSG_CR, (2 << 1) | 0x01,
+        (uint8_t)((dlci << 2) | 0x03), (uint8_t)((fc ? CMUX_V24_FC : 0) | 0x01)
+    };
+    send(0, CMUX_UIH, msg, sizeof(msg));
+}
+
+static void sendFlow(bool on) {
+    const uint8_t msg[] = { (uint8_t)((on ? CMUX_MSG_FCON : CMUX_MSG_FCOFF) | CMUX_MSG_CR), 0x01 };
+    send(0, CMUX_UIH, msg, sizeof(msg));
+}
+
+// Decode everything the device sent so far
+static void collect() {
+    std::string tx = Serial.take();
+    for (char c : tx) decoder.feed((uint8_t)c);
+}
+
+// Run the loop a few times and decode the output
+static void run(int calls = 5) {
+    for (int i = 0; i < calls; i++) {
+        handleATCommands();
+        delay(1);
+    }
+    collect();
+}
+
+// Concatenated data of the UIH frames received on a channel
+static std::string channelText(uint8_t dlci) {
+    std::string text;
+    for (const Frame& f : frames) {
+        if (f.dlci == dlci && f.control == CMUX_UIH) text += f.info;
+    }
+    return text;
+}
+
+static size_t dataFrames(uint8_t dlci) {
+    size_t n = 0;
+    for (const Frame& f : frames) {
+        if (f.dlci == dlci && f.control == CMUX_UIH) n++;
+    }
+    return n;
+}
+
+// 96 bytes of output, six frames of 16
+static void fillHandler(const char* args, void* context) {
+    for (int i = 0; i < 96; i++) atOutput->print('#');
+    sendATResult(AT_RESULT_OK);
+}
+
+int main() {
+    registerATCommand("FILL", fillHandler, "Print 96 bytes");
+    initATCommands();
+    Serial.take();
+
+    // The OK goes out in plain text, then the host opens all channels
+    Serial.feed("AT+CMUX=0,,,16\r\n");
+    handleATCommands();
+    CHECK_CONTAINS(Serial.take().c_str(), "OK");
+    CHECK(isCMUXActive());
+    for (uint8_t dlci = 0; dlci <= AT_CMUX_DLCI_SHELL; dlci++) {
+        send(dlci, CMUX_SABM | CMUX_PF);
+    }
+    run();
+    size_t acks = 0;
+    for (const Frame& f : frames) {
+        if (f.control == CMUX_UA) acks++;
+    }
+    CHECK(acks == 4);
+    CHECK_CONTAINS(channelText(AT_CMUX_DLCI_SHELL).c_str(), "msh> ");
+
+    // AT on DLCI 1 and log() on DLCI 2 at the same time
+    frames.clear();
+    sendText(AT_CMUX_DLCI_AT, "AT+GMR\r\n");
+    log("sensor ready");
+    run();
+    CHECK_CONTAINS(channelText(AT_CMUX_DLCI_AT).c_str(), "OK");
+    CHECK(channelText(AT_CMUX_DLCI_AT).find("sensor ready") == std::string::npos);
+    CHECK(channelText(AT_CMUX_DLCI_LOG) == "sensor ready\r\n");
+    CHECK(dataFrames(AT_CMUX_DLCI_SHELL) == 0);
+    for (const Frame& f : frames) {
+        CHECK(f.info.size() <= 16);
+    }
+
+    // The shell on DLCI 3
+    frames.clear();
+    sendText(AT_CMUX_DLCI_SHELL, "echo hi there\r\n");
+    run();
+    std::string shell = channelText(AT_CMUX_DLCI_SHELL);
+    CHECK_CONTAINS(shell.c_str(), "hi there\r\n");
+    CHECK_CONTAINS(shell.c_str(), "msh> ");
+    CHECK(dataFrames(AT_CMUX_DLCI_AT) == 0);
+
+    // MSC with FC holds back only the log channel
+    frames.clear();
+    sendMSC(AT_CMUX_DLCI_LOG, true);
+    run();
+    log("held");
+    sendText(AT_CMUX_DLCI_AT, "AT\r\n");
+    run();
+    CHECK_CONTAINS(channelText(AT_CMUX_DLCI_AT).c_str(), "OK");
+    CHECK(dataFrames(AT_CMUX_DLCI_LOG) == 0);
+    sendMSC(AT_CMUX_DLCI_LOG, false);
+    run();
+    CHECK(channelText(AT_CMUX_DLCI_LOG) == "held\r\n");
+
+    // FCoff holds back every channel; output beyond the buffer is dropped and counted
+    frames.clear();
+    sendFlow(false);
+    run();
+    sendText(AT_CMUX_DLCI_AT, "AT\r\n");
+    sendText(AT_CMUX_DLCI_SHELL, "echo x\r\n");
+    CMUXStats before = getCMUXStats();
+    for (int i = 0; i < AT_CMUX_TX_BUF / 8; i++) log("overflow");
+    run();
+    CHECK(dataFrames(AT_CMUX_DLCI_AT) == 0);
+    CHECK(dataFrames(AT_CMUX_DLCI_LOG) == 0);
+    CHECK(dataFrames(AT_CMUX_DLCI_SHELL) == 0);
+    CMUXStats after = getCMUXStats();
+    CHECK(after.dropped[0] == before.dropped[0]);
+    CHECK(after.dropped[1] > before.dropped[1]);
+    CHECK(after.dropped[2] == before.dropped[2]);
+
+    sendFlow(true);
+    run(40);
+    CHECK_CONTAINS(channelText(AT_CMUX_DLCI_AT).c_str(), "OK");
+    CHECK_CONTAINS(channelText(AT_CMUX_DLCI_SHELL).c_str(), "x\r\n");
+
+    // Busy channels take turns, one frame each, instead of one draining first
+    sendFlow(false);
+    run();
+    sendText(AT_CMUX_DLCI_AT, "AT+FILL\r\n");
+    for (int i = 0; i < 4; i++) log("0123456789abcdefghij");
+    run();
+    frames.clear();
+    sendFlow(true);
+    handleATCommands();
+    collect();
+    std::vector<uint8_t> order;
+    for (const Frame& f : frames) {
+        if (f.dlci != 0 && f.control == CMUX_UIH) order.push_back(f.dlci);
+    }
+    CHECK(order.size() == AT_CMUX_FRAMES_PER_CALL);
+    for (size_t i = 1; i < order.size(); i++) {
+        CHECK(order[i] != order[i - 1]);
+    }
+    run(20);
+    CHECK(channelText(AT_CMUX_DLCI_AT).find(std::string(96, '#')) != std::string::npos);
+    CHECK(channelText(AT_CMUX_DLCI_LOG).size() == 4 * 22);
+
+    // AT+CMUX? reports the drops per channel
+    frames.clear();
+    sendText(AT_CMUX_DLCI_AT, "AT+CMUX?\r\n");
+    run();
+    CHECK_CONTAINS(channelText(AT_CMUX_DLCI_AT).c_str(), "+CMUX:0,0,,16");
+    CHECK_CONTAINS(channelText(AT_CMUX_DLCI_AT).c_str(), "+CMUXDROP:0,");
+
+    // Close down on DLCI 0 returns to plain AT mode
+    const uint8_t cld[] = { CMUX_MSG_CLD | CMUX_MSG_CR, 0x01 };
+    send(0, CMUX_UIH, cld, sizeof(cld));
+    run();
+    CHECK(!isCMUXActive());
+    Serial.feed("AT\r\n");
+    handleATCommands();
+    CHECK_CONTAINS(Serial.take().c_str(), "OK");
+
+    return testResult("test_cmux");
+}
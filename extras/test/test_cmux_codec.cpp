@@ -0,0 +1,127 @@
+/**
+ * test_cmux_codec.cpp - CMUX frame codec round trips
+ *
+ * Built without the Arduino stand-in: only MoeSimpleATCMUX.h and
+ * MoeSimpleATCMUXCodec.cpp.
+ */
+
+#include "MoeSimpleATCMUX.h"
+#include "test_util.h"
+
+// DLCIs of the device's channels (AT_CMUX_DLCI_* in MoeSimpleAT.h)
+static const uint8_t DLCI_CONTROL = 0;
+static const uint8_t DLCI_AT = 1;
+static const uint8_t DLCI_LOG = 2;
+static const uint8_t DLCI_SHELL = 3;
+
+struct Frame {
+    uint8_t dlci;
+    bool cr;
+    uint8_t control;
+    uint8_t info[256];
+    size_t len;
+};
+
+static Frame frames[16];
+static size_t frameCount = 0;
+
+static void onFrame(uint8_t dlci, bool cr, uint8_t control, const uint8_t* info, size_t len, void* context) {
+    CHECK(context == &frames);
+    if (frameCount == sizeof(frames) / sizeof(frames[0])) return;
+    Frame& f = frames[frameCount++];
+    f.dlci = dlci;
+    f.cr = cr;
+    f.control = control;
+    f.len = len;
+    memcpy(f.info, info, len);
+}
+
+static uint8_t rxBuf[256];
+static CMUXDecoder decoder(rxBuf, sizeof(rxBuf), onFrame, &frames);
+
+static void feed(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) decoder.feed(data[i]);
+}
+
+// Encode a frame, decode it and compare
+static void roundTrip(uint8_t dlci, bool cr, uint8_t control, const char* text) {
+    uint8_t out[300];
+    size_t len = text ? strlen(text) : 0;
+    size_t n = cmuxEncodeFrame(out, sizeof(out), dlci, cr, control, (const uint8_t*)text, len);
+    CHECK(n == len + (len > 0x7F ? 7 : 6));
+
+    size_t before = frameCount;
+    feed(out, n);
+    CHECK(frameCount == before + 1);
+    if (frameCount != before + 1) return;
+
+    const Frame& f = frames[before];
+    CHECK(f.dlci == dlci);
+    CHECK(f.cr == cr);
+    CHECK(f.control == control);
+    CHECK(f.len == len);
+    CHECK(len == 0 || memcmp(f.info, text, len) == 0);
+}
+
+int main() {
+    // Reference frame from 27.010: SABM with P on DLCI 0 is F9 03 3F 01 1C F9
+    uint8_t out[300];
+    const uint8_t sabm0[] = { 0xF9, 0x03, 0x3F, 0x01, 0x1C, 0xF9 };
+    CHECK(cmuxEncodeFrame(out, sizeof(out), DLCI_CONTROL, true, CMUX_SABM | CMUX_PF, nullptr, 0) == sizeof(sabm0));
+    CHECK(memcmp(out, sabm0, sizeof(sabm0)) == 0);
+
+    // Host opens every channel, device answers with UA
+    const uint8_t dlcis[] = { DLCI_CONTROL, DLCI_AT, DLCI_LOG, DLCI_SHELL };
+    for (uint8_t dlci : dlcis) {
+        roundTrip(dlci, true, CMUX_SABM | CMUX_PF, nullptr);
+        roundTrip(dlci, true, CMUX_UA | CMUX_PF, nullptr);
+    }
+
+    // Data on each channel
+    roundTrip(DLCI_AT, true, CMUX_UIH, "AT+GMR\r");
+    roundTrip(DLCI_AT, false, CMUX_UIH, "\r\nOK\r\n");
+    roundTrip(DLCI_LOG, false, CMUX_UIH, "[log] boot\r\n");
+    roundTrip(DLCI_SHELL, true, CMUX_UIH, "free -h\r");
+    roundTrip(DLCI_SHELL, false, CMUX_UI, "msh> ");
+
+    // Two-byte length field
+    char longText[201];
+    memset(longText, 'x', 200);
+    longText[200] = '\0';
+    roundTrip(DLCI_AT, false, CMUX_UIH, longText);
+    CHECK(cmuxEncodeFrame(out, 205, DLCI_AT, false, CMUX_UIH, (const uint8_t*)longText, 200) == 0);
+
+    // Bad FCS: dropped and counted; the next frame decodes again
+    size_t n = cmuxEncodeFrame(out, sizeof(out), DLCI_AT, true, CMUX_UIH, (const uint8_t*)"AT\r", 3);
+    out[n - 2] ^= 0x55;
+    size_t before = frameCount;
+    feed(out, n);
+    CHECK(frameCount == before);
+    CHECK(decoder.fcsErrors() == 1);
+    roundTrip(DLCI_AT, true, CMUX_UIH, "AT\r");
+
+    // UI frames protect the information field, UIH frames only the header
+    n = cmuxEncodeFrame(out, sizeof(out), DLCI_SHELL, true, CMUX_UI, (const uint8_t*)"ls\r", 3);
+    out[4] ^= 0x20;
+    before = frameCount;
+    feed(out, n);
+    CHECK(frameCount == before);
+    CHECK(decoder.fcsErrors() == 2);
+
+    // Missing closing flag counts as an FCS error
+    n = cmuxEncodeFrame(out, sizeof(out), DLCI_LOG, false, CMUX_UIH, (const uint8_t*)"x", 1);
+    out[n - 1] = 0x00;
+    feed(out, n);
+    CHECK(decoder.fcsErrors() == 3);
+
+    // Information field larger than the decoder buffer
+    uint8_t small[8];
+    CMUXDecoder smallDecoder(small, sizeof(small), onFrame, &frames);
+    n = cmuxEncodeFrame(out, sizeof(out), DLCI_AT, true, CMUX_UIH, (const uint8_t*)longText, 20);
+    for (size_t i = 0; i < n; i++) smallDecoder.feed(out[i]);
+    CHECK(smallDecoder.oversized() == 1);
+    CHECK(smallDecoder.frames() == 0);
+
+    CHECK(decoder.frames() == frameCount);
+    return testResult("test_cmux_codec");
+}
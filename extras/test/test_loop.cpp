@@ -0,0 +1,80 @@
+/**
+ * test_loop.cpp - Loop monitor: busy time, stalls and idle sleep
+ *
+ * Time is simulated: delay() advances micros(), so a handler or a sketch
+ * stall takes exactly as long as the test says.
+ */
+
+#include <string>
+#include "MoeSimpleAT.h"
+#include "test_util.h"
+
+class SimHooks : public PowerHooks {
+public:
+    bool lightSleep(unsigned long maxMs) override {
+        sleeps++;
+        delay(maxMs);
+        return false;
+    }
+
+    int sleeps = 0;
+};
+
+static void slowHandler(const char* args, void* context) {
+    delay(150);
+    sendATResult(AT_RESULT_OK);
+}
+
+int main() {
+    registerATCommand("SLOW", slowHandler, "Take 150 ms");
+    initATCommands();
+    setLoopWarning(100);
+    Serial.take();
+
+    // A slow command: busy time and a warning naming it
+    handleATCommands();
+    Serial.feed("AT+SLOW\r\n");
+    handleATCommands();
+    for (int i = 0; i < 3; i++) handleATCommands();
+    std::string out = Serial.take();
+    CHECK_CONTAINS(out.c_str(), "+LOOPWARN:");
+    CHECK_CONTAINS(out.c_str(), "\"AT+SLOW\"");
+    CHECK(getLoopStats().maxBusyUs >= 150000);
+    CHECK(getLoopStats().worst[0].busyUs >= 150000);
+    CHECK(strcmp(getLoopStats().worst[0].command, "AT+SLOW") == 0);
+
+    // The sketch stalling between calls: a warning without a command
+    delay(120);
+    handleATCommands();
+    for (int i = 0; i < 3; i++) handleATCommands();
+    out = Serial.take();
+    CHECK_CONTAINS(out.c_str(), ",\"\"");
+    CHECK(getLoopStats().maxIntervalUs >= 120000);
+
+    // Idle light sleep is neither busy time nor a stall
+    SimHooks hooks;
+    setPowerHooks(&hooks);
+    setIdlePolicy(10, 1000);
+    resetLoopStats();
+    uint32_t warnings = getLoopStats().warnings;
+    for (int i = 0; i < 20; i++) {
+        handleATCommands();
+        delay(5);
+    }
+    CHECK(hooks.sleeps > 5);
+    LoopStats s = getLoopStats();
+    CHECK(s.warnings == warnings);
+    CHECK(s.maxBusyUs < 1000);
+    CHECK(s.maxIntervalUs < 10000);
+    CHECK(Serial.take().find("+LOOPWARN") == std::string::npos);
+
+    // A slow command right after waking still counts in full
+    Serial.feed("AT+SLOW\r\n");
+    for (int i = 0; i < 3; i++) handleATCommands();
+    CHECK_CONTAINS(Serial.take().c_str(), "\"AT+SLOW\"");
+    CHECK(getLoopStats().maxBusyUs >= 150000);
+    CHECK(getLoopStats().maxBusyUs < 200000);
+    setIdlePolicy(0, AT_IDLE_LATENCY_MS);
+
+    return testResult("test_loop");
+}
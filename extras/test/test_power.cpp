@@ -0,0 +1,105 @@
+/**
+ * test_power.cpp - Idle sleep length bounded by the latency budget, jobs and scripts
+ *
+ * SimHooks records each requested sleep and advances the simulated clock
+ * by its full length, as if no UART byte arrived.
+ */
+
+#include "MoeSimpleAT.h"
+#include "test_util.h"
+
+class SimHooks : public PowerHooks {
+public:
+    bool lightSleep(unsigned long maxMs) override {
+        sleeps++;
+        lastMs = maxMs;
+        if (maxMs > longestMs) longestMs = maxMs;
+        delay(maxMs);
+        return false;
+    }
+
+    int sleeps = 0;
+    unsigned long lastMs = 0;
+    unsigned long longestMs = 0;
+};
+
+static SimHooks hooks;
+
+// One loop pass, then let the idle timeout run out so the next call may sleep
+static void idle() {
+    handleATCommands();
+    delay(150);
+}
+
+int main() {
+    initATCommands();
+    setPowerHooks(&hooks);
+    setIdlePolicy(100, 1000);
+    Serial.take();
+
+    // Nothing pending: the latency budget bounds the sleep
+    idle();
+    handleATCommands();
+    CHECK(hooks.sleeps == 1);
+    CHECK(hooks.lastMs == 1000);
+
+    // Input keeps the device awake
+    Serial.feed("AT\r\n");
+    handleATCommands();
+    CHECK(hooks.sleeps == 1);
+    CHECK_CONTAINS(Serial.take().c_str(), "OK");
+
+    // A periodic job: wake in time for it, and it runs right after waking
+    int job = scheduleCommand(JOB_AT, "AT", 300);
+    CHECK(job >= 0);
+    idle();
+    handleATCommands();
+    CHECK(hooks.sleeps == 2);
+    CHECK(hooks.lastMs <= 300 - 150);
+    CHECK(hooks.lastMs >= 300 - 150 - AT_SCHED_TICK_MS);
+    CHECK_CONTAINS(Serial.take().c_str(), "OK");
+    CHECK(cancelScheduledCommand(job));
+    Serial.take();
+
+    // Over several periods no sleep outlasts the time to the next run
+    job = scheduleCommand(JOB_AT, "AT", 5 * AT_SCHED_TICK_MS);
+    int before = hooks.sleeps;
+    hooks.longestMs = 0;
+    for (int i = 0; i < 20; i++) {
+        handleATCommands();
+        delay(50);
+    }
+    CHECK(hooks.sleeps > before);
+    CHECK(hooks.longestMs <= 5 * AT_SCHED_TICK_MS);
+    CHECK(cancelScheduledCommand(job));
+    Serial.take();
+
+    // A script sleeping 250 ms: the device sleeps at most that long
+    CHECK(registerScript("nap", "sleep 250; AT"));
+    idle();
+    before = hooks.sleeps;
+    CHECK(runScript("nap"));
+    handleATCommands();   // Runs up to the script's sleep
+    handleATCommands();
+    CHECK(hooks.sleeps == before + 1);
+    CHECK(hooks.lastMs <= 250);
+    CHECK(hooks.lastMs >= AT_IDLE_MIN_SLEEP_MS);
+    CHECK_CONTAINS(Serial.take().c_str(), "OK");   // The script ran on after waking
+
+    handleATCommands();
+    CHECK(!isScriptRunning());
+
+    // A script that is computing keeps the device awake
+    CHECK(registerScript("busy", "while i < 100000; let i = i + 1; end"));
+    CHECK(runScript("busy"));
+    before = hooks.sleeps;
+    for (int i = 0; i < 10; i++) idle();
+    CHECK(hooks.sleeps == before);
+    stopScript();
+
+    PowerStats stats = getPowerStats();
+    CHECK(stats.sleeps == (uint32_t)hooks.sleeps);
+    CHECK(stats.uartWakes == 0);
+
+    return testResult("test_power");
+}
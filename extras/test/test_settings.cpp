@@ -0,0 +1,144 @@
+/**
+ * test_settings.cpp - Settings store: power loss during writes and sector moves
+ *
+ * TornFlash cuts the power at a chosen flash operation: the write or erase
+ * stops halfway and nothing after it reaches the flash. Each remount uses
+ * a fresh FileSettingsFlash on the same image, like a reboot.
+ */
+
+#include <stdio.h>
+#include "MoeSimpleAT.h"
+#include "test_util.h"
+
+static const char* IMAGE = "build/test_settings.bin";
+static const size_t SECTOR_SIZE = 2048;
+static const size_t SECTORS = 3;
+
+class TornFlash : public FileSettingsFlash {
+public:
+    TornFlash(const char* path, size_t sectorSize, size_t sectorCount)
+        : FileSettingsFlash(path, sectorSize, sectorCount) {}
+
+    int writesLeft = -1;      // Writes that complete before the power fails (-1: no failure)
+    bool tearErase = false;   // The next erase only clears the first half of the sector
+    bool dead = false;
+
+    bool write(uint32_t addr, const void* data, size_t len) override {
+        if (dead) return false;
+        if (writesLeft == 0) {
+            dead = true;
+            FileSettingsFlash::write(addr, data, len / 2);
+            return false;
+        }
+        if (writesLeft > 0) writesLeft--;
+        return FileSettingsFlash::write(addr, data, len);
+    }
+
+    bool eraseSector(size_t sector) override {
+        if (dead) return false;
+        if (!tearErase) return FileSettingsFlash::eraseSector(sector);
+
+        // Keep the second half as it was
+        dead = true;
+        size_t half = sectorSize() / 2;
+        uint8_t saved[SECTOR_SIZE / 2];
+        FileSettingsFlash::read(sector * sectorSize() + half, saved, half);
+        FileSettingsFlash::eraseSector(sector);
+        FileSettingsFlash::write(sector * sectorSize() + half, saved, half);
+        return false;
+    }
+};
+
+static bool readsAs(uint8_t key, const char* text) {
+    char buf[AT_SETTINGS_MAX_VALUE + 1];
+    int n = settingsRead(key, buf, AT_SETTINGS_MAX_VALUE);
+    if (n < 0) return false;
+    buf[n] = '\0';
+    return strcmp(buf, text) == 0;
+}
+
+static bool writeText(uint8_t key, const char* text) {
+    return settingsWrite(key, text, strlen(text));
+}
+
+int main() {
+    remove(IMAGE);
+    const uint8_t key = SETTING_USER;
+    const uint8_t other = SETTING_USER + 1;
+
+    // Blank image: formatted without erasing
+    {
+        TornFlash flash(IMAGE, SECTOR_SIZE, SECTORS);
+        CHECK(beginSettings(&flash));
+        for (size_t s = 0; s < SECTORS; s++) CHECK(flash.eraseCount(s) == 0);
+        CHECK(writeText(key, "one"));
+        CHECK(writeText(other, "kept"));
+
+        // Power fails in the middle of programming the record
+        flash.writesLeft = 0;
+        CHECK(!writeText(key, "two"));
+    }
+    {
+        TornFlash flash(IMAGE, SECTOR_SIZE, SECTORS);
+        CHECK(beginSettings(&flash));
+        CHECK(readsAs(key, "one"));
+        CHECK(readsAs(other, "kept"));
+        for (size_t s = 0; s < SECTORS; s++) CHECK(flash.eraseCount(s) == 0);
+
+        // The record is complete but the power fails before it is committed
+        CHECK(writeText(key, "two"));
+        flash.writesLeft = 1;
+        CHECK(!writeText(key, "three"));
+    }
+    {
+        TornFlash flash(IMAGE, SECTOR_SIZE, SECTORS);
+        CHECK(beginSettings(&flash));
+        CHECK(readsAs(key, "two"));
+        CHECK(readsAs(other, "kept"));
+        CHECK(getSettingsStats().liveKeys == 2);
+
+        // Fill sectors 0 and 1; the move into sector 2 reclaims sector 0 and
+        // the power fails while it is being erased
+        flash.tearErase = true;
+        char value[12];
+        int i = 0;
+        bool ok = true;
+        while (ok && i < 1000) {
+            formatNumber(value, sizeof(value), i++);
+            ok = writeText(key, value);
+        }
+        CHECK(!ok);
+        CHECK(flash.dead);
+        CHECK(getSettingsStats().activeSector == 2);
+        formatNumber(value, sizeof(value), i - 2);
+
+        // Remount finishes the erase, once, and keeps every value
+        TornFlash again(IMAGE, SECTOR_SIZE, SECTORS);
+        CHECK(beginSettings(&again));
+        CHECK(again.eraseCount(0) == 1);
+        CHECK(again.eraseCount(1) == 0);
+        CHECK(again.eraseCount(2) == 0);
+        CHECK(readsAs(key, value));
+        CHECK(readsAs(other, "kept"));
+        CHECK(writeText(key, "after"));
+    }
+    {
+        TornFlash flash(IMAGE, SECTOR_SIZE, SECTORS);
+        CHECK(beginSettings(&flash));
+        for (size_t s = 0; s < SECTORS; s++) CHECK(flash.eraseCount(s) == 0);
+        CHECK(readsAs(key, "after"));
+        CHECK(readsAs(other, "kept"));
+    }
+
+    // A region with more sectors than the one-byte sector numbers can address
+    remove(IMAGE);
+    {
+        TornFlash flash(IMAGE, SECTOR_SIZE, 300);
+        CHECK(beginSettings(&flash));
+        CHECK(writeText(key, "big"));
+        CHECK(readsAs(key, "big"));
+    }
+    remove(IMAGE);
+
+    return testResult("test_settings");
+}
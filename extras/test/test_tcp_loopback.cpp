@@ -0,0 +1,166 @@
+/**
+ * test_tcp_loopback.cpp - TCP transport over 127.0.0.1 with several clients
+ *
+ * Real sockets through PosixTCPBackend. StallingBackend can pretend a
+ * client's socket is full, which loopback buffers are too large to reach.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include "MoeSimpleAT.h"
+#include "test_util.h"
+
+class StallingBackend : public PosixTCPBackend {
+public:
+    int write(int conn, const uint8_t* data, size_t len) override {
+        return stalled ? 0 : PosixTCPBackend::write(conn, data, len);
+    }
+
+    bool stalled = false;
+};
+
+static StallingBackend backend;
+
+class CountingHooks : public PowerHooks {
+public:
+    bool lightSleep(unsigned long maxMs) override {
+        sleeps++;
+        delay(maxMs);
+        return false;
+    }
+
+    int sleeps = 0;
+};
+
+static int connectClient(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Run the loop a few times and collect what the client received; eof is set
+// once the server has closed the connection
+static std::string pump(int fd, bool* eof = nullptr) {
+    std::string got;
+    for (int i = 0; i < 20; i++) {
+        handleATCommands();
+        usleep(1000);
+        char buf[512];
+        ssize_t n;
+        while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) got.append(buf, n);
+        if (n == 0 && eof) *eof = true;
+    }
+    return got;
+}
+
+static std::string send(int fd, const char* data, size_t len) {
+    ::send(fd, data, len, 0);
+    return pump(fd);
+}
+
+static std::string send(int fd, const char* line) {
+    return send(fd, line, strlen(line));
+}
+
+int main() {
+    initATCommands();
+    uint16_t port = 20000 + getpid() % 20000;
+    while (!beginTCPServer(port, true, &backend)) port++;
+
+    // Two clients are served, a third one is refused
+    int a = connectClient(port);
+    int b = connectClient(port);
+    CHECK(a >= 0 && b >= 0);
+    CHECK_CONTAINS(pump(a).c_str(), "ready");
+    CHECK_CONTAINS(pump(b).c_str(), "ready");
+    int c = connectClient(port);
+    bool closed = false;
+    CHECK(pump(c, &closed).empty());
+    CHECK(closed);
+    close(c);
+    CHECK(getTCPStats().clients == 2);
+    CHECK(getTCPStats().rejected == 1);
+
+    // Modes and echo are per client, and the serial port keeps its own
+    CHECK_CONTAINS(send(a, "AT+SHELL\r\n").c_str(), "msh> ");
+    std::string reply = send(b, "AT\r\n");
+    CHECK_CONTAINS(reply.c_str(), "OK");
+    CHECK(reply.find("msh> ") == std::string::npos);
+    CHECK(reply.find("AT\r\n") == std::string::npos);        // Echo starts off
+
+    send(b, "ATE1\r\n");
+    CHECK_CONTAINS(send(b, "AT+GMR\r\n").c_str(), "AT+GMR\r\n");
+    reply = send(a, "echo hi\r\n");
+    CHECK_CONTAINS(reply.c_str(), "hi\r\n");
+    CHECK(reply.find("echo hi") == std::string::npos);
+    CHECK(!inShellMode);
+    CHECK(atEcho == (AT_DEFAULT_ECHO != 0));
+
+    // Telnet: options are refused, commands are stripped from the input
+    const uint8_t negotiate[] = {
+        255, 253, 1,                     // IAC DO ECHO
+        255, 251, 3,                     // IAC WILL SUPPRESS-GO-AHEAD
+        'e', 'x',
+        255, 250, 24, 0, 'x', 255, 240,  // IAC SB TERMINAL-TYPE ... IAC SE
+        'i', 't', '\r', '\n'
+    };
+    reply = send(a, (const char*)negotiate, sizeof(negotiate));
+    CHECK(reply.find("\xFF\xFC\x01") != std::string::npos);  // IAC WONT ECHO
+    CHECK(reply.find("\xFF\xFE\x03") != std::string::npos);  // IAC DONT SUPPRESS-GO-AHEAD
+    reply = send(a, "AT\r\n");
+    CHECK_CONTAINS(reply.c_str(), "OK");                      // "exit" left the shell
+    CHECK(reply.find("msh> ") == std::string::npos);
+
+    // Output a stalled client cannot take is dropped and counted; the
+    // session carries on once the socket drains
+    uint32_t dropped = getTCPStats().txDropped;
+    backend.stalled = true;
+    send(b, "AT+HELP\r\n");
+    backend.stalled = false;
+    CHECK(getTCPStats().txDropped > dropped);
+    pump(b);
+    CHECK_CONTAINS(send(b, "AT\r\n").c_str(), "OK");
+    CHECK_CONTAINS(send(a, "AT\r\n").c_str(), "OK");
+
+    // A client leaving frees its session
+    close(a);
+    pump(b);
+    CHECK(getTCPStats().clients == 1);
+    c = connectClient(port);
+    CHECK_CONTAINS(pump(c).c_str(), "ready");
+    CHECK(getTCPStats().clients == 2);
+
+    // No light sleep while the server listens, even without clients
+    close(b);
+    close(c);
+    for (int i = 0; i < 5; i++) handleATCommands();
+    CHECK(getTCPStats().clients == 0);
+    CountingHooks hooks;
+    setPowerHooks(&hooks);
+    setIdlePolicy(10, 100);
+    for (int i = 0; i < 5; i++) {
+        handleATCommands();
+        delay(50);
+    }
+    CHECK(hooks.sleeps == 0);
+    stopTCPServer();
+    for (int i = 0; i < 5; i++) {
+        handleATCommands();
+        delay(50);
+    }
+    CHECK(hooks.sleeps > 0);
+    setIdlePolicy(0, AT_IDLE_LATENCY_MS);
+    setPowerHooks(nullptr);
+
+    return testResult("test_tcp_loopback");
+}
@@ -0,0 +1,142 @@
+/**
+ * test_template.cpp - Heap-free interpreter: no allocations after init, per-instance state
+ *
+ * malloc() and operator new are counted while commands run through the
+ * C-string API; the String registrations are not used (they allocate by
+ * design). Input is queued before counting starts because the Serial
+ * stand-in keeps it in a std::deque.
+ */
+
+#include <stdlib.h>
+#include <new>
+#include "MoeSimpleAT.h"
+#include "test_util.h"
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static bool counting = false;
+static size_t allocations = 0;
+
+extern "C" void* malloc(size_t size) {
+    if (counting) allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    if (counting) allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    if (counting) allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void* operator new(size_t size) {
+    if (counting) allocations++;
+    void* p = __libc_malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// Output collected in a fixed buffer, so writing does not allocate either
+class FixedOutput : public Print {
+public:
+    size_t write(uint8_t c) override {
+        if (len < sizeof(buf) - 1) buf[len++] = c;
+        buf[len] = '\0';
+        return 1;
+    }
+
+    using Print::write;
+
+    const char* text() const { return buf; }
+    void clear() { len = 0; buf[0] = '\0'; }
+
+private:
+    char buf[8192] = {};
+    size_t len = 0;
+};
+
+static FixedOutput out;
+static FixedOutput secondOut;
+
+static void ledHandler(const char* args, void* context) {
+    *(int*)context = atoi(args + 1);
+    sendATResult(AT_RESULT_OK);
+}
+
+static void blinkHandler(int argc, char* argv[], void* context) {
+    atOutput->print("blink:");
+    atOutput->print(argc);
+    atOutput->print(",");
+    atOutput->println(argv[argc - 1]);
+}
+
+static int led = 0;
+
+int main() {
+    CHECK(registerATCommand("LED", ledHandler, "Set the LED", &led));
+    CHECK(registerShellCommand("blink", blinkHandler, "Blink the LED"));
+    initATCommands();
+    atOutput = &out;
+
+    // Default instance through handleATCommands()
+    Serial.feed("AT\r\nATE1\r\nAT+LED=1\r\nAT+HELP\r\nAT+SHELL\r\n");
+    Serial.feed("blink 3 \"200 ms\"\r\nstty -echo\r\nhelp\r\nexit\r\n");
+    counting = true;
+    for (int i = 0; i < 20; i++) {
+        handleATCommands();
+        delay(10);
+    }
+    counting = false;
+
+    CHECK(allocations == 0);
+    CHECK(led == 1);
+    CHECK_CONTAINS(out.text(), "AT+LED  - Set the LED");
+    CHECK_CONTAINS(out.text(), "blink:3,200 ms");
+    CHECK_CONTAINS(out.text(), "blink  - Blink the LED");
+    CHECK(!inShellMode);
+    CHECK(atEcho);
+    CHECK(!shellEcho);
+
+    // A second instance keeps its own modes, echo and output
+    static MoeSimpleAT<2, 2, 32, 32> second;
+    CHECK(second.registerATCommand("LED", ledHandler, "Set the LED", &led));
+    second.setOutput(&secondOut);
+    out.clear();
+    allocations = 0;
+    counting = true;
+
+    second.processATCommand("ATE0");
+    second.processATCommand("AT+LED=0");
+    second.processATCommand("AT+SHELL");
+    for (const char* p = "help\n"; *p; p++) second.feed(*p);
+    defaultAT.processATCommand("AT");
+
+    counting = false;
+    CHECK(allocations == 0);
+    CHECK(led == 0);
+    CHECK(second.session()->shellMode);
+    CHECK(!second.session()->echo);
+    CHECK(!inShellMode);
+    CHECK(atEcho);
+    CHECK(atOutput == &out);
+    CHECK_CONTAINS(secondOut.text(), "Entering shell mode");
+    CHECK_CONTAINS(secondOut.text(), "No custom shell commands registered.");
+    CHECK(strstr(out.text(), "Entering shell mode") == nullptr);
+    CHECK_CONTAINS(out.text(), "OK");
+
+    return testResult("test_template");
+}
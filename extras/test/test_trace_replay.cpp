@@ -0,0 +1,113 @@
+/**
+ * test_trace_replay.cpp - Record a session with AT+TRACE, replay the dump, compare TX
+ *
+ * The trace is taken from the AT+TRACE? hex dump, as a host tool would
+ * get it from the device. Needs the library built with AT_TRACE_BUF_LEN.
+ */
+
+#include <string>
+#include <vector>
+#include "MoeSimpleAT.h"
+#include "test_util.h"
+
+class SerialReplayHooks : public TraceReplayHooks {
+public:
+    void feedRx(const uint8_t* data, size_t len) override {
+        Serial.rx.insert(Serial.rx.end(), data, data + len);
+    }
+
+    void advanceUs(uint32_t us) override {
+        hostNowUs += us;
+    }
+
+    size_t takeTx(uint8_t* out, size_t maxLen) override {
+        pending += Serial.take();
+        size_t n = pending.size() < maxLen ? pending.size() : maxLen;
+        memcpy(out, pending.data(), n);
+        pending.erase(0, n);
+        return n;
+    }
+
+private:
+    std::string pending;
+};
+
+// Send input and run the loop a few times, 1 ms apart
+static std::string run(const char* input) {
+    Serial.feed(input);
+    for (int i = 0; i < 5; i++) {
+        handleATCommands();
+        delay(1);
+    }
+    return Serial.take();
+}
+
+static int hexValue(char c) {
+    return c <= '9' ? c - '0' : c - 'A' + 10;
+}
+
+// Decode the AT+TRACE? response: +TRACE:<on>,<bytes>,<dropped>,<base us> and hex lines
+static bool parseDump(const std::string& text, std::vector<uint8_t>& trace, uint32_t& baseUs) {
+    size_t at = text.find("+TRACE:");
+    if (at == std::string::npos) return false;
+    unsigned on, bytes, dropped;
+    if (sscanf(text.c_str() + at, "+TRACE:%u,%u,%u,%u", &on, &bytes, &dropped, &baseUs) != 4) return false;
+
+    size_t pos = text.find('\n', at) + 1;
+    while (trace.size() < bytes && pos + 1 < text.size()) {
+        char hi = text[pos], lo = text[pos + 1];
+        if (isxdigit((unsigned char)hi) && isxdigit((unsigned char)lo)) {
+            trace.push_back(hexValue(hi) << 4 | hexValue(lo));
+            pos += 2;
+        } else {
+            pos++;
+        }
+    }
+    return trace.size() == bytes && dropped == 0;
+}
+
+int main() {
+    initATCommands();
+    Serial.take();
+
+    // Record
+    CHECK_CONTAINS(run("AT+TRACE=1\r\n").c_str(), "OK");
+    run("AT\r\nAT+GMR\r\n");
+    run("AT+SHELL\r\n");
+    CHECK_CONTAINS(run("echo hi there\r\n").c_str(), "hi there");
+    run("exit\r\n");
+    std::string dump = run("AT+TRACE?\r\n");
+    run("AT+TRACE=0\r\n");
+
+    std::vector<uint8_t> trace;
+    uint32_t baseUs = 0;
+    CHECK(parseDump(dump, trace, baseUs));
+
+    // Replay on the same configuration: identical output
+    SerialReplayHooks hooks;
+    std::vector<std::string> lines;
+    bool allMatched = true;
+    TraceReplayReport report = replayTrace(trace.data(), trace.size(), baseUs, hooks,
+                                           [&](const TraceCommandTiming& t) {
+        lines.push_back(std::string(t.line, t.lineLen));
+        allMatched = allMatched && t.outputMatched;
+    });
+    CHECK(report.matched);
+    CHECK(allMatched);
+    CHECK(report.txBytesExpected > 0);
+    CHECK(report.txBytesActual >= report.txBytesExpected);   // Includes the reply to AT+TRACE?
+    CHECK(report.commands >= 5);
+    CHECK(lines.size() >= 5 && lines[0] == "AT" && lines[1] == "AT+GMR" && lines[2] == "AT+SHELL");
+    CHECK(lines.size() >= 5 && lines[3] == "echo hi there" && lines[4] == "exit");
+    CHECK(!inShellMode);
+    Serial.take();
+
+    // Replay with echo on: the first difference is reported
+    run("ATE1\r\n");
+    report = replayTrace(trace.data(), trace.size(), baseUs, hooks, [](const TraceCommandTiming&) {});
+    CHECK(!report.matched);
+    CHECK(report.firstMismatchOffset < report.txBytesExpected);
+    run("ATE0\r\n");
+
+    return testResult("test_trace_replay");
+}
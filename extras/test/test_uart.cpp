@@ -0,0 +1,215 @@
+/**
+ * test_uart.cpp - AT+UART= line settings, switch-over, autobaud and boot
+ *
+ * Serial records the driver calls (flush, end, begin, updateBaudRate) and
+ * the rate each byte was written at. A reboot is simulated by restoring the
+ * sketch's 115200 8N1 port and calling initATCommands() again with a fresh
+ * FileSettingsFlash on the same image.
+ */
+
+#include <stdio.h>
+#include <string>
+#include "MoeSimpleAT.h"
+#include "test_util.h"
+
+static const char* IMAGE = "build/test_uart.bin";
+
+class BreakableFlash : public FileSettingsFlash {
+public:
+    explicit BreakableFlash(const char* path) : FileSettingsFlash(path) {}
+
+    bool write(uint32_t addr, const void* data, size_t len) override {
+        return !broken && FileSettingsFlash::write(addr, data, len);
+    }
+
+    bool broken = false;
+};
+
+static BreakableFlash* flash = nullptr;
+
+// Run the loop a few times, 1 ms apart
+static void run(const char* input, int calls = 3) {
+    Serial.feed(input);
+    for (int i = 0; i < calls; i++) {
+        handleATCommands();
+        delay(1);
+    }
+}
+
+// Bytes written since the last take() at the given rate
+static std::string sentAt(unsigned long baud) {
+    std::string text;
+    for (size_t i = 0; i < Serial.tx.size(); i++) {
+        if (Serial.txBaud[i] == baud) text += Serial.tx[i];
+    }
+    return text;
+}
+
+static void clear() {
+    Serial.take();
+    Serial.calls.clear();
+}
+
+// Responses flush too: only the calls that end the log matter
+static bool callsEndWith(const char* calls) {
+    size_t n = strlen(calls);
+    return Serial.calls.size() >= n && Serial.calls.compare(Serial.calls.size() - n, n, calls) == 0;
+}
+
+static bool portChanged() {
+    return Serial.calls.find("end;") != std::string::npos
+        || Serial.calls.find("begin") != std::string::npos
+        || Serial.calls.find("update") != std::string::npos;
+}
+
+static bool configIs(uint32_t baud, uint8_t dataBits, uint8_t stopBits, uint8_t parity, uint8_t flow) {
+    UARTConfig c = getUARTConfig();
+    return c.baud == baud && c.dataBits == dataBits && c.stopBits == stopBits
+        && c.parity == parity && c.flowControl == flow;
+}
+
+static void reboot() {
+    // RAM state and port as the sketch's Serial.begin() leaves them
+    UARTConfig defaults = { SERIAL_BAUD_RATE, 8, 1, 0, 0 };
+    setUARTConfig(defaults);
+    handleATCommands();
+    Serial.begin(SERIAL_BAUD_RATE);
+
+    delete flash;
+    flash = new BreakableFlash(IMAGE);
+    CHECK(beginSettings(flash));
+    clear();
+    initATCommands();
+}
+
+int main() {
+    remove(IMAGE);
+    Serial.begin(SERIAL_BAUD_RATE);
+    initATCommands();
+    clear();
+
+    // No settings store: AT+UART= cannot save and changes nothing
+    run("AT+UART=9600\r\n");
+    CHECK_CONTAINS(Serial.tx.c_str(), "ERROR");
+    CHECK(!portChanged());
+    CHECK(configIs(115200, 8, 1, 0, 0));
+    clear();
+
+    flash = new BreakableFlash(IMAGE);
+    CHECK(beginSettings(flash));
+
+    // Baud only: OK at the old rate, flushed, then only the divider changes
+    run("AT+UART=9600\r\n", 1);
+    CHECK_CONTAINS(sentAt(115200).c_str(), "OK");
+    CHECK(sentAt(9600).empty());
+    CHECK(callsEndWith("flush;update 9600;"));
+    CHECK(Serial.baud == 9600);
+    CHECK(configIs(9600, 8, 1, 0, 0));
+    clear();
+
+    // Five fields: a format change reopens the port
+    run("AT+UART=19200,7,3,2,0\r\n", 1);
+    CHECK_CONTAINS(sentAt(9600).c_str(), "OK");
+    CHECK(callsEndWith("flush;end;begin 19200;"));
+    CHECK(Serial.config == SERIAL_7E2);
+    CHECK(configIs(19200, 7, 3, 2, 0));
+    clear();
+    run("AT+UART?\r\n");
+    CHECK_CONTAINS(Serial.tx.c_str(), "+UART:19200,7,3,2,0");
+    clear();
+
+    // Rejected settings leave the port alone
+    const char* invalid[] = {
+        "AT+UART=19200,8,2,0,0\r\n",     // 1.5 stop bits
+        "AT+UART=19200,8,1,3,0\r\n",     // Parity above 2
+        "AT+UART=19200,4,1,0,0\r\n",     // Data bits below 5
+        "AT+UART=19200,9,1,0,0\r\n",     // Data bits above 8
+        "AT+UART=19200,8,1,0,1\r\n",     // RTS without AT_UART_RTS_PIN
+        "AT+UART=19200,8,1,0,3\r\n",     // RTS / CTS without pins
+        "AT+UART=19200,8,1\r\n",         // Neither 1 nor 5 fields
+        "AT+UART=-9600\r\n"
+    };
+    for (const char* line : invalid) {
+        run(line);
+        CHECK_CONTAINS(Serial.tx.c_str(), "ERROR");
+        CHECK(!portChanged());
+        clear();
+    }
+    CHECK(configIs(19200, 7, 3, 2, 0));
+
+    // Input already received at the old rate is read before the switch
+    setInputBudget(0, 1);
+    run("AT+UART=57600,8,1,0,0\r\nAT\r\n", 1);
+    CHECK(!portChanged());
+    run("", 1);
+    CHECK(callsEndWith("flush;end;begin 57600;"));
+    CHECK(sentAt(57600).empty());
+    clear();
+
+    // ... but for no longer than 100 ms while the host keeps sending
+    std::string lines = "AT+UART=38400\r\n";
+    for (int i = 0; i < 20; i++) lines += "AT\r\n";
+    Serial.feed(lines.c_str());
+    unsigned long start = millis();
+    while (!portChanged() && millis() - start < 1000) {
+        handleATCommands();
+        delay(10);
+    }
+    CHECK(callsEndWith("flush;update 38400;"));
+    CHECK(millis() - start >= 100 && millis() - start < 150);
+    CHECK(Serial.available() > 0);
+    setInputBudget(AT_INPUT_MAX_BYTES, AT_INPUT_MAX_LINES);
+    run("");
+    clear();
+
+    // Autobaud starts at the current rate and steps on garbage or a line error
+    run("AT+UART=0\r\n", 1);
+    CHECK_CONTAINS(sentAt(38400).c_str(), "OK");
+    CHECK(isUARTAutobaudActive());
+    uint32_t discarded = getUARTStats().discarded;
+    clear();
+    run("\x8f\x3c", 1);
+    CHECK(callsEndWith("flush;update 57600;"));
+    CHECK(getUARTStats().discarded > discarded);
+    clear();
+    Serial.rxError = true;
+    run("", 1);
+    CHECK(callsEndWith("flush;update 115200;"));
+    clear();
+
+    // It locks on "AT", which the interpreter then answers at that rate
+    run("AT\r\n");
+    CHECK(!isUARTAutobaudActive());
+    CHECK(!portChanged());
+    CHECK(getUARTConfig().baud == 115200);
+    CHECK_CONTAINS(sentAt(115200).c_str(), "OK");
+    clear();
+
+    // Saved autobaud runs again after a reboot
+    reboot();
+    CHECK(isUARTAutobaudActive());
+    run("AT\r\n");
+    CHECK(!isUARTAutobaudActive());
+    CHECK_CONTAINS(Serial.tx.c_str(), "OK");
+    clear();
+
+    // Saved rate and format are applied by initATCommands() before "ready"
+    run("AT+UART=38400,8,1,1,0\r\n");
+    CHECK(Serial.config == SERIAL_8O1);
+    reboot();
+    CHECK(callsEndWith("flush;end;begin 38400;"));
+    CHECK(Serial.config == SERIAL_8O1);
+    CHECK(configIs(38400, 8, 1, 1, 0));
+    CHECK_CONTAINS(sentAt(38400).c_str(), "ready");
+    clear();
+
+    // A failing store answers ERROR and keeps the port as it is
+    flash->broken = true;
+    run("AT+UART=9600\r\n");
+    CHECK_CONTAINS(Serial.tx.c_str(), "ERROR");
+    CHECK(!portChanged());
+    CHECK(configIs(38400, 8, 1, 1, 0));
+
+    delete flash;
+    return testResult("test_uart");
+}
@@ -0,0 +1,38 @@
+/**
+ * test_util.h - Minimal check macros and helpers for the host tests
+ *
+ * Each test is a small program: CHECK() records failures and main()
+ * returns testResult(), so `make check` stops at the first failing test.
+ */
+
+#ifndef MOE_SIMPLE_AT_TEST_UTIL_H
+#define MOE_SIMPLE_AT_TEST_UTIL_H
+
+#include <stdio.h>
+#include <string.h>
+
+static int testFailures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            testFailures++; \
+        } \
+    } while (0)
+
+// Check that text contains part
+#define CHECK_CONTAINS(text, part) \
+    do { \
+        if (strstr((text), (part)) == nullptr) { \
+            fprintf(stderr, "%s:%d: CHECK failed: \"%s\" not found in:\n%s\n", __FILE__, __LINE__, (part), (text)); \
+            testFailures++; \
+        } \
+    } while (0)
+
+static int testResult(const char* name) {
+    printf("%s: %s\n", name, testFailures ? "FAILED" : "ok");
+    return testFailures ? 1 : 0;
+}
+
+#endif // MOE_SIMPLE_AT_TEST_UTIL_H
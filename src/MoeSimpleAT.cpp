@@ -3,7 +3,7 @@
  */
 
 #include <string>
-#include "MoeSimpleAT.h"
+#include "MoeSimpleATInternal.h"
 
 #if defined(ESP32)
     #include <vector>
@@ -18,11 +18,22 @@
 // ----------------------------
 
 HardwareSerial* atSerial = &Serial;
+Print* atOutput = &Serial;
 String inputBuffer;
 bool inLogMode = false;
 bool inShellMode = false;
+bool atEcho = AT_DEFAULT_ECHO;
+bool atVerbose = true;
+bool atQuiet = false;
+bool shellEcho = true;
 
-// User defined instruction list
+// Default interpreter instance behind the free-function API
+MoeSimpleATDefault defaultAT;
+
+// Where the running instance saves the globals above when another one runs
+ATSession* activeATSession = defaultAT.session();
+
+// User defined instruction list (String / std::function registrations)
 std::vector<CustomATCommand> customATCommands;
 std::vector<CustomShellCommand> customShellCommands;
 
@@ -32,10 +43,34 @@ static std::function<void()> restoreCallback = nullptr;
 // Static variable to hold the shutdown callback
 static std::function<void()> shutdownCallback = nullptr;
 
-static bool shellFirstPromptDone = false;
-
 bool wakeupConfigured = false;
 
+long currentBaudRate = SERIAL_BAUD_RATE;
+
+// Whether the current AT response already contains information lines
+static bool atInfoSent = false;
+
+// Result of the last command, read by scripts as "rc"
+static ATResultCode lastATResult = AT_RESULT_OK;
+
+// Bytes not sent compared to ATE1 / ATV1 / ATQ0 (and shell echo on)
+static uint32_t atTxSavedPending = 0;
+static uint32_t atTxSavedLast = 0;
+static uint32_t atTxSavedTotal = 0;
+
+// Print sink appending to a String (only used by the String help getters)
+class StringPrint : public Print {
+public:
+    explicit StringPrint(String& target) : str(target) {}
+    size_t write(uint8_t c) override {
+        str += (char)c;
+        return 1;
+    }
+    using Print::write;
+private:
+    String& str;
+};
+
 // ----------------------------
 // User callable function implementation
 // ----------------------------
@@ -44,26 +79,55 @@ bool wakeupConfigured = false;
  * @brief Initialize AT command system and print startup message.
  */
 void initATCommands() {
+    atOutput = atSerialOutput();
+    beginUARTStats();
+
+    // Apply the line settings saved by AT+UART=
+    beginUARTConfig();
+
     if (atSerial) {
-        atSerial->println();
-        atSerial->println();
-        atSerial->println(AT_WELCOME);
-        atSerial->println("ready");
+        atOutput->println();
+        atOutput->println();
+        atOutput->println(AT_WELCOME);
+        atOutput->println("ready");
     }
 }
 
+// Adapters from the table entries of defaultAT to String / std::function handlers.
+// They build a String per call, so these registrations are outside the
+// heap-free guarantee of the interpreter.
+static void legacyATHandler(const char* args, void* context) {
+    customATCommands[(uintptr_t)context].handler(String(args));
+}
+
+static void legacyShellHandler(const char* args, void* context) {
+    customShellCommands[(uintptr_t)context].handler(String(args));
+}
+
 /**
  * @brief Register a custom AT command.
  * 
  * Example: registerATCommand("LED", ledHandler, "Control LED");
- *          Then user can type 'LED ON' in shell mode.
+ *          Then user can type 'AT+LED=1' in AT mode.
  * 
  * @param cmd     Command name (case-insensitive)
  * @param handler Function to call when command is received
  * @param help    Description shown in help menu
  */
 void registerATCommand(const String& cmd, const ATCommandHandler& handler, const String& help) {
+    // Reserved once, so the help strings referenced by defaultAT never move
+    customATCommands.reserve(AT_MAX_AT_COMMANDS);
+    if (customATCommands.size() >= AT_MAX_AT_COMMANDS) return;
+
     customATCommands.push_back({ "AT+" + cmd, handler, help });
+    uintptr_t index = customATCommands.size() - 1;
+    if (!defaultAT.registerATCommand(cmd.c_str(), legacyATHandler, customATCommands[index].help.c_str(), (void*)index)) {
+        customATCommands.pop_back();
+    }
+}
+
+bool registerATCommand(const char* cmd, ATCommandFunction handler, const char* help, void* context) {
+    return defaultAT.registerATCommand(cmd, handler, help, context);
 }
 
 /**
@@ -72,12 +136,87 @@ void registerATCommand(const String& cmd, const ATCommandHandler& handler, const
  * Example: registerShellCommand("LED", ledHandler, "Control LED");
  *          Then user can type 'LED ON' in shell mode.
  * 
- * @param cmd     Command name (case-insensitive)
+ * @param cmd     Command name (case-sensitive)
  * @param handler Function to call when command is received
  * @param help    Description shown in help menu
  */
 void registerShellCommand(const String& cmd, const ShellCommandHandler& handler, const String& help) {
+    customShellCommands.reserve(AT_MAX_SHELL_COMMANDS);
+    if (customShellCommands.size() >= AT_MAX_SHELL_COMMANDS) return;
+
     customShellCommands.push_back({ cmd, handler, help });
+    uintptr_t index = customShellCommands.size() - 1;
+    if (!defaultAT.registerShellCommand(cmd.c_str(), legacyShellHandler, customShellCommands[index].help.c_str(), (void*)index)) {
+        customShellCommands.pop_back();
+    }
+}
+
+bool registerShellCommand(const char* cmd, ShellCommandFunction handler, const char* help, void* context) {
+    return defaultAT.registerShellCommand(cmd, handler, help, context);
+}
+
+bool registerShellCommand(const char* cmd, ShellArgvFunction handler, const char* help, void* context) {
+    return defaultAT.registerShellCommand(cmd, handler, help, context);
+}
+
+void printBuiltinATHelp(Print& out) {
+    out.print("Built-in Commands:\r\n");
+    out.print("  AT           - Test\r\n");
+    out.print("  ATE0/ATE1    - Echo off/on\r\n");
+    out.print("  ATV0/ATV1    - Numeric/verbose result codes\r\n");
+    out.print("  ATQ0/ATQ1    - Result codes on/off\r\n");
+    out.print("  AT&V         - Show settings and bytes saved\r\n");
+    out.print("  AT+RST       - Reset system\r\n");
+    out.print("  AT+GMR       - Show version info\r\n");
+    out.print("  AT+RESTORE   - Clear user settings\r\n");
+    out.print("  AT+UART?     - Show UART settings\r\n");
+    out.print("  AT+UART=<baud>[,<data>,<stop>,<parity>,<flow>] - Set UART (baud 0: autobaud)\r\n");
+    out.print("  AT+UARTSTAT? - Show UART transport counters\r\n");
+    out.print("  AT+UARTSTAT=0 - Clear UART transport counters\r\n");
+    out.print("  AT+TCPSRV=<port>[,<telnet>] - Start TCP server (0: stop)\r\n");
+    out.print("  AT+TCPSRV?   - Show TCP server state and counters\r\n");
+    out.print("  AT+SYSRAM?   - Show system RAM usage\r\n");
+    out.print("  AT+SHELL     - Enter shell mode\r\n");
+    out.print("  AT+LOG       - Enter log mode\r\n");
+    out.print("  AT+SCHED=<ms>,<cmd> - Run AT command periodically\r\n");
+    out.print("  AT+SCHED?    - List scheduled jobs\r\n");
+    out.print("  AT+SCHEDDEL=<id> - Cancel scheduled job\r\n");
+    out.print("  AT+URC?      - Show URC queue counters\r\n");
+    out.print("  AT+URC=<0|1> - URC overflow: drop oldest/newest\r\n");
+    out.print("  AT+CMUX=0    - Enter 27.010 multiplexing mode\r\n");
+    out.print("  AT+CMUX?     - Show frame size and bytes dropped per channel\r\n");
+    out.print("  AT+IDLE?     - Show idle sleep policy and counters\r\n");
+    out.print("  AT+IDLE=<ms>[,<budget>] - Sleep after <ms> idle (0: off)\r\n");
+    out.print("  AT+TRACE=<0|1> - Stop/start RX/TX trace recording\r\n");
+    out.print("  AT+TRACE?    - Dump the trace (hex)\r\n");
+    out.print("  AT+LIMIT?    - Show input budget, rate limits and hit counters\r\n");
+    out.print("  AT+LIMIT=BUDGET|AT|SHELL|\"<cmd>\",<a>,<b> - Set input budget / rate limit\r\n");
+    out.print("  AT+LOOPSTAT? - Show loop interval / processing time histograms and worst calls\r\n");
+    out.print("  AT+LOOPSTAT=WARN,<ms> - Post +LOOPWARN when a loop takes <ms> or longer (0: off)\r\n");
+    out.print("  AT+LOOPSTAT=0 - Clear loop monitor counters\r\n");
+    out.print("  AT+CACHE?    - Show query cache entries and hit/miss counters\r\n");
+    out.print("  AT+CACHE=\"<query>\",<ttl ms> - Cache a query response (0: stop), AT+CACHE=0 clears\r\n");
+    out.print("  AT+HELP      - Show this help\r\n");
+}
+
+void printBuiltinShellHelp(Print& out) {
+    out.print("Built-in Shell Commands:\r\n");
+    out.print("  echo <text>                      - Print text\r\n");
+    out.print("  free [-b|-k|-m|-h] [-t] [-s n]   - Show memory usage\r\n");
+    out.print("  ping [args]                      - Network ping (if supported)\r\n");
+    out.print("  ifconfig                         - Show network config (if supported)\r\n");
+    out.print("  watch [-n sec] <command>         - Run command periodically\r\n");
+    out.print("  watch [-c id]                    - List / cancel periodic jobs\r\n");
+    out.print("  top                              - Show system tasks (if supported)\r\n");
+    out.print("  kill [pid]                       - Kill task by PID (if supported)\r\n");
+    out.print("  stty [-]echo                     - Enable/disable input echo\r\n");
+    out.print("  uartstat [-r]                    - Show/clear UART counters\r\n");
+    out.print("  run <name> | run -k              - Start/stop a script\r\n");
+    out.print("  script [[-d] <name> [<source>]]  - List/show/save/delete scripts\r\n");
+    out.print("  reboot                           - Restart system\r\n");
+    out.print("  shutdown                         - Shutdown system\r\n");
+    out.print("  exit                             - Exit shell mode\r\n");
+    out.print("  help                             - Show this message\r\n");
 }
 
 /**
@@ -86,24 +225,10 @@ void registerShellCommand(const String& cmd, const ShellCommandHandler& handler,
  * @return String containing the help message
  */
 String getATHelp() {
-    String help = "Built-in Commands:\r\n";
-    help += "  AT           - Test\r\n";
-    help += "  AT+RST       - Reset system\r\n";
-    help += "  AT+GMR       - Show version info\r\n";
-    help += "  AT+RESTORE   - Clear user settings\r\n";
-    help += "  AT+UART?     - Show UART baud\r\n";
-    help += "  AT+UART=9600 - Set UART baud\r\n";
-    help += "  AT+SYSRAM?   - Show system RAM usage\r\n";
-    help += "  AT+SHELL     - Enter shell mode\r\n";
-    help += "  AT+LOG       - Enter log mode\r\n";
-    help += "  AT+HELP      - Show this help\r\n";
-    help += "Custom Commands:\r\n";
-    if (customATCommands.empty()) {
-        help += "  No custom commands registered.\r\n";
-    }
-    for (const auto& c : customATCommands) {
-        help += "  " + c.command + "  - " + c.help + "\n";
-    }
+    String help;
+    StringPrint out(help);
+    printBuiltinATHelp(out);
+    defaultAT.printATHelp(out);
     return help;
 }
 
@@ -113,32 +238,21 @@ String getATHelp() {
  * @return String containing the help message
  */
 String getShellHelp() {
-    String help = "Built-in Shell Commands:\r\n";
-    help += "  echo <text>                      - Print text\r\n";
-    help += "  free [-b|-k|-m] [-t] [-s delay]  - Show memory usage\r\n";
-    help += "  ping [args]                      - Network ping (if supported)\r\n";
-    help += "  ifconfig                         - Show network config (if supported)\r\n";
-    help += "  top                              - Show system tasks (if supported)\r\n";
-    help += "  kill [pid]                       - Kill task by PID (if supported)\r\n";
-    help += "  reboot                           - Restart system\r\n";
-    help += "  shutdown                         - Shutdown system\r\n";
-    help += "  exit                             - Exit shell mode\r\n";
-    help += "  help                             - Show this message\r\n";
-    help += "Custom Commands:\r\n";
-    if (customShellCommands.empty()) {
-        help += "  No custom shell commands registered.\r\n";
-    }
-
-    for (const auto& c : customShellCommands) {
-        help += "  " + c.command + "  - " + c.help + "\r\n";
-    }
+    String help;
+    StringPrint out(help);
+    printBuiltinShellHelp(out);
+    defaultAT.printShellHelp(out);
     return help;
 }
 
 void log(const String& msg) {
-    if (inLogMode) {
-        atSerial->println(msg);
+    if (isCMUXActive()) {
+        cmuxLog(msg);
+    }
+    else if (inLogMode) {
+        atOutput->println(msg);
     }
+    tcpLog(msg);
 }
 
 // ----------------------------
@@ -151,6 +265,173 @@ String trim(const String& str) {
     return s;
 }
 
+int splitShellArgs(char* line, char* argv[], int maxArgs) {
+    // Words are written back over the line; the write position never passes the read position
+    char* r = line;
+    char* w = line;
+    int argc = 0;
+
+    while (true) {
+        while (*r == ' ' || *r == '\t') r++;
+        if (*r == '\0') break;
+        if (argc >= maxArgs) return SHELL_ARGS_TOO_MANY;
+        argv[argc++] = w;
+
+        char quote = 0;
+        for (; *r; r++) {
+            char c = *r;
+            if (quote) {
+                if (c == quote) {
+                    quote = 0;
+                    continue;
+                }
+                if (quote == '"' && c == '\\' && (r[1] == '"' || r[1] == '\\')) c = *++r;
+            }
+            else if (c == ' ' || c == '\t') {
+                break;
+            }
+            else if (c == '\'' || c == '"') {
+                quote = c;
+                continue;
+            }
+            else if (c == '\\') {
+                if (r[1] == '\0') return SHELL_ARGS_UNTERMINATED;
+                c = *++r;
+            }
+            *w++ = c;
+        }
+        if (quote) return SHELL_ARGS_UNTERMINATED;
+
+        bool last = (*r == '\0');
+        if (!last) r++;
+        *w++ = '\0';
+        if (last) break;
+    }
+    return argc;
+}
+
+void runShellArgv(char* line, ShellArgvFunction fn, void* context) {
+    char* argv[AT_SHELL_MAX_ARGS];
+    int argc = splitShellArgs(line, argv, AT_SHELL_MAX_ARGS);
+    if (argc == SHELL_ARGS_UNTERMINATED) {
+        atOutput->println("msh: unterminated quote");
+    }
+    else if (argc == SHELL_ARGS_TOO_MANY) {
+        atOutput->println("msh: too many arguments");
+    }
+    else if (argc > 0) {
+        fn(argc, argv, context);
+    }
+}
+
+// ----------------------------
+// Result Codes
+// ----------------------------
+
+void sendATResult(ATResultCode code) {
+    const char* text = (code == AT_RESULT_OK) ? "OK" : (code == AT_RESULT_BUSY) ? "BUSY" : "ERROR";
+    size_t verboseBytes = (atInfoSent ? 2 : 0) + strlen(text) + 2;
+    size_t sentBytes = 0;
+
+    noteCachedResult(code, atInfoSent);
+
+    if (!atQuiet) {
+        if (atVerbose) {
+            if (atInfoSent) {
+                atOutput->println();
+            }
+            atOutput->println(text);
+            sentBytes = verboseBytes;
+        } else {
+            atOutput->print((int)code);
+            atOutput->print('\r');
+            sentBytes = 2;
+        }
+    }
+    atTxSavedPending += verboseBytes - sentBytes;
+    atInfoSent = false;
+    lastATResult = code;
+}
+
+ATResultCode lastATResultCode() {
+    return lastATResult;
+}
+
+void sendATInfo(const String& line) {
+    atOutput->println(line);
+    atInfoSent = true;
+}
+
+void sendATInfo(const char* line) {
+    atOutput->println(line);
+    atInfoSent = true;
+}
+
+Print& beginATInfo() {
+    atInfoSent = true;
+    return *atOutput;
+}
+
+void beginATResponse() {
+    atInfoSent = false;
+}
+
+void noteATBytesSaved(uint32_t bytes) {
+    atTxSavedPending += bytes;
+}
+
+// Close the accounting of one command line (input echo + response)
+void endATTransaction() {
+    atTxSavedLast = atTxSavedPending;
+    atTxSavedTotal += atTxSavedPending;
+    atTxSavedPending = 0;
+}
+
+void storeATSession(ATSession& session) {
+    session = { atOutput, inShellMode, inLogMode, atEcho, atVerbose, atQuiet, shellEcho };
+}
+
+void loadATSession(const ATSession& session) {
+    atOutput = session.output ? session.output : atSerial;
+    inShellMode = session.shellMode;
+    inLogMode = session.logMode;
+    atEcho = session.echo;
+    atVerbose = session.verbose;
+    atQuiet = session.quiet;
+    shellEcho = session.shellEcho;
+}
+
+/**
+ * @brief Handle a chain of basic settings such as "ATE0", "ATV0Q1".
+ * 
+ * @param cmd Upper-cased command line
+ * @return true if the line consisted of E/V/Q settings only
+ */
+static bool handleBasicSettings(const char* cmd) {
+    if (strlen(cmd) < 3 || strncmp(cmd, "AT", 2) != 0) return false;
+
+    bool echo = atEcho, verbose = atVerbose, quiet = atQuiet;
+    const char* p = cmd + 2;
+    while (*p) {
+        char setting = *p++;
+        int value = 0;
+        if (isDigit(*p)) {
+            value = *p++ - '0';
+        }
+        if (value > 1) return false;
+        if (setting == 'E') echo = value;
+        else if (setting == 'V') verbose = value;
+        else if (setting == 'Q') quiet = value;
+        else return false;
+    }
+
+    atEcho = echo;
+    atVerbose = verbose;
+    atQuiet = quiet;
+    sendATResult(AT_RESULT_OK);
+    return true;
+}
+
 // ----------------------------
 // AT Command Handler
 // ----------------------------
@@ -163,30 +444,35 @@ void onShutdown(std::function<void()> callback) {
     shutdownCallback = callback;
 }
 
-long currentBaudRate = SERIAL_BAUD_RATE;
-
 void processATCommand(const String& fullCmd) {
-    String cmd = trim(fullCmd);
-    if (cmd.length() == 0) return;
-
-    // Log mode only respond to EXIT
-    if (inLogMode) {
-        if (cmd.equalsIgnoreCase("EXIT")) {
-            inLogMode = false;
-            atSerial->println("OK");
-        }
-        return;
-    }
-
-    // Convert to uppercase
-    cmd.toUpperCase();
+    defaultAT.processATCommand(fullCmd.c_str());
+}
 
+bool processBuiltinATCommand(const char* cmd) {
     // Built-in command matching
-    if (cmd == "AT") {
-        atSerial->println("OK");
+    if (strcmp(cmd, "AT") == 0) {
+        sendATResult(AT_RESULT_OK);
+    }
+    else if (handleBasicSettings(cmd)) {
+        // ATE / ATV / ATQ (result already sent)
+    }
+    else if (strcmp(cmd, "AT&V") == 0) {
+        Print& out = beginATInfo();
+        out.print("E");
+        out.print(atEcho ? 1 : 0);
+        out.print(" V");
+        out.print(atVerbose ? 1 : 0);
+        out.print(" Q");
+        out.println(atQuiet ? 1 : 0);
+        out.print("+TXSAVE:");
+        out.print(atTxSavedLast);
+        out.print(",");
+        out.println(atTxSavedTotal);
+        sendATResult(AT_RESULT_OK);
     }
-    else if (cmd == "AT+RST") {
-        atSerial->println("OK");
+    else if (strcmp(cmd, "AT+RST") == 0) {
+        sendATResult(AT_RESULT_OK);
+        atOutput->flush();
         delay(100);
         #ifdef AIR001
             void(* resetFunc) (void) = 0;
@@ -195,56 +481,45 @@ void processATCommand(const String& fullCmd) {
             ESP.restart();
         #endif
     }
-    else if (cmd == "AT+GMR") {
-        atSerial->print(SYSTEM_NAME);
-        atSerial->print(" ");
-        atSerial->println(SYSTEM_VERSION);
-        atSerial->print("User Program Name: ");
-        atSerial->println(USER_PROGRAM_NAME);
-        atSerial->print("User Program Version: ");
-        atSerial->println(USER_PROGRAM_VERSION);
-        atSerial->print("Compiled: ");
-        atSerial->println(COMPILED_DATETIME);
-        atSerial->println(" ");
-        atSerial->println("OK");
-    }
-    else if (cmd == "AT+RESTORE") {
-        atSerial->println("OK");
+    else if (strcmp(cmd, "AT+GMR") == 0) {
+        sendATInfo(SYSTEM_NAME " " SYSTEM_VERSION);
+        sendATInfo("User Program Name: " USER_PROGRAM_NAME);
+        sendATInfo("User Program Version: " USER_PROGRAM_VERSION);
+        sendATInfo("Compiled: " COMPILED_DATETIME);
+        sendATResult(AT_RESULT_OK);
+    }
+    else if (strcmp(cmd, "AT+RESTORE") == 0) {
+        sendATResult(AT_RESULT_OK);
         
-        atSerial->flush(); // Ensure serial port output is complete
+        atOutput->flush(); // Ensure serial port output is complete
+
+        // Saved settings (e.g. the baud rate) fall back to defaults after reboot
+        settingsClear();
 
         // If the user has registered for a recovery callback, execute
         if (restoreCallback) {
             restoreCallback();
         }
     }
-    else if (cmd.startsWith("AT+UART")) {
-        if (cmd == "AT+UART?") {
-            atSerial->print("+UART:");
-            atSerial->println(currentBaudRate);
-            atSerial->println();
-            atSerial->println("OK");
-        }
-        else if (cmd.startsWith("AT+UART=")) {
-            long baud = cmd.substring(8).toInt();
-            if (baud <= 0) {
-                atSerial->println("ERROR");
-            }
-            if (baud > 0) {
-                atSerial->end();
-                atSerial->begin(baud);
-                currentBaudRate = baud;
-            }
-            atSerial->println("OK");
-        }
+    else if (strncmp(cmd, "AT+TCPSRV", 9) == 0) {
+        handleTCPATCommand(cmd);
+    }
+    else if (strncmp(cmd, "AT+UARTSTAT", 11) == 0) {
+        handleUARTStatATCommand(cmd);
     }
-    else if (cmd == "AT+LOG") {
+    else if (strncmp(cmd, "AT+UART", 7) == 0) {
+        handleUARTATCommand(cmd);
+    }
+    else if ((strcmp(cmd, "AT+LOG") == 0 || strcmp(cmd, "AT+SHELL") == 0) && isCMUXActive()) {
+        // Log and shell have their own channels while multiplexing
+        sendATResult(AT_RESULT_ERROR);
+    }
+    else if (strcmp(cmd, "AT+LOG") == 0) {
         inLogMode = true;
-        atSerial->println("Entering log mode. Type 'EXIT' to return.");
+        atOutput->println("Entering log mode. Type 'EXIT' to return.");
     }
-    else if (cmd == "AT+SYSRAM?") {
+    else if (strcmp(cmd, "AT+SYSRAM?") == 0) {
         size_t total = 0;
-        size_t free = 0;
         size_t used = 0;
 
         // ========================
@@ -254,12 +529,12 @@ void processATCommand(const String& fullCmd) {
         #if defined(ESP32)
             // ESP32: has full APIs
             total = ESP.getHeapSize();
-            free = ESP.getFreeHeap();
+            size_t free = ESP.getFreeHeap();
             used = total - free;
 
         #elif defined(ESP8266)
             // ESP8266: Only getFreeHeap() is available
-            free = ESP.getFreeHeap();
+            size_t free = ESP.getFreeHeap();
 
             // Total RAM
             total = TOTAL_DRAM_SIZE;
@@ -287,543 +562,334 @@ void processATCommand(const String& fullCmd) {
             }
         #endif
 
-        // Output in standard format
-        atSerial->print("+SYSRAM:");
-        atSerial->print(total);
-        atSerial->print(",");
-        atSerial->print(used);
-        atSerial->println();
-        atSerial->println();
-        atSerial->println("OK");
+        // Output in standard format, built on the stack as one line
+        char line[56] = "+SYSRAM:";
+        size_t len = strlen(line);
+        len += formatBytes(line + len, sizeof(line) - len, total, BYTES_B);
+        line[len++] = ',';
+        formatBytes(line + len, sizeof(line) - len, used, BYTES_B);
+        sendATInfo(line);
+        sendATResult(AT_RESULT_OK);
     }
-    else if (cmd == "AT+SHELL") {
+    else if (strcmp(cmd, "AT+SHELL") == 0) {
         inShellMode = true;
-        atSerial->println("Entering shell mode. Type 'exit' to return.");
-        atSerial->println();
-        atSerial->print(SYSTEM_NAME);
-        atSerial->print(" ");
-        atSerial->print(SYSTEM_VERSION);
-        atSerial->println(" built-in shell (msh)");
-        atSerial->println("Enter 'help' for a list of built-in commands.");
-        shellFirstPromptDone = false;
-    }
-    else if (cmd == "AT+HELP" || cmd == "AT+?") {
-        atSerial->print(getATHelp());
-        atSerial->println("OK");
+        atOutput->println("Entering shell mode. Type 'exit' to return.");
+        atOutput->println();
+        atOutput->print(SYSTEM_NAME);
+        atOutput->print(" ");
+        atOutput->print(SYSTEM_VERSION);
+        atOutput->println(" built-in shell (msh)");
+        atOutput->println("Enter 'help' for a list of built-in commands.");
+    }
+    else if (strncmp(cmd, "AT+SCHED", 8) == 0) {
+        handleSchedATCommand(cmd);
+    }
+    else if (strncmp(cmd, "AT+CMUX", 7) == 0) {
+        handleCMUXATCommand(cmd);
+    }
+    else if (strncmp(cmd, "AT+URC", 6) == 0) {
+        handleURCATCommand(cmd);
+    }
+    else if (strncmp(cmd, "AT+IDLE", 7) == 0) {
+        handleIdleATCommand(cmd);
+    }
+    else if (strncmp(cmd, "AT+LOOPSTAT", 11) == 0) {
+        handleLoopStatATCommand(cmd);
+    }
+    else if (strncmp(cmd, "AT+CACHE", 8) == 0) {
+        handleCacheATCommand(cmd);
+    }
+    else if (strncmp(cmd, "AT+LIMIT", 8) == 0) {
+        handleLimitATCommand(cmd);
+    }
+    else if (strncmp(cmd, "AT+TRACE", 8) == 0) {
+        handleTraceATCommand(cmd);
     }
     else {
-        // Attempt to match user-defined commands
-        bool matched = false;
-        for (auto& c : customATCommands) {
-            if (cmd.startsWith(c.command)) {
-                String args = "";
-                if (cmd.length() > c.command.length()) {
-                    args = cmd.substring(c.command.length());
-                }
-                c.handler(args);
-                matched = true;
-                break;
-            }
-        }
-        if (!matched) {
-            atSerial->println("error");
-        }
+        return false;
     }
+    return true;
 }
 
 // ----------------------------
 // Free Command Handler
 // ----------------------------
-static void handleFreeCommand(const String& args) {
+static void handleFreeCommand(int argc, char* argv[], void*) {
     // Parse arguments
     bool showTotal = false;
     int delaySec = -1;  // -1 = no loop
-    long unit = 1024;   // default: KB
-
-    String arg = args;
-    arg.trim();
-
-    int index = 0;
-    while (index < arg.length()) {
-        int space = arg.indexOf(' ', index);
-        String token = (space == -1) ? arg.substring(index) : arg.substring(index, space);
-        token.trim();
-        if (token == "-b") unit = 1;
-        else if (token == "-k") unit = 1024;
-        else if (token == "-m") unit = 1024 * 1024;
-        else if (token == "-t") showTotal = true;
-        else if (token == "-s" && space != -1) {
-            int nextSpace = arg.indexOf(' ', space + 1);
-            String delayStr = (nextSpace == -1) ? arg.substring(space + 1) : arg.substring(space + 1, nextSpace);
-            delaySec = delayStr.toInt();
+    ByteUnit unit = BYTES_K;  // default: KB
+
+    for (int i = 1; i < argc; i++) {
+        const char* opt = argv[i];
+        if (strcmp(opt, "-b") == 0) unit = BYTES_B;
+        else if (strcmp(opt, "-k") == 0) unit = BYTES_K;
+        else if (strcmp(opt, "-m") == 0) unit = BYTES_M;
+        else if (strcmp(opt, "-h") == 0) unit = BYTES_HUMAN;
+        else if (strcmp(opt, "-t") == 0) showTotal = true;
+        else if (strcmp(opt, "-s") == 0 && i + 1 < argc) {
+            delaySec = atoi(argv[++i]);
             if (delaySec < 1) delaySec = 1;
-            index = nextSpace == -1 ? arg.length() : nextSpace + 1;
-            continue;
         }
-        index = space == -1 ? arg.length() : space + 1;
+        else {
+            atOutput->println("Usage: free [-b|-k|-m|-h] [-t] [-s delay]");
+            return;
+        }
     }
 
-    // Helper: format number (right-aligned, fixed width)
-    auto formatNum = [](long value, int width = 12) -> String {
-        String s = String(value);
-        while (s.length() < width) s = " " + s;
-        return s;
-    };
-
-    // Helper: format string (right-aligned, fixed width)
-    auto formatStr = [](const String& str, int width = 12) -> String {
-        String s = str;
-        while (s.length() < width) s = " " + s;
-        return s;
+    #if defined(ESP32) || defined(ESP8266) || defined(AIR001)
+    // One table row: label column, then total / used / free
+    auto printRow = [unit](Print& out, const char* label, size_t total, size_t used, size_t free) {
+        printPadded(out, label, -9);
+        printBytes(out, total, unit, 12);
+        printBytes(out, used, unit, 12);
+        printBytes(out, free, unit, 12);
+        out.println();
     };
+    #endif
 
-    // Helper: print memory info
-    auto printMem = [unit, showTotal, formatNum, formatStr](HardwareSerial* ser) {
-        ser->print("         ");
-        ser->print(formatStr("total", 12));
-        ser->print(formatStr("used", 12));
-        ser->print(formatStr("free", 12));
-        ser->println();
+    Print& out = *atOutput;
+    printPadded(out, "", 9);
+    printPadded(out, "total", 12);
+    printPadded(out, "used", 12);
+    printPadded(out, "free", 12);
+    out.println();
 
-        #if defined(ESP32)
-            // Internal RAM
-            size_t total_iram = ESP.getHeapSize();
-            size_t free_iram = ESP.getFreeHeap();
-            size_t used_iram = total_iram - free_iram;
-            
-            long total_iram_u = total_iram / unit;
-            long used_iram_u = used_iram / unit;
-            long free_iram_u = free_iram / unit;
-
-            ser->print("Ram:     ");
-            ser->print(formatNum(total_iram_u));
-            ser->print(formatNum(used_iram_u));
-            ser->print(formatNum(free_iram_u));
-
-            ser->println();
-
-            // Detect and print PSRAM(s)
-            std::vector<size_t> psram_sizes;
-            std::vector<size_t> psram_free;
-
-            // Try to detect PSRAM via heap_caps
-            #ifdef CONFIG_SPIRAM
-                // Use heap_caps to get PSRAM size and free
-                size_t psram_total = heap_caps_get_total_size(MALLOC_CAP_SPIRAM);
-                if (psram_total > 0) {
-                    size_t psram_free_size = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
-                    psram_sizes.push_back(psram_total);
-                    psram_free.push_back(psram_free_size);
-                }
-            #endif
-
-            // Optional: support multiple PSRAM chips (if your hardware supports it)
-            // This is a placeholder; actual multi-PSRAM detection depends on hardware/driver
-            // For now, assume at most one PSRAM block via SPIRAM
-
-            for (int i = 0; i < psram_sizes.size(); i++) {
-                size_t total_p = psram_sizes[i];
-                size_t free_p = psram_free[i];
-                size_t used_p = total_p - free_p;
-
-                long total_p_u = total_p / unit;
-                long used_p_u = used_p / unit;
-                long free_p_u = free_p / unit;
-
-                ser->print("PSRam("); ser->print(i); ser->print("):");
-                ser->print(formatNum(total_p_u));
-                ser->print(formatNum(used_p_u));
-                ser->print(formatNum(free_p_u));
-                ser->println();
-            }
+    #if defined(ESP32)
+        // Internal RAM
+        size_t total_iram = ESP.getHeapSize();
+        size_t free_iram = ESP.getFreeHeap();
+        size_t used_iram = total_iram - free_iram;
+        printRow(out, "Ram:", total_iram, used_iram, free_iram);
+
+        // PSRAM (the heap reports all SPIRAM as one block)
+        size_t total_psram = 0;
+        size_t free_psram = 0;
+        #ifdef CONFIG_SPIRAM
+            total_psram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM);
+            free_psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+        #endif
+        if (total_psram > 0) {
+            printRow(out, "PSRam(0):", total_psram, total_psram - free_psram, free_psram);
+        }
 
-            // Print Total if requested
-            if (showTotal) {
-                size_t total_mem = total_iram;
-                size_t used_mem = used_iram;
-                size_t free_mem = free_iram;
-
-                for (size_t sz : psram_sizes) total_mem += sz;
-                // Note: used from PSRAM is already (total - free), so just sum free and subtract
-                size_t total_free_psram = 0;
-                for (size_t f : psram_free) total_free_psram += f;
-                free_mem += total_free_psram;
-                used_mem = total_mem - free_mem;
-
-                long total_mem_u = total_mem / unit;
-                long used_mem_u = used_mem / unit;
-                long free_mem_u = free_mem / unit;
-
-                ser->print("Total:   ");
-                ser->print(formatNum(total_mem_u));
-                ser->print(formatNum(used_mem_u));
-                ser->print(formatNum(free_mem_u));
-                ser->println();
-            }
-        #elif defined(ESP8266)
-            // IRAM heap
-            size_t total_iram_heap = TOTAL_IRAM_SIZE;
-
-            ser->print("IRam:    ");
-            ser->print(formatNum(total_iram_heap));
-            ser->print(formatStr("N/A"));
-            ser->print(formatStr("N/A"));
-            ser->println();
-
-            // DRAM heap
-            size_t free_dram_heap = ESP.getFreeHeap();
-            size_t total_dram_heap = TOTAL_DRAM_SIZE;
-            size_t used_dram_heap = (free_dram_heap < total_dram_heap) ? total_dram_heap - free_dram_heap : 0;
-            if (used_dram_heap > total_dram_heap) used_dram_heap = total_dram_heap;
-
-            long total_dram_heap_u = total_dram_heap / unit;
-            long used_dram_heap_u = used_dram_heap / unit;
-            long free_dram_heap_u = free_dram_heap / unit;
-
-            ser->print("DRam:    ");
-            ser->print(formatNum(total_dram_heap_u));
-            ser->print(formatNum(used_dram_heap_u));
-            ser->print(formatNum(free_dram_heap_u));
-            ser->println();
-
-            // Print Total if requested
-            if (showTotal) {
-                size_t total_mem = total_iram_heap + total_dram_heap;
-                size_t used_mem = used_dram_heap;
-                size_t free_mem = free_dram_heap;
-
-                long total_mem_u = total_mem / unit;
-                long used_mem_u = used_mem / unit;
-                long free_mem_u = free_mem / unit;
-
-                ser->print("Total:   ");
-                ser->print(formatNum(total_mem_u));
-                ser->print(formatNum(used_mem_u));
-                ser->print(formatNum(free_mem_u));
-                ser->println();
-            }
-        #elif defined(AIR)
-            extern uint32_t _heap_start;
-            extern uint32_t _heap_end;
-            char* heap_brk = (char*)sbrk(0);
-            char* heap_start = (char*)&_heap_start;
-            char* heap_end = (char*)&_heap_end;
-            size_t total = heap_end - heap_start;
-            size_t used = ((char*)heap_brk >= heap_start && (char*)heap_brk <= heap_end)
-                       ? (char*)heap_brk - heap_start : 0;
-            size_t free = (used < total) ? total - used : 0;
-
-            long total_u = total / unit;
-            long used_u = used / unit;
-            long free_u = free / unit;
-
-            ser->print("Ram:     ");
-            ser->print(formatRight(total_u));
-            ser->print(formatRight(used_u));
-            ser->print(formatRight(free_u));
-            ser->println();
-        #endif // platform
-    };
-    // Execute print (loop if needed), but allow 'exit' to break
-    do {
-        printMem(atSerial);
-
-        // Check for 'exit' only if in loop mode (delaySec > 0)
-        if (delaySec > 0) {
-            atSerial->println("Type 'exit' to stop monitoring.");
-            unsigned long nextTime = millis() + delaySec * 1000;
-            atSerial->println(); // separator
-
-            // Wait up to delaySec seconds, but listen for "exit"
-            while (millis() < nextTime) {
-                if (atSerial->available()) {
-                    String input = atSerial->readStringUntil('\n');
-                    input.trim();
-                    if (input.equalsIgnoreCase("exit") || input.equalsIgnoreCase("q")) {
-                        return; // Exit the entire command immediately
-                    }
-                    // Optionally: echo back or ignore other commands
-                    // You might want to buffer them or handle asynchronously
-                }
-                delay(10); // Small delay to avoid watchdog/WiFi issues
-            }
+        // Print Total if requested
+        if (showTotal) {
+            size_t total_mem = total_iram + total_psram;
+            size_t free_mem = free_iram + free_psram;
+            printRow(out, "Total:", total_mem, total_mem - free_mem, free_mem);
+        }
+    #elif defined(ESP8266)
+        // IRAM heap
+        size_t total_iram_heap = TOTAL_IRAM_SIZE;
+        printPadded(out, "IRam:", -9);
+        printBytes(out, total_iram_heap, unit, 12);
+        printPadded(out, "N/A", 12);
+        printPadded(out, "N/A", 12);
+        out.println();
+
+        // DRAM heap
+        size_t free_dram_heap = ESP.getFreeHeap();
+        size_t total_dram_heap = TOTAL_DRAM_SIZE;
+        size_t used_dram_heap = (free_dram_heap < total_dram_heap) ? total_dram_heap - free_dram_heap : 0;
+        printRow(out, "DRam:", total_dram_heap, used_dram_heap, free_dram_heap);
+
+        // Print Total if requested
+        if (showTotal) {
+            printRow(out, "Total:", total_iram_heap + total_dram_heap, used_dram_heap, free_dram_heap);
+        }
+    #elif defined(AIR001)
+        extern uint32_t _heap_start;
+        extern uint32_t _heap_end;
+        char* heap_brk = (char*)sbrk(0);
+        char* heap_start = (char*)&_heap_start;
+        char* heap_end = (char*)&_heap_end;
+        size_t total = heap_end - heap_start;
+        size_t used = (heap_brk >= heap_start && heap_brk <= heap_end) ? heap_brk - heap_start : 0;
+        size_t free = (used < total) ? total - used : 0;
+        printRow(out, "Ram:", total, used, free);
+    #endif // platform
+
+    // Periodic refresh runs as a scheduled job so the main loop never blocks
+    if (delaySec > 0 && !isSchedulerFiring()) {
+        char cmdLine[16] = "free";
+        if (unit == BYTES_B) strcat(cmdLine, " -b");
+        else if (unit == BYTES_M) strcat(cmdLine, " -m");
+        else if (unit == BYTES_HUMAN) strcat(cmdLine, " -h");
+        if (showTotal) strcat(cmdLine, " -t");
+
+        int id = scheduleCommand(JOB_SHELL, cmdLine, delaySec * 1000UL);
+        if (id < 0) {
+            atOutput->println("free: job table full");
+            return;
         }
-    } while (delaySec > 0);
+        atOutput->print("Type 'watch -c ");
+        atOutput->print(id);
+        atOutput->println("' to stop monitoring.");
+    }
 }
 // ----------------------------
 // Shutdown Command Handler
 // ----------------------------
 static void handleShutdownCommand() {
-    atSerial->println();
+    atOutput->println();
     // Check if the startup source is configured
     if (!wakeupConfigured) {
-        atSerial->println("The startup related logic is not enabled, so it may not be able to start up.");
+        atOutput->println("The startup related logic is not enabled, so it may not be able to start up.");
     }
 
     // Prompt to shut down
-    atSerial->println("The system is going down for shutdown NOW!");
+    atOutput->println("The system is going down for shutdown NOW!");
 
     // If a shutdown callback is registered, execute
     if (shutdownCallback) {
         shutdownCallback();
     }
 
+    atOutput->flush();
+
     #if defined(ESP32)
         esp_deep_sleep_start();
     #elif defined(ESP8266)
         ESP.deepSleep(0);
     #elif defined(AIR001)
-        atSerial->println("Air001 currently does not support shutdown commands.");
+        atOutput->println("Air001 currently does not support shutdown commands.");
     #endif
 }
 
 // ----------------------------
-// Shell Mode Handler
+// Shell Command Dispatcher
 // ----------------------------
-void handleShellMode() {
-    static String line = "";
-    static bool expectLF = false;  // Status: Waiting for \n (as just received \r)
+void processShellCommand(const String& fullCmd) {
+    defaultAT.processShellCommand(fullCmd.c_str());
+}
 
-    if (!shellFirstPromptDone && inShellMode) {
-        atSerial->println();
-        atSerial->print("msh> ");
-        shellFirstPromptDone = true;
+static void handleEchoCommand(int argc, char* argv[], void*) {
+    for (int i = 1; i < argc; i++) {
+        if (i > 1) atOutput->print(' ');
+        atOutput->print(argv[i]);
     }
+    atOutput->println();
+}
 
-    while (atSerial->available()) {
-        char c = atSerial->read();
+static void handleSttyCommand(int argc, char* argv[], void*) {
+    if (argc == 1) {
+        atOutput->println(shellEcho ? "echo" : "-echo");
+    }
+    else if (argc == 2 && (strcmp(argv[1], "echo") == 0 || strcmp(argv[1], "-echo") == 0)) {
+        shellEcho = (argv[1][0] != '-');
+    }
+    else {
+        atOutput->println("Usage: stty [[-]echo]");
+    }
+}
 
-        // handle line breaks
-        if (c == '\r') {
-            // Received CR, waiting for LF (entering CRLF mode)
-            expectLF = true;
-            continue;  // Not processed, waiting for the next character
+// Built-ins that take argc / argv; the rest parse the raw text after their name
+static const struct {
+    const char* name;
+    ShellArgvFunction fn;
+} argvBuiltins[] = {
+    { "echo", handleEchoCommand },
+    { "free", handleFreeCommand },
+    { "stty", handleSttyCommand },
+    { "uartstat", handleUARTStatCommand },
+    { "watch", handleWatchCommand }
+};
+
+bool processBuiltinShellCommand(char* cmdLine) {
+    size_t nameLen = strcspn(cmdLine, " \t");
+    for (const auto& builtin : argvBuiltins) {
+        if (strlen(builtin.name) == nameLen && strncmp(cmdLine, builtin.name, nameLen) == 0) {
+            runShellArgv(cmdLine, builtin.fn, nullptr);
+            return true;
         }
-        else if (c == '\n') {
-            if (expectLF) {
-                // It is the LF part of CRLF, processed normally
-                expectLF = false;
-            }
-            // If! expectLF， Explanation: It is a separate LF and can be processed normally (compatible)
+    }
 
-            // execute command
-            if (line.length() > 0) {
-                atSerial->println();  // Line break, end input display
+    if (strcmp(cmdLine, "exit") == 0 || strcmp(cmdLine, "EXIT") == 0) {
+        sendATResult(AT_RESULT_OK);
+        inShellMode = false;
+    }
+    else if (strcmp(cmdLine, "reboot") == 0) {
+        atOutput->print(__DATE__);
+        atOutput->print(" ");
+        atOutput->print(__TIME__);
+        atOutput->println();
+        atOutput->println("The system is going down for reboot NOW!");
+        atOutput->flush();
+        delay(100);
+        #ifdef AIR001
+            void(* resetFunc) (void) = 0;
+            resetFunc();
+        #else
+            ESP.restart();
+        #endif
+    }
+    else if (strcmp(cmdLine, "shutdown") == 0) {
+        handleShutdownCommand();
+    }
+    else if (strncmp(cmdLine, "run ", 4) == 0) {
+        handleRunCommand(cmdLine + 4);
+    }
+    else if (strcmp(cmdLine, "run") == 0) {
+        handleRunCommand("");
+    }
+    else if (strncmp(cmdLine, "script ", 7) == 0) {
+        handleScriptCommand(cmdLine + 7);
+    }
+    else if (strcmp(cmdLine, "script") == 0) {
+        handleScriptCommand("");
+    }
+    else {
+        return false;
+    }
+    return true;
+}
 
-                String cmdLine = trim(line);
-                String args = trim(line);
-                if (cmdLine == "help" || cmdLine == "HELP" || cmdLine == "?") {
-                    atSerial->println();
-                    atSerial->print(getShellHelp());
-                }
-                else if (cmdLine =="exit" || cmdLine =="EXIT") {
-                    atSerial->println("OK");
-                    inShellMode = false;
-                    line = "";
-                    return;
-                }
-                else if (cmdLine == "reboot") {
-                    atSerial->print(__DATE__);
-                    atSerial->print(" ");
-                    atSerial->print(__TIME__);
-                    atSerial->println();
-                    atSerial->println("The system is going down for reboot NOW!");
-                    delay(100);
-                    #ifdef AIR001
-                        void(* resetFunc) (void) = 0;
-                        resetFunc();
-                    #else
-                        ESP.restart();
-                    #endif
-                }
-                else if (cmdLine == "shutdown") {
-                    handleShutdownCommand();
-                }
-                else if (cmdLine.startsWith("echo ")) {
-                    String output = cmdLine.substring(5);
-                    output.trim();
-                    atSerial->println(output);
-                }
-                else if (cmdLine == "echo") {
-                    atSerial->println();
-                }
-                else if (cmdLine.startsWith("free ")) {
-                    handleFreeCommand(args);
-                }
-                else if (cmdLine == "free") {
-                    handleFreeCommand(args);
-                }
-                else {
-                    // Check built-in extended commands (ping, ifconfig, top, kill)
-                    static const char* builtinCmds[] = { "ping", "ifconfig", "top", "kill" };
-
-                    bool isBuiltin = false;
-                    for (const auto& name : builtinCmds) {
-                        std::string nameStr = std::string(name) + " ";
-                        if (cmdLine.startsWith(nameStr.c_str())) {
-                            isBuiltin = true;
-                            bool found = false;
-                            for (auto& c : customShellCommands) {
-                                if (c.command == name) {
-                                    c.handler(args);
-                                    found = true;
-                                    break;
-                                }
-                            }
-                            if (!found) {
-                                atSerial->println("msh: applet not found");
-                            }
-                            break;
-                        }
-                        if (cmdLine == name) {
-                            isBuiltin = true;
-                            bool found = false;
-                            for (auto& c : customShellCommands) {
-                                if (c.command == name) {
-                                    c.handler("");
-                                    found = true;
-                                    break;
-                                }
-                            }
-                            if (!found) {
-                                atSerial->println("msh: applet not found");
-                            }
-                            break;
-                        }
-                    }
-
-                    // If a known builtin command, execute it and return
-                    if (isBuiltin) {
-                        // Output a new prompt
-                        atSerial->print("msh> ");
-                        line = "";
-                        return;
-                    }
-
-                    // If not a known builtin, check all custom commands
-                    int spaceIndex = cmdLine.indexOf(' ');
-                    String cmdName = (spaceIndex == -1) ? cmdLine : cmdLine.substring(0, spaceIndex);
-                    String args = (spaceIndex == -1) ? "" : cmdLine.substring(spaceIndex + 1);
-
-                    cmdName.trim();
-                    args.trim();
-
-                    bool matched = false;
-                    for (auto& c : customShellCommands) {
-                        if (cmdName == c.command) {
-                            c.handler(args);
-                            matched = true;
-                            break;
-                        }
-                    }
-
-                    if (!matched) {
-                        atSerial->println("msh: not found");
-                    }
-                }
-            }
+// ----------------------------
+// Shell Mode Handler
+// ----------------------------
 
-            // Output a new prompt
-            atSerial->print("msh> ");
-            line = "";
-        }
-        else {
-            // Non line breaking characters: Reset expectLF (to prevent timeout waiting)
-            if (expectLF) {
-                // Received non \n characters, indicating that \r is not part of CRLF and should be considered invalid
-                expectLF = false;
-            }
+void startShellPrompt() {
+    defaultAT.startPrompt();
+}
 
-            if (c == 8 || c == 127) { // Backspace/Delete
-                if (line.length() > 0) {
-                    line.remove(line.length() - 1);
-                    atSerial->print("\b \b");
-                }
-            }
-            else if (c >= 32 && c < 127) { // Printable
-                line += c;
-                atSerial->print(c);
-            }
-        }
-    }
+void redrawShellPrompt() {
+    defaultAT.redrawPrompt();
+}
+
+void feedShellChar(char c) {
+    defaultAT.feedShell(c);
 }
 
 // ----------------------------
-// Main Loop Handler
+// AT Line Handler
 // ----------------------------
 
-void handleATCommands() {
-    if (inShellMode) {
-        handleShellMode();
-        return;
-    }
+void feedATChar(char c) {
+    defaultAT.feedAT(c);
+}
 
-    if (inLogMode) {
-        static char prevChar = 0;
-        while (atSerial->available()) {
-            char c = atSerial->read();
+// ----------------------------
+// Main Loop Handler
+// ----------------------------
 
-            if (c == '\n' && prevChar == '\r') {
-                inputBuffer = trim(inputBuffer);
-                if (inputBuffer.equalsIgnoreCase("EXIT")) {
-                    inLogMode = false;
-                    atSerial->println("OK");
-                }
-                inputBuffer = "";
-                prevChar = 0;
-            }
-            else if (c == '\r') {
-                prevChar = c;
-            }
-            else if (c == '\n') {
-                inputBuffer = trim(inputBuffer);
-                if (inputBuffer.equalsIgnoreCase("EXIT")) {
-                    inLogMode = false;
-                    atSerial->println("OK");
-                }
-                inputBuffer = "";
-                prevChar = 0;
-            }
-            else {
-                if (prevChar == '\r') {
-                    inputBuffer += '\r';
-                }
-                inputBuffer += c;
-                prevChar = 0;
-            }
-        }
-        return;
+void handleATCommands() {
+    beginLoopMonitor();
+    serviceUARTStats();
+    servicePower();
+    serviceScheduler();
+    serviceScript();
+    serviceURCQueue();
+
+    if (isCMUXActive()) {
+        serviceCMUX();
+    } else if (!serviceAutobaud()) {
+        defaultAT.poll();
     }
 
-    static char prevChar = 0;
-    while (atSerial->available()) {
-        char c = atSerial->read();
-
-        if (c == '\n' && prevChar == '\r') {
-            inputBuffer = trim(inputBuffer);
-            if (!inputBuffer.isEmpty()) {
-                processATCommand(inputBuffer);
-            }
-            inputBuffer = "";
-            prevChar = 0;
-        }
-        else if (c == '\r') {
-            prevChar = c;
-        }
-        else if (c == '\n') {
-            inputBuffer = trim(inputBuffer);
-            if (!inputBuffer.isEmpty()) {
-                processATCommand(inputBuffer);
-            }
-            inputBuffer = "";
-            prevChar = 0;
-        }
-        else {
-            if (prevChar == '\r') {
-                inputBuffer += '\r';
-            }
-            inputBuffer += c;
-            prevChar = 0;
-        }
-    }
-}
\ No newline at end of file
+    serviceTCP();
+    serviceTrace();
+    serviceUARTConfig();
+    endUARTStatsLoop();
+    endLoopMonitor();
+}
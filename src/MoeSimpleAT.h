@@ -11,6 +11,10 @@
 #include <Arduino.h>
 #include <vector>
 #include <functional>
+#include "MoeSimpleATCMUX.h"
+#include "MoeSimpleATSettings.h"
+#include "MoeSimpleATTCP.h"
+#include "MoeSimpleATTrace.h"
 
 // ----------------------------
 // User configurable items
@@ -58,6 +62,272 @@
   #define COMPILED_DATETIME "1900-01-01 00:00:00"
 #endif
 
+// Scheduler: maximum number of periodic jobs (fixed job table)
+#ifndef AT_SCHED_MAX_JOBS
+  #define AT_SCHED_MAX_JOBS 8
+#endif
+
+// Scheduler: timer wheel resolution in milliseconds
+#ifndef AT_SCHED_TICK_MS
+  #define AT_SCHED_TICK_MS 100
+#endif
+
+// Scheduler: number of timer wheel slots (one revolution = slots * tick)
+#ifndef AT_SCHED_WHEEL_SLOTS
+  #define AT_SCHED_WHEEL_SLOTS 32
+#endif
+
+// Scheduler: maximum length of a scheduled command line
+#ifndef AT_SCHED_CMD_LEN
+  #define AT_SCHED_CMD_LEN 48
+#endif
+
+// URC: number of queued unsolicited result codes (max 32)
+#ifndef AT_URC_QUEUE_LEN
+  #define AT_URC_QUEUE_LEN 8
+#endif
+
+// URC: maximum length of one URC line (without CRLF, max 255)
+#ifndef AT_URC_LINE_LEN
+  #define AT_URC_LINE_LEN 64
+#endif
+
+// URC: maximum number of URCs written per handleATCommands() call
+#ifndef AT_URC_MAX_PER_CALL
+  #define AT_URC_MAX_PER_CALL 4
+#endif
+
+// Default echo of received characters in AT mode (ATE0 / ATE1)
+#ifndef AT_DEFAULT_ECHO
+  #define AT_DEFAULT_ECHO 0
+#endif
+
+// CMUX: largest information field per frame (N1), 31 is the 27.010 default
+#ifndef AT_CMUX_MAX_FRAME
+  #define AT_CMUX_MAX_FRAME 64
+#endif
+
+// CMUX: transmit buffer per virtual channel
+#ifndef AT_CMUX_TX_BUF
+  #define AT_CMUX_TX_BUF 256
+#endif
+
+// CMUX: maximum number of frames sent per handleATCommands() call
+#ifndef AT_CMUX_FRAMES_PER_CALL
+  #define AT_CMUX_FRAMES_PER_CALL 6
+#endif
+
+// Capacity of the command tables (registrations beyond this are ignored)
+#ifndef AT_MAX_AT_COMMANDS
+  #define AT_MAX_AT_COMMANDS 16
+#endif
+
+#ifndef AT_MAX_SHELL_COMMANDS
+  #define AT_MAX_SHELL_COMMANDS 16
+#endif
+
+// Longest custom command name, including the terminator
+#ifndef AT_COMMAND_NAME_LEN
+  #define AT_COMMAND_NAME_LEN 16
+#endif
+
+// Most words of a shell line split for argc / argv handlers, including the command name
+#ifndef AT_SHELL_MAX_ARGS
+  #define AT_SHELL_MAX_ARGS 8
+#endif
+
+// Longest AT / shell input line, including the terminator
+#ifndef AT_LINE_LEN
+  #define AT_LINE_LEN 128
+#endif
+
+// Response buffer: output of one command is written in chunks of this size
+#ifndef AT_TX_LEN
+  #define AT_TX_LEN 128
+#endif
+
+// Settings: number of keys (0 .. AT_SETTINGS_MAX_KEYS - 1, at most 240)
+#ifndef AT_SETTINGS_MAX_KEYS
+  #define AT_SETTINGS_MAX_KEYS 32
+#endif
+
+// Settings: largest value in bytes (at most 255)
+#ifndef AT_SETTINGS_MAX_VALUE
+  #define AT_SETTINGS_MAX_VALUE 32
+#endif
+
+// Settings: ESP32 data partition holding the settings log
+#ifndef AT_SETTINGS_PARTITION
+  #define AT_SETTINGS_PARTITION "msat"
+#endif
+
+// Settings: ESP8266 flash offset and number of sectors of the settings log.
+// Not defined by default: pick sectors that no file system or OTA uses.
+// #define AT_SETTINGS_FLASH_ADDR 0x3F8000
+#ifndef AT_SETTINGS_SECTORS
+  #define AT_SETTINGS_SECTORS 2
+#endif
+
+// Idle: quiet period before light sleep in ms (0 disables, AT+IDLE= changes it)
+#ifndef AT_IDLE_TIMEOUT_MS
+  #define AT_IDLE_TIMEOUT_MS 0
+#endif
+
+// Idle: latency budget, the longest single sleep in ms. Bounds the response
+// time when the platform cannot wake on UART activity.
+#ifndef AT_IDLE_LATENCY_MS
+  #define AT_IDLE_LATENCY_MS 1000
+#endif
+
+// Idle: sleeps shorter than this are not worth entering
+#ifndef AT_IDLE_MIN_SLEEP_MS
+  #define AT_IDLE_MIN_SLEEP_MS 10
+#endif
+
+// Idle: ESP32 UART number of atSerial, used for UART wakeup
+#ifndef AT_IDLE_UART_NUM
+  #define AT_IDLE_UART_NUM 0
+#endif
+
+// UART stats: seconds averaged by the rx / tx bytes-per-second rates
+#ifndef AT_UART_RATE_WINDOW_S
+  #define AT_UART_RATE_WINDOW_S 5
+#endif
+
+// UART stats: gaps between handleATCommands() calls this long count as slow loops
+#ifndef AT_UART_SLOW_LOOP_MS
+  #define AT_UART_SLOW_LOOP_MS 20
+#endif
+
+// UART: RX / TX driver buffer sizes applied when atSerial is (re)opened (0 keeps the core default)
+#ifndef AT_UART_RX_BUFFER
+  #define AT_UART_RX_BUFFER 0
+#endif
+#ifndef AT_UART_TX_BUFFER
+  #define AT_UART_TX_BUFFER 0
+#endif
+
+// UART: RTS / CTS pins for hardware flow control (ESP32 only, -1: not wired)
+#ifndef AT_UART_RTS_PIN
+  #define AT_UART_RTS_PIN -1
+#endif
+#ifndef AT_UART_CTS_PIN
+  #define AT_UART_CTS_PIN -1
+#endif
+
+// TCP: simultaneous network clients
+#ifndef AT_TCP_MAX_CLIENTS
+  #define AT_TCP_MAX_CLIENTS 2
+#endif
+
+// TCP: default port of beginTCPServer()
+#ifndef AT_TCP_PORT
+  #define AT_TCP_PORT 23
+#endif
+
+// TCP: transmit buffer per client (output the socket cannot take yet)
+#ifndef AT_TCP_TX_LEN
+  #define AT_TCP_TX_LEN 256
+#endif
+
+// TCP: bytes read per client per handleATCommands() call
+#ifndef AT_TCP_RX_CHUNK
+  #define AT_TCP_RX_CHUNK 64
+#endif
+
+// Script: bytecode buffer of the running script
+#ifndef AT_SCRIPT_CODE_LEN
+  #define AT_SCRIPT_CODE_LEN 256
+#endif
+
+// Script: variables per script (including the built-in rc)
+#ifndef AT_SCRIPT_VARS
+  #define AT_SCRIPT_VARS 8
+#endif
+
+// Script: maximum variable name length + 1
+#ifndef AT_SCRIPT_VAR_NAME_LEN
+  #define AT_SCRIPT_VAR_NAME_LEN 8
+#endif
+
+// Script: evaluation stack entries (bounds expression complexity)
+#ifndef AT_SCRIPT_STACK
+  #define AT_SCRIPT_STACK 8
+#endif
+
+// Script: maximum nesting of if / while blocks
+#ifndef AT_SCRIPT_NEST
+  #define AT_SCRIPT_NEST 8
+#endif
+
+// Script: instructions executed per handleATCommands() call before yielding
+#ifndef AT_SCRIPT_SLICE_OPS
+  #define AT_SCRIPT_SLICE_OPS 64
+#endif
+
+// Script: scripts that can be registered with registerScript()
+#ifndef AT_SCRIPT_MAX_REGISTERED
+  #define AT_SCRIPT_MAX_REGISTERED 4
+#endif
+
+// Input: most bytes read from atSerial per handleATCommands() call (0: no limit)
+#ifndef AT_INPUT_MAX_BYTES
+  #define AT_INPUT_MAX_BYTES 256
+#endif
+
+// Input: most command lines executed per handleATCommands() call (0: no limit)
+#ifndef AT_INPUT_MAX_LINES
+  #define AT_INPUT_MAX_LINES 4
+#endif
+
+// Input: commands that can have their own rate limit (setCommandRateLimit())
+#ifndef AT_RATE_LIMIT_COMMANDS
+  #define AT_RATE_LIMIT_COMMANDS 4
+#endif
+
+// Cache: query commands whose response can be cached (setATQueryCache())
+#ifndef AT_CACHE_ENTRIES
+  #define AT_CACHE_ENTRIES 4
+#endif
+
+// Cache: buffer shared by the cached responses, in bytes (at most 65535)
+#ifndef AT_CACHE_BUF_LEN
+  #define AT_CACHE_BUF_LEN 256
+#endif
+
+// Loop monitor: calls with the longest AT / shell processing time kept by AT+LOOPSTAT?
+#ifndef AT_LOOP_WORST
+  #define AT_LOOP_WORST 4
+#endif
+
+// Loop monitor: characters of the command line kept for each of them, including the terminator
+#ifndef AT_LOOP_WORST_LINE_LEN
+  #define AT_LOOP_WORST_LINE_LEN 24
+#endif
+
+// Loop monitor: interval or processing time in ms that posts a +LOOPWARN URC (0: no warning)
+#ifndef AT_LOOP_WARN_MS
+  #define AT_LOOP_WARN_MS 0
+#endif
+
+// Loop monitor: histogram buckets, < 1, 2, 5, 10, 20, 50, 100, 200, 500 ms and longer
+#define AT_LOOP_HIST_BUCKETS 10
+
+// Trace: size of the RX/TX/dispatch trace ring in bytes (0 compiles the recorder out)
+#ifndef AT_TRACE_BUF_LEN
+  #define AT_TRACE_BUF_LEN 0
+#endif
+
+// Trace: RX / TX bytes collected into one record
+#ifndef AT_TRACE_BURST_LEN
+  #define AT_TRACE_BURST_LEN 32
+#endif
+
+// CMUX: DLCI of each virtual channel
+#define AT_CMUX_DLCI_AT    1
+#define AT_CMUX_DLCI_LOG   2
+#define AT_CMUX_DLCI_SHELL 3
+
 // ----------------------------
 // Forward declarations
 // ----------------------------
@@ -81,6 +351,42 @@ using ATCommandHandler = std::function<void(const String& args)>;
  */
 using ShellCommandHandler = std::function<void(const String& args)>;
 
+/**
+ * @brief Allocation-free AT command handler.
+ *
+ * @param args    Upper-cased text after the command name (e.g. "=115200" for AT+UART=115200)
+ * @param context Pointer given at registration
+ */
+typedef void (*ATCommandFunction)(const char* args, void* context);
+
+/**
+ * @brief Allocation-free shell command handler.
+ *
+ * @param args    Text after the command name, trimmed (e.g. "on" for "led on")
+ * @param context Pointer given at registration
+ */
+typedef void (*ShellCommandFunction)(const char* args, void* context);
+
+/**
+ * @brief Shell command handler that gets its line split into words.
+ *
+ * The words point into the interpreter's line buffer and are only valid
+ * during the call. Quotes and backslashes have already been removed.
+ *
+ * @param argc    Number of words, at least 1
+ * @param argv    Words; argv[0] is the command name (e.g. {"led", "on"} for "led on")
+ * @param context Pointer given at registration
+ */
+typedef void (*ShellArgvFunction)(int argc, char* argv[], void* context);
+
+/**
+ * @brief Errors returned by splitShellArgs().
+ */
+enum ShellArgsError {
+    SHELL_ARGS_UNTERMINATED = -1,   // Missing closing quote, or a backslash at the end
+    SHELL_ARGS_TOO_MANY = -2        // More words than argv can hold
+};
+
 /**
  * @brief Structure representing a custom AT command.
  */
@@ -99,6 +405,253 @@ struct CustomShellCommand {
     String help;              // Help text description
 };
 
+/**
+ * @brief Modes, echo and output of one interpreter instance.
+ *
+ * While an instance runs, its values are in the globals atOutput,
+ * inShellMode, inLogMode, atEcho, atVerbose, atQuiet and shellEcho, so
+ * built-ins and handlers act on it; the other instances keep theirs here.
+ */
+struct ATSession {
+    Print* output;            // nullptr: atSerial
+    bool shellMode;
+    bool logMode;
+    bool echo;
+    bool verbose;
+    bool quiet;
+    bool shellEcho;
+};
+
+/**
+ * @brief Final result of an AT command (values are the V.250 numeric codes).
+ */
+enum ATResultCode : uint8_t {
+    AT_RESULT_OK = 0,
+    AT_RESULT_ERROR = 4,
+    AT_RESULT_BUSY = 7     // Refused by a rate limit (see setATRateLimit())
+};
+
+/**
+ * @brief Interpreter a scheduled command line is executed by.
+ */
+enum ScheduledJobKind : uint8_t {
+    JOB_AT = 0,    // Line is passed to processATCommand() (e.g. "AT+SYSRAM?")
+    JOB_SHELL = 1  // Line is passed to processShellCommand() (e.g. "free -m")
+};
+
+/**
+ * @brief Snapshot of a scheduled job, as reported by listScheduledCommands().
+ */
+struct ScheduledJobInfo {
+    int id;                   // Stable job ID (used to cancel the job)
+    ScheduledJobKind kind;    // AT or shell command
+    unsigned long periodMs;   // Repeat interval in milliseconds
+    const char* command;      // Command line executed on every period
+};
+
+/**
+ * @brief Platform sleep primitives used by the idle policy.
+ * 
+ * A default implementation exists for ESP32 and ESP8266. Boards without it,
+ * or a host build with a simulated clock, can provide their own.
+ */
+class PowerHooks {
+public:
+    virtual ~PowerHooks() {}
+
+    // Clock used for the idle timeout and the counters, in milliseconds
+    virtual unsigned long now() { return millis(); }
+
+    /**
+     * @brief Sleep for at most maxMs, waking early on UART activity.
+     * 
+     * @return true if woken by the UART (a byte is on its way)
+     */
+    virtual bool lightSleep(unsigned long maxMs) = 0;
+};
+
+/**
+ * @brief Idle power management counters, as reported by getPowerStats() and AT+IDLE?.
+ */
+struct PowerStats {
+    uint32_t sleeps;           // Light sleeps entered
+    uint32_t asleepMs;         // Total time spent asleep
+    uint32_t uartWakes;        // Sleeps ended by UART activity
+    uint32_t lastLatencyMs;    // UART wake to first received byte, last wake
+    uint32_t maxLatencyMs;     // Worst first-byte latency seen
+};
+
+/**
+ * @brief UART transport counters, as reported by getUARTStats() and AT+UARTSTAT?.
+ */
+struct UARTStats {
+    uint32_t rxBytes;          // Bytes read from atSerial
+    uint32_t txBytes;          // Bytes written to atSerial
+    uint32_t rxLines;          // LF characters received
+    uint32_t txLines;          // LF characters sent
+    uint32_t rxBps;            // Receive rate over the last AT_UART_RATE_WINDOW_S seconds
+    uint32_t txBps;            // Transmit rate over the same window
+    uint32_t maxBacklog;       // Most bytes found waiting in the RX buffer at once
+    uint32_t overruns;         // RX FIFO / buffer overflows reported by the driver
+    uint32_t framingErrors;    // Framing / parity errors reported by the driver
+    uint32_t discarded;        // Received bytes dropped because a line was too long
+    uint32_t droppedLines;     // AT lines rejected as too long
+    uint32_t maxLoopGapMs;     // Longest time spent between two handleATCommands() calls
+    uint32_t slowLoops;        // Gaps of AT_UART_SLOW_LOOP_MS or more
+};
+
+/**
+ * @brief One of the handleATCommands() calls that took longest.
+ */
+struct LoopOffender {
+    uint32_t busyUs;                        // Time spent in handleATCommands()
+    char command[AT_LOOP_WORST_LINE_LEN];   // Longest command run in that call ("" if none)
+};
+
+/**
+ * @brief Loop monitor counters, as reported by getLoopStats() and AT+LOOPSTAT?.
+ * 
+ * The interval is the time from one handleATCommands() call to the next,
+ * i.e. the period of loop(); busy is the time spent inside the call.
+ * Idle light sleep (setIdlePolicy()) counts towards neither.
+ */
+struct LoopStats {
+    uint32_t calls;
+    uint32_t avgIntervalUs;
+    uint32_t maxIntervalUs;
+    uint32_t avgBusyUs;
+    uint32_t maxBusyUs;
+    uint32_t warnings;                          // +LOOPWARN URCs posted
+    uint32_t intervalHist[AT_LOOP_HIST_BUCKETS];
+    uint32_t busyHist[AT_LOOP_HIST_BUCKETS];
+    LoopOffender worst[AT_LOOP_WORST];          // Longest first; unused entries have busyUs 0
+};
+
+/**
+ * @brief TCP transport counters, as reported by getTCPStats() and AT+TCPSRV?.
+ */
+struct TCPStats {
+    uint32_t clients;          // Connected now
+    uint32_t accepted;         // Connections served
+    uint32_t rejected;         // Connections refused because every session was in use
+    uint32_t rxBytes;          // Bytes received (including Telnet commands)
+    uint32_t txBytes;          // Bytes sent
+    uint32_t txDropped;        // Output bytes lost because a client's buffer was full
+};
+
+/**
+ * @brief Script interpreter counters, as reported by getScriptStats().
+ */
+struct ScriptStats {
+    uint32_t runs;             // Scripts started
+    uint32_t ops;              // Bytecode instructions executed
+    uint32_t commands;         // Shell / AT commands called by scripts
+    uint32_t errors;           // Compile and runtime errors
+};
+
+/**
+ * @brief Delivery priority of an unsolicited result code.
+ */
+enum URCPriority : uint8_t {
+    URC_LOW = 0,
+    URC_NORMAL = 1,
+    URC_HIGH = 2
+};
+
+/**
+ * @brief What postURC() does when the URC queue is full.
+ */
+enum URCOverflowPolicy : uint8_t {
+    URC_DROP_OLDEST = 0,  // Evict the oldest URC of the lowest priority <= the new one
+    URC_DROP_NEWEST = 1   // Reject the new URC
+};
+
+/**
+ * @brief URC queue counters, as reported by getURCStats() and AT+URC?.
+ */
+struct URCStats {
+    uint32_t posted;     // postURC() calls
+    uint32_t delivered;  // Lines written to atSerial
+    uint32_t coalesced;  // URCs merged into a pending URC of the same type
+    uint32_t dropped;    // URCs lost to the overflow policy
+    uint8_t pending;     // URCs currently queued
+    uint8_t highWater;   // Maximum number of URCs ever queued at once
+};
+
+/**
+ * @brief CMUX channel counters, as reported by getCMUXStats() and AT+CMUX?.
+ */
+struct CMUXStats {
+    uint32_t dropped[3];  // Bytes lost on DLCI 1, 2, 3 while the buffer was full and flow stopped
+};
+
+/**
+ * @brief Serial line settings of atSerial, in the AT+UART= encoding of ESP-AT.
+ */
+struct UARTConfig {
+    uint32_t baud;           // Bits per second, 0: autobaud (lock onto the host's first "AT")
+    uint8_t dataBits;        // 5 .. 8
+    uint8_t stopBits;        // 1: 1 bit, 2: 1.5 bits (not supported), 3: 2 bits
+    uint8_t parity;          // 0: none, 1: odd, 2: even
+    uint8_t flowControl;     // 0: none, 1: RTS, 2: CTS, 3: RTS and CTS
+};
+
+/**
+ * @brief Input limit counters, as reported by getInputLimitStats() and AT+LIMIT?.
+ */
+struct InputLimitStats {
+    uint32_t byteBudgetHits;  // Calls that left input unread because of the byte budget
+    uint32_t lineBudgetHits;  // Calls that left input unread because of the line budget
+    uint32_t atBusy;          // AT lines refused by the AT rate limit
+    uint32_t shellBusy;       // Shell lines refused by the shell rate limit
+    uint32_t commandBusy;     // Lines refused by a per-command rate limit
+};
+
+/**
+ * @brief Query cache counters, as reported by getATCacheStats() and AT+CACHE?.
+ */
+struct ATCacheStats {
+    uint32_t hits;            // Queries answered from the cache
+    uint32_t misses;          // Cacheable queries that ran their handler
+    uint32_t stores;          // Responses stored
+    uint32_t invalidations;   // Stored responses dropped before they expired
+    uint32_t oversize;        // Responses that did not fit into the cache buffer
+};
+
+/**
+ * @brief Keys of the settings store used by the library itself.
+ * 
+ * Applications should use keys from SETTING_USER upwards.
+ */
+enum SettingKey : uint8_t {
+    SETTING_UART_BAUD = 0,   // long, set by AT+UART=
+    SETTING_UART_FORMAT = 1, // data bits, stop bits, parity, flow control (4 bytes), set by AT+UART=
+    SETTING_SCRIPTS = 2,     // 2 .. SETTING_USER - 1: scripts saved with the shell "script" command
+    SETTING_USER = 8         // First key free for application use
+};
+
+/**
+ * @brief Settings store counters, as reported by getSettingsStats().
+ */
+struct SettingsStats {
+    bool mounted;            // A flash backend is attached and formatted
+    uint8_t liveKeys;        // Keys that currently have a value
+    uint8_t activeSector;    // Sector records are appended to
+    uint32_t freeBytes;      // Space left in the active sector
+    uint32_t writes;         // Records appended since boot (incl. relocations)
+    uint32_t erases;         // Sector erases since boot
+};
+
+/**
+ * @brief Scale of byte counts printed with formatBytes() / printBytes().
+ */
+enum ByteUnit : uint32_t {
+    BYTES_HUMAN = 0,                 // Picks B, K, M or G per value (e.g. "512B", "1.5K", "320K")
+    BYTES_B = 1,                     // Plain bytes
+    BYTES_K = 1024,                  // Whole kilobytes, no suffix
+    BYTES_M = 1024UL * 1024          // Whole megabytes, no suffix
+};
+
 // ----------------------------
 // External Global Variables
 // ----------------------------
@@ -106,7 +659,14 @@ struct CustomShellCommand {
 // Pointer to the serial interface used for AT commands
 extern HardwareSerial* atSerial;
 
-// Input buffer for accumulating serial data
+// Output of the active interpreter. Normally atSerial; while CMUX is active
+// it is the virtual channel the current command arrived on. Command
+// handlers should print to atOutput rather than atSerial.
+// This and the mode / echo flags below belong to the running interpreter
+// instance, defaultAT when none runs (see ATSession).
+extern Print* atOutput;
+
+// No longer used: input is buffered by defaultAT. Kept for source compatibility.
 extern String inputBuffer;
 
 // Flag indicating whether the system is in log output mode
@@ -115,6 +675,18 @@ extern bool inLogMode;
 // Flag indicating whether the system is in shell mode
 extern bool inShellMode;
 
+// Echo received characters in AT mode (ATE0 / ATE1)
+extern bool atEcho;
+
+// Verbose (text) result codes, numeric when false (ATV1 / ATV0)
+extern bool atVerbose;
+
+// Suppress result codes entirely (ATQ1 / ATQ0)
+extern bool atQuiet;
+
+// Echo typed characters in shell mode (stty echo / stty -echo)
+extern bool shellEcho;
+
 // Vector of user-registered custom AT commands
 extern std::vector<CustomATCommand> customATCommands;
 
@@ -139,6 +711,10 @@ void initATCommands();
  * Example: registerATCommand("MYCMD", myHandler, "My custom command");
  *          -> Can be triggered via "AT+MYCMD"
  * 
+ * Allocates: the registration copies the strings, and every call builds a
+ * String of the arguments. Not covered by the heap-free guarantee of the
+ * C-string registrations below.
+ * 
  * @param cmd     Command name (without "AT+")
  * @param handler Function to call when command is received
  * @param help    Description shown in help menu
@@ -151,12 +727,61 @@ void registerATCommand(const String& cmd, const ATCommandHandler& handler, const
  * Example: registerShellCommand("LED", ledHandler, "Control LED");
  *          Then user can type 'LED ON' in shell mode.
  * 
+ * Allocates like the String registerATCommand().
+ * 
  * @param cmd     Command name (case-insensitive)
  * @param handler Function to call when command is received
  * @param help    Description shown in help menu
  */
 void registerShellCommand(const String& cmd, const ShellCommandHandler& handler, const String& help);
 
+/**
+ * @brief Register a custom AT command without heap allocation.
+ * 
+ * Same as above, but the handler is a plain function receiving a C string
+ * and the help text is not copied (pass a literal or a static buffer).
+ * 
+ * @param cmd     Command name (without "AT+", shorter than AT_COMMAND_NAME_LEN)
+ * @param handler Function to call when command is received
+ * @param help    Description shown in help menu
+ * @param context Pointer passed back to the handler
+ * @return false if the command table is full or the name is too long
+ */
+bool registerATCommand(const char* cmd, ATCommandFunction handler, const char* help, void* context = nullptr);
+
+/**
+ * @brief Register a custom shell command without heap allocation.
+ * 
+ * @param cmd     Command name (shorter than AT_COMMAND_NAME_LEN)
+ * @param handler Function to call when command is received
+ * @param help    Description shown in help menu (not copied)
+ * @param context Pointer passed back to the handler
+ * @return false if the command table is full or the name is too long
+ */
+bool registerShellCommand(const char* cmd, ShellCommandFunction handler, const char* help, void* context = nullptr);
+
+/**
+ * @brief Register a shell command that gets its line split into argc / argv.
+ * 
+ * Words are separated by spaces; 'single quotes' keep text as is, "double
+ * quotes" allow \" and \\, and a backslash outside quotes escapes the next
+ * character. Lines that do not split (see ShellArgsError) are answered with
+ * an error message instead of calling the handler.
+ * 
+ * Example:
+ *   void ledHandler(int argc, char* argv[], void* context) {   // "led blink 200"
+ *       if (argc == 3 && strcmp(argv[1], "blink") == 0) blinkLed(atoi(argv[2]));
+ *   }
+ *   registerShellCommand("led", ledHandler, "Control LED");
+ * 
+ * @param cmd     Command name (shorter than AT_COMMAND_NAME_LEN)
+ * @param handler Function to call when command is received
+ * @param help    Description shown in help menu (not copied)
+ * @param context Pointer passed back to the handler
+ * @return false if the command table is full or the name is too long
+ */
+bool registerShellCommand(const char* cmd, ShellArgvFunction handler, const char* help, void* context = nullptr);
+
 /**
  * @brief Get help string for all registered commands.
  * 
@@ -193,43 +818,632 @@ void log(const String& msg);
  */
 String trim(const String& str);
 
+/**
+ * @brief Split a shell line into words in place (see registerShellCommand()).
+ * 
+ * Quotes and escapes are removed and each word is terminated inside line,
+ * so nothing is copied or allocated.
+ * 
+ * @param line    Line to split; it is modified
+ * @param argv    Receives pointers to the words
+ * @param maxArgs Capacity of argv
+ * @return Number of words, or a negative ShellArgsError
+ */
+int splitShellArgs(char* line, char* argv[], int maxArgs);
+
 // ----------------------------
-// AT Command Processing Functions
+// Output Formatting Functions
 // ----------------------------
 
 /**
- * @brief Process a complete AT command line.
- * 
- * This function parses and executes the given command.
- * It handles both built-in and user-registered commands.
+ * @brief Write a decimal number into a buffer.
  * 
- * @param fullCmd The full command line (without newline)
+ * @param buf  Destination, always terminated
+ * @param size Size of buf (digits that do not fit are cut off)
+ * @return Length of the text written
  */
-void processATCommand(const String& fullCmd);
+size_t formatNumber(char* buf, size_t size, long value);
 
 /**
- * @brief Main loop handler for AT command processing.
+ * @brief Write a byte count scaled to a unit into a buffer.
  * 
- * Call this function repeatedly in the main loop to handle incoming serial data.
- * It reads characters from atSerial and buffers them until a newline is received.
+ * BYTES_K / BYTES_M round down like the Linux free command, BYTES_HUMAN
+ * keeps one decimal below 10 and appends the unit letter.
+ * 
+ * @return Length of the text written
  */
-void handleATCommands();
+size_t formatBytes(char* buf, size_t size, unsigned long bytes, ByteUnit unit);
 
 /**
- * @brief Register a callback function to be called when AT+RESTORE is received.
+ * @brief Print text padded with spaces to a column width.
  * 
- * This allows the user to define custom behavior for factory reset,
- * such as clearing EEPROM, resetting settings, etc.
+ * Nothing is allocated, so the helpers below suit tables that are redrawn
+ * periodically (e.g. "free -s"). Text wider than the column is printed whole.
  * 
- * @param callback Function to call when AT+RESTORE is executed
+ * @param width Column width: positive aligns right, negative aligns left
  */
-void onRestore(std::function<void()> callback);
+void printPadded(Print& out, const char* text, int width);
 
 /**
- * @brief Register a callback function to be called when shutdown is received.
- * 
- * @param callback Function to call when shutdown is executed
+ * @brief Print a number right or left aligned (see printPadded()).
  */
-void onShutdown(std::function<void()> callback);
+void printNumber(Print& out, long value, int width);
+
+/**
+ * @brief Print a scaled byte count right or left aligned (see formatBytes()).
+ */
+void printBytes(Print& out, unsigned long bytes, ByteUnit unit, int width);
+
+// ----------------------------
+// AT Command Processing Functions
+// ----------------------------
+
+/**
+ * @brief Process a complete AT command line.
+ * 
+ * This function parses and executes the given command.
+ * It handles both built-in and user-registered commands.
+ * 
+ * @param fullCmd The full command line (without newline)
+ */
+void processATCommand(const String& fullCmd);
+
+/**
+ * @brief Send the final result code of an AT command.
+ * 
+ * Built-in and custom AT handlers should finish every response with this
+ * instead of printing "OK" / "ERROR" themselves, so that the ATV (numeric
+ * result codes) and ATQ (quiet) settings apply to all commands.
+ * 
+ * ATV1: "OK\r\n" / "ERROR\r\n" / "BUSY\r\n", preceded by a blank line if sendATInfo() was used
+ * ATV0: "0\r" / "4\r" / "7\r"
+ * ATQ1: nothing
+ * 
+ * @param code AT_RESULT_OK, AT_RESULT_ERROR or AT_RESULT_BUSY
+ */
+void sendATResult(ATResultCode code);
+
+/**
+ * @brief Send one information line of an AT response (e.g. "+UART:115200").
+ * 
+ * @param line Information text without CRLF
+ */
+void sendATInfo(const String& line);
+void sendATInfo(const char* line);
+
+/**
+ * @brief Start an information line that is printed piecewise (no String needed).
+ * 
+ * Example: beginATInfo().print("+UART:"); atOutput->println(baud);
+ * 
+ * @return The output to print the line to
+ */
+Print& beginATInfo();
+
+/**
+ * @brief Process a complete shell (msh) command line.
+ * 
+ * Runs a built-in or user-registered shell command, exactly as if it had
+ * been typed at the "msh> " prompt.
+ * 
+ * @param fullCmd The full command line (without newline)
+ */
+void processShellCommand(const String& fullCmd);
+
+/**
+ * @brief Main loop handler for AT command processing.
+ * 
+ * Call this function repeatedly in the main loop to handle incoming serial data.
+ * It reads characters from atSerial and buffers them until a newline is received.
+ */
+void handleATCommands();
+
+/**
+ * @brief Register a callback function to be called when AT+RESTORE is received.
+ * 
+ * The settings store has already been cleared when the callback runs; use
+ * it for state kept elsewhere.
+ * 
+ * @param callback Function to call when AT+RESTORE is executed
+ */
+void onRestore(std::function<void()> callback);
+
+/**
+ * @brief Register a callback function to be called when shutdown is received.
+ * 
+ * @param callback Function to call when shutdown is executed
+ */
+void onShutdown(std::function<void()> callback);
+
+// ----------------------------
+// Settings Functions
+// ----------------------------
+
+/**
+ * @brief Mount the persistent settings store.
+ * 
+ * Settings are appended as records to a ring of flash sectors; the newest
+ * record of a key wins and a RAM index makes reads O(1). When the active
+ * sector is full, the next one is started and the live records of the
+ * oldest sector are moved over before it is erased, so every sector is
+ * erased once per trip around the ring.
+ * 
+ * initATCommands() calls this with the platform default (ESP32: data
+ * partition AT_SETTINGS_PARTITION; ESP8266: AT_SETTINGS_FLASH_ADDR if
+ * defined). Call it earlier with your own backend to use other storage.
+ * 
+ * @param flash Flash backend, or nullptr for the platform default
+ * @return true if the store is usable
+ */
+bool beginSettings(SettingsFlash* flash = nullptr);
+
+/**
+ * @brief Store a value. Writing the value a key already has costs no flash write.
+ * 
+ * @param key  0 .. AT_SETTINGS_MAX_KEYS - 1 (application keys from SETTING_USER)
+ * @param data Value bytes
+ * @param len  1 .. AT_SETTINGS_MAX_VALUE
+ * @return false if the store is not mounted, the arguments are invalid or flash failed
+ */
+bool settingsWrite(uint8_t key, const void* data, size_t len);
+
+/**
+ * @brief Read a value.
+ * 
+ * @param key    Setting key
+ * @param data   Output buffer
+ * @param maxLen Size of the output buffer
+ * @return Length of the value (copied up to maxLen), or -1 if the key has no value
+ */
+int settingsRead(uint8_t key, void* data, size_t maxLen);
+
+/**
+ * @brief Delete the value of a key.
+ */
+bool settingsRemove(uint8_t key);
+
+/**
+ * @brief Delete all values (used by AT+RESTORE).
+ * 
+ * Appends a single "clear" record instead of erasing sectors; the old
+ * records are reclaimed as the ring advances.
+ */
+bool settingsClear();
+
+/**
+ * @brief Get the settings store counters.
+ */
+SettingsStats getSettingsStats();
+
+// ----------------------------
+// Scheduler Functions
+// ----------------------------
+
+/**
+ * @brief Run a shell or AT command periodically.
+ * 
+ * Jobs are kept in a fixed table of AT_SCHED_MAX_JOBS entries and fired from
+ * handleATCommands() by a timer wheel, so scheduling, cancelling and firing
+ * are O(1) and never block the main loop. Periods are rounded up to
+ * AT_SCHED_TICK_MS.
+ * 
+ * Example: scheduleCommand(JOB_SHELL, "free -m", 5000);
+ * 
+ * @param kind     JOB_AT or JOB_SHELL
+ * @param cmdLine  Command line to execute (at most AT_SCHED_CMD_LEN - 1 chars)
+ * @param periodMs Repeat interval in milliseconds
+ * @return Job ID (> 0), or -1 if the table is full or the command is too long
+ */
+int scheduleCommand(ScheduledJobKind kind, const String& cmdLine, unsigned long periodMs);
+int scheduleCommand(ScheduledJobKind kind, const char* cmdLine, unsigned long periodMs);
+
+/**
+ * @brief Cancel a scheduled job.
+ * 
+ * @param id Job ID returned by scheduleCommand()
+ * @return true if the job existed and was cancelled
+ */
+bool cancelScheduledCommand(int id);
+
+/**
+ * @brief Enumerate all scheduled jobs in job table order.
+ * 
+ * @param callback Function called once per active job
+ * @return Number of active jobs
+ */
+size_t listScheduledCommands(const std::function<void(const ScheduledJobInfo& job)>& callback);
+
+// ----------------------------
+// Idle Power Management Functions
+// ----------------------------
+
+/**
+ * @brief Set the idle policy.
+ * 
+ * When nothing has been received for idleMs, no URC is pending and CMUX is
+ * not active, handleATCommands() puts the chip into light sleep until UART
+ * activity, the next scheduled job, or latencyBudgetMs at most. Bytes that
+ * arrive while the chip wakes up may be lost on some platforms: hosts
+ * should send a wake character (e.g. "\r\n") first. Same as AT+IDLE=.
+ * 
+ * @param idleMs          Quiet period before sleeping, 0 to disable
+ * @param latencyBudgetMs Longest single sleep
+ */
+void setIdlePolicy(unsigned long idleMs, unsigned long latencyBudgetMs = AT_IDLE_LATENCY_MS);
+
+/**
+ * @brief Replace the platform sleep primitives (nullptr restores the default).
+ */
+void setPowerHooks(PowerHooks* hooks);
+
+/**
+ * @brief Get the idle power management counters.
+ */
+PowerStats getPowerStats();
+
+// ----------------------------
+// Loop Monitor Functions
+// ----------------------------
+
+/**
+ * @brief Get the loop monitor counters (same as AT+LOOPSTAT?).
+ */
+LoopStats getLoopStats();
+
+/**
+ * @brief Clear the loop monitor counters (same as AT+LOOPSTAT=0).
+ */
+void resetLoopStats();
+
+/**
+ * @brief Post a +LOOPWARN URC when a loop interval or a handleATCommands() call
+ *        takes thresholdMs or longer (same as AT+LOOPSTAT=WARN,<ms>).
+ * 
+ * The URC reads +LOOPWARN:<interval ms>,<busy ms>,"<command>", where the
+ * command is the longest one run in that call, or empty if the time was
+ * spent outside handleATCommands().
+ * 
+ * @param thresholdMs Threshold in ms, 0 turns the warning off
+ */
+void setLoopWarning(uint32_t thresholdMs);
+
+// ----------------------------
+// UART Statistics Functions
+// ----------------------------
+
+/**
+ * @brief Get the UART transport counters (same as AT+UARTSTAT?).
+ * 
+ * Overruns and framing errors are only available on ESP32 (Arduino core
+ * 2.x or later) and ESP8266; they stay 0 elsewhere.
+ */
+UARTStats getUARTStats();
+
+/**
+ * @brief Clear the UART transport counters (same as AT+UARTSTAT=0).
+ */
+void resetUARTStats();
+
+/**
+ * @brief Change the serial line settings of atSerial (same as AT+UART=).
+ * 
+ * The change is applied at the end of the current or next
+ * handleATCommands() call, after pending output has been sent and input
+ * received at the old settings has been read, so an AT handler can still
+ * answer at the old rate. A change of the baud rate alone keeps the port
+ * open on ESP32 / ESP8266. With baud 0, the rate is hunted through common
+ * values until the host's "AT" is received intact; the host should repeat
+ * "AT" until it gets a response.
+ * 
+ * @param config Line settings (see UARTConfig)
+ * @param save   Also store them, initATCommands() applies them on boot
+ * @return false if the settings are not supported by this board (e.g. flow
+ *         control without AT_UART_RTS_PIN / AT_UART_CTS_PIN), CMUX is active,
+ *         or save is set and they could not be stored (e.g. no settings store)
+ */
+bool setUARTConfig(const UARTConfig& config, bool save = false);
+
+/**
+ * @brief Get the serial line settings in use (baud is the rate hunted or locked in autobaud mode).
+ */
+UARTConfig getUARTConfig();
+
+/**
+ * @brief Whether autobaud is still waiting for the host's first "AT".
+ */
+bool isUARTAutobaudActive();
+
+// ----------------------------
+// TCP Transport Functions
+// ----------------------------
+
+/**
+ * @brief Serve the AT and shell interpreters to network clients.
+ * 
+ * Up to AT_TCP_MAX_CLIENTS clients are served from handleATCommands(), each
+ * with its own line buffers, mode (AT / shell / log) and ATE/ATV/ATQ/stty
+ * settings. Sockets are never waited on; output a client cannot take yet is
+ * kept in a buffer of AT_TCP_TX_LEN bytes and dropped beyond that. On ESP32
+ * and ESP8266, call after WiFi is up. The idle policy (setIdlePolicy()) does
+ * not sleep while the server runs.
+ * 
+ * @param port    TCP port
+ * @param telnet  Strip Telnet commands from the input and refuse all
+ *                options; false for a raw byte stream
+ * @param backend Socket backend (nullptr: the one used last, else WiFi on
+ *                ESP32 / ESP8266; required elsewhere, e.g. PosixTCPBackend)
+ * @return false if there is no backend or the port cannot be opened
+ */
+bool beginTCPServer(uint16_t port = AT_TCP_PORT, bool telnet = true, TCPBackend* backend = nullptr);
+
+/**
+ * @brief Disconnect every client and stop listening.
+ */
+void stopTCPServer();
+
+/**
+ * @brief Get the TCP transport counters.
+ */
+TCPStats getTCPStats();
+
+// ----------------------------
+// Input Limit Functions
+// ----------------------------
+
+/**
+ * @brief Bound the input handled by one handleATCommands() call.
+ * 
+ * Input beyond the budget stays in the UART buffer for the next call, so
+ * the time handleATCommands() takes stays bounded however fast the host
+ * sends. Applies to AT, shell and log mode and to the CMUX decoder; TCP
+ * clients are read in chunks of AT_TCP_RX_CHUNK instead. Same as
+ * AT+LIMIT=BUDGET,<bytes>,<lines>.
+ * 
+ * @param maxBytes Bytes read per call (0: no limit, default AT_INPUT_MAX_BYTES)
+ * @param maxLines Command lines executed per call (0: no limit, default AT_INPUT_MAX_LINES)
+ */
+void setInputBudget(size_t maxBytes, size_t maxLines);
+
+/**
+ * @brief Rate limit the AT command lines received from the host (same as AT+LIMIT=AT,...).
+ * 
+ * A token bucket: burst lines may arrive at once, after that perSecond
+ * lines per second. Refused lines are answered with BUSY (numeric 7) and
+ * not executed. Scheduled jobs and scripts are not limited.
+ * 
+ * @param perSecond Sustained rate, 0 removes the limit
+ * @param burst     Lines accepted at once (at least 1)
+ */
+void setATRateLimit(uint16_t perSecond, uint16_t burst);
+
+/**
+ * @brief Rate limit shell command lines; refused lines print "msh: busy" (same as AT+LIMIT=SHELL,...).
+ */
+void setShellRateLimit(uint16_t perSecond, uint16_t burst);
+
+/**
+ * @brief Rate limit one AT or shell command (same as AT+LIMIT="<command>",...).
+ * 
+ * Example: setCommandRateLimit("AT+SYSRAM", 1, 2);  // at most 1 per second, 2 at once
+ * 
+ * @param command   AT command name up to "=" / "?" (e.g. "AT+SYSRAM") or shell
+ *                  command name (e.g. "free"), compared case-insensitively
+ * @param perSecond Sustained rate, 0 removes the limit
+ * @param burst     Lines accepted at once (at least 1)
+ * @return false if AT_RATE_LIMIT_COMMANDS limits are set already or the name
+ *         is longer than "AT+" and AT_COMMAND_NAME_LEN - 1 characters
+ */
+bool setCommandRateLimit(const char* command, uint16_t perSecond, uint16_t burst);
+
+/**
+ * @brief Get how often the input budget and the rate limits were hit.
+ */
+InputLimitStats getInputLimitStats();
+
+/**
+ * @brief Clear the input limit counters (same as AT+LIMIT=0).
+ */
+void resetInputLimitStats();
+
+// ----------------------------
+// Query Cache Functions
+// ----------------------------
+
+/**
+ * @brief Answer a query from its last response while that is younger than ttlMs.
+ * 
+ * The first query after the response expired runs the handler as usual and
+ * its output is stored; later ones replay it without calling the handler.
+ * Only responses ending in OK are stored. A command of the same name that
+ * is not a query (e.g. AT+TEMP=5 for AT+TEMP?) drops the stored response,
+ * as does a command named related. Same as AT+CACHE="<query>",<ttl>.
+ * 
+ * Example: setATQueryCache("AT+SYSRAM?", 1000);
+ * 
+ * @param query   Complete query line, e.g. "AT+TEMP?" (case-insensitive)
+ * @param ttlMs   How long a response stays valid, 0 stops caching the query
+ * @param related Another command name whose set commands drop the response
+ *                (e.g. "AT+UNIT"), or nullptr. Not copied.
+ * @return false if AT_CACHE_ENTRIES queries are cached already or the query
+ *         is longer than "AT+", AT_COMMAND_NAME_LEN - 1 characters and "?"
+ */
+bool setATQueryCache(const char* query, uint32_t ttlMs, const char* related = nullptr);
+
+/**
+ * @brief Drop stored responses, e.g. after the value behind a query changed.
+ * 
+ * @param command Query or command name (e.g. "AT+TEMP?" or "AT+TEMP"), nullptr for all
+ */
+void invalidateATCache(const char* command = nullptr);
+
+/**
+ * @brief Get the query cache counters.
+ */
+ATCacheStats getATCacheStats();
+
+/**
+ * @brief Clear the query cache counters.
+ */
+void resetATCacheStats();
+
+// ----------------------------
+// Script Functions
+// ----------------------------
+
+/**
+ * @brief Make a script available to "run <name>" (see README for the language).
+ * 
+ * The source is not copied and must stay valid (e.g. a string literal). A
+ * script saved with the shell "script" command under the same name takes
+ * precedence. A script named "autoexec" is started by the first
+ * handleATCommands() call.
+ * 
+ * @param name   Script name (at most AT_COMMAND_NAME_LEN - 1 chars)
+ * @param source Statements separated by line breaks or ';'
+ * @return false if the table is full or the name is too long
+ */
+bool registerScript(const char* name, const char* source);
+
+/**
+ * @brief Compile and start a saved or registered script (same as "run <name>").
+ * 
+ * The script runs in the background from handleATCommands(), one slice of
+ * at most AT_SCRIPT_SLICE_OPS instructions or one command per call.
+ * 
+ * @return false if a script is already running, the name is unknown or the
+ *         script does not compile (the error is printed)
+ */
+bool runScript(const char* name);
+
+/**
+ * @brief Stop the running script (same as "run -k").
+ */
+void stopScript();
+
+/**
+ * @brief Whether a script is running (or sleeping).
+ */
+bool isScriptRunning();
+
+/**
+ * @brief Set a variable of the running script, e.g. from a command it calls.
+ * 
+ * @return false if no script is running or it does not use the variable
+ */
+bool setScriptVar(const char* name, long value);
+
+/**
+ * @brief Read a variable of the running script.
+ * 
+ * @return false if no script is running or it does not use the variable
+ */
+bool getScriptVar(const char* name, long* value);
+
+/**
+ * @brief Get the script interpreter counters.
+ */
+ScriptStats getScriptStats();
+
+// ----------------------------
+// Trace Functions
+// ----------------------------
+
+/**
+ * @brief Start recording a new trace (same as AT+TRACE=1).
+ * 
+ * Every RX burst, TX write, mode change and command dispatch is stored
+ * with its micros() timestamp in a ring of AT_TRACE_BUF_LEN bytes; the
+ * oldest records are dropped when it is full. Does nothing unless
+ * AT_TRACE_BUF_LEN is set. The format is described in MoeSimpleATTrace.h.
+ */
+void startTrace();
+
+/**
+ * @brief Stop recording; the trace is kept for AT+TRACE? / readTrace().
+ */
+void stopTrace();
+
+/**
+ * @brief Copy the trace (oldest record first), e.g. to save it to a file.
+ * 
+ * @param out    Output buffer
+ * @param maxLen Size of the output buffer
+ * @param baseUs Receives the time of the first record (may be nullptr)
+ * @return Number of bytes copied
+ */
+size_t readTrace(uint8_t* out, size_t maxLen, uint32_t* baseUs);
+
+// ----------------------------
+// Unsolicited Result Code Functions
+// ----------------------------
+
+/**
+ * @brief Queue an unsolicited result code (asynchronous event line).
+ * 
+ * Use this instead of writing to atSerial directly from application code:
+ * queued URCs are written from handleATCommands() only, so they never land
+ * inside a command response. Higher priorities are delivered first.
+ * 
+ * The URC type is the text before the first ':' (e.g. "+TEMP" for
+ * "+TEMP:31.5"). A pending URC of the same type and priority is replaced by
+ * the newer one instead of queueing both.
+ * 
+ * @param line     URC text without CRLF (at most AT_URC_LINE_LEN chars)
+ * @param priority Delivery priority
+ * @return true if the URC was queued or coalesced, false if it was dropped
+ */
+bool postURC(const String& line, URCPriority priority = URC_NORMAL);
+bool postURC(const char* line, URCPriority priority = URC_NORMAL);
+
+/**
+ * @brief Select the backpressure policy used when the URC queue is full.
+ * 
+ * @param policy URC_DROP_OLDEST (default) or URC_DROP_NEWEST
+ */
+void setURCOverflowPolicy(URCOverflowPolicy policy);
+
+/**
+ * @brief Get URC queue counters.
+ * 
+ * @return Snapshot of the counters
+ */
+URCStats getURCStats();
+
+// ----------------------------
+// CMUX Functions
+// ----------------------------
+
+/**
+ * @brief Switch atSerial to 27.010 basic option multiplexing (same as AT+CMUX=0).
+ * 
+ * Once the host has opened the channels (SABM), AT commands, the log stream
+ * and the shell run concurrently on DLCI 1, 2 and 3. Each channel has its
+ * own transmit buffer and honours MSC flow control; channels with pending
+ * output are served round-robin, one frame at a time.
+ * 
+ * @param maxFrame Largest information field per frame (N1), clamped to AT_CMUX_MAX_FRAME
+ */
+void startCMUX(uint16_t maxFrame = AT_CMUX_MAX_FRAME);
+
+/**
+ * @brief Leave multiplexing mode and return to plain AT mode.
+ */
+void stopCMUX();
+
+/**
+ * @brief Whether multiplexing mode is active.
+ * 
+ * @return true between startCMUX() (or AT+CMUX) and close down
+ */
+bool isCMUXActive();
+
+/**
+ * @brief Get CMUX channel counters (kept across startCMUX() calls).
+ * 
+ * @return Snapshot of the counters
+ */
+CMUXStats getCMUXStats();
+
+#include "MoeSimpleATTemplate.h"
 
 #endif // AT_COMMANDS_H
\ No newline at end of file
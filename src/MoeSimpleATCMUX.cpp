@@ -0,0 +1,357 @@
+/**
+ * MoeSimpleATCMUX.cpp - 3GPP TS 27.010 basic option multiplexer
+ *
+ * Carries the AT interpreter, the log stream and the shell on separate
+ * virtual channels over atSerial. The device is always the responder:
+ * the host opens the control channel and each data channel with SABM.
+ * The frame codec is in MoeSimpleATCMUXCodec.cpp.
+ */
+
+#include "MoeSimpleATInternal.h"
+
+// ----------------------------
+// Virtual channels
+// ----------------------------
+
+/**
+ * @brief Print sink of one data channel, buffering output until it is framed.
+ */
+class CMUXChannel : public Print {
+public:
+    uint8_t dlci = 0;
+    bool open = false;
+    bool stopped = false;     // Host sent MSC with FC set
+    uint32_t dropped = 0;     // Bytes lost while the buffer was full and flow stopped
+
+    uint8_t buf[AT_CMUX_TX_BUF];
+    uint16_t head = 0;
+    uint16_t count = 0;
+
+    size_t write(uint8_t c) override {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t* data, size_t len) override;
+
+    int availableForWrite() override {
+        return AT_CMUX_TX_BUF - count;
+    }
+
+    using Print::write;
+};
+
+static CMUXChannel cmuxChannels[3];
+static bool cmuxActive = false;
+static bool cmuxStopped = false;       // Global flow control (FCoff)
+static uint16_t cmuxN1 = AT_CMUX_MAX_FRAME;
+static uint8_t cmuxNextChannel = 0;    // Round-robin position
+static uint8_t cmuxRxBuf[AT_CMUX_MAX_FRAME];
+
+static void onCMUXFrame(uint8_t dlci, bool cr, uint8_t control, const uint8_t* info, size_t len, void* context);
+static CMUXDecoder cmuxDecoder(cmuxRxBuf, sizeof(cmuxRxBuf), onCMUXFrame);
+
+static CMUXChannel* channelFor(uint8_t dlci) {
+    if (dlci >= AT_CMUX_DLCI_AT && dlci <= AT_CMUX_DLCI_SHELL) {
+        return &cmuxChannels[dlci - AT_CMUX_DLCI_AT];
+    }
+    return nullptr;
+}
+
+static void sendFrame(uint8_t dlci, bool cr, uint8_t control, const uint8_t* info, size_t len) {
+    uint8_t frame[AT_CMUX_MAX_FRAME + CMUX_FRAME_OVERHEAD];
+    size_t n = cmuxEncodeFrame(frame, sizeof(frame), dlci, cr, control, info, len);
+    if (n > 0) {
+        atSerialOutput()->write(frame, n);
+    }
+}
+
+// Send one UIH frame of buffered output; false if nothing could be sent
+static bool sendChannelFrame(CMUXChannel& ch) {
+    if (ch.count == 0 || !ch.open || ch.stopped || cmuxStopped) return false;
+
+    uint8_t info[AT_CMUX_MAX_FRAME];
+    uint16_t n = ch.count < cmuxN1 ? ch.count : cmuxN1;
+    for (uint16_t i = 0; i < n; i++) {
+        info[i] = ch.buf[(ch.head + i) % AT_CMUX_TX_BUF];
+    }
+    ch.head = (ch.head + n) % AT_CMUX_TX_BUF;
+    ch.count -= n;
+
+    // Data frames from the responder carry C/R = 0
+    sendFrame(ch.dlci, false, CMUX_UIH, info, n);
+    return true;
+}
+
+size_t CMUXChannel::write(const uint8_t* data, size_t len) {
+    if (!open) return len;  // Nobody listening on this channel
+
+    for (size_t i = 0; i < len; i++) {
+        // A full buffer is drained synchronously unless the host stopped us
+        if (count == AT_CMUX_TX_BUF && !sendChannelFrame(*this)) {
+            dropped += len - i;
+            return i;
+        }
+        buf[(head + count) % AT_CMUX_TX_BUF] = data[i];
+        count++;
+    }
+    return len;
+}
+
+// ----------------------------
+// Control channel
+// ----------------------------
+
+static void sendControlMessage(uint8_t type, const uint8_t* value, uint8_t len) {
+    uint8_t msg[2 + AT_CMUX_MAX_FRAME];
+    if (len > AT_CMUX_MAX_FRAME) len = AT_CMUX_MAX_FRAME;
+    msg[0] = type;
+    msg[1] = (uint8_t)((len << 1) | 0x01);
+    memcpy(msg + 2, value, len);
+    sendFrame(0, false, CMUX_UIH, msg, 2 + len);
+}
+
+static void handleControlMessage(const uint8_t* info, size_t len) {
+    if (len < 2) return;
+
+    uint8_t type = info[0];
+    uint8_t valueLen = info[1] >> 1;
+    const uint8_t* value = info + 2;
+    if (valueLen > len - 2) return;
+
+    // Responses from the host need no answer
+    if (!(type & CMUX_MSG_CR)) return;
+
+    uint8_t responseType = type & ~CMUX_MSG_CR;
+    switch (responseType) {
+        case CMUX_MSG_CLD:
+            sendControlMessage(responseType, nullptr, 0);
+            stopCMUX();
+            break;
+
+        case CMUX_MSG_TEST:
+            sendControlMessage(responseType, value, valueLen);
+            break;
+
+        case CMUX_MSG_FCON:
+        case CMUX_MSG_FCOFF:
+            cmuxStopped = (responseType == CMUX_MSG_FCOFF);
+            sendControlMessage(responseType, nullptr, 0);
+            break;
+
+        case CMUX_MSG_MSC:
+            if (valueLen >= 2) {
+                CMUXChannel* ch = channelFor(value[0] >> 2);
+                if (ch) ch->stopped = (value[1] & CMUX_V24_FC) != 0;
+            }
+            sendControlMessage(responseType, value, valueLen);
+            break;
+
+        default: {
+            // Unsupported (PN, PSC, ...): report it with NSC
+            uint8_t unsupported = type;
+            sendControlMessage(CMUX_MSG_NSC, &unsupported, 1);
+            break;
+        }
+    }
+}
+
+// ----------------------------
+// Frame dispatch
+// ----------------------------
+
+static void deliverChannelData(CMUXChannel& ch, const uint8_t* info, size_t len) {
+    Print* previous = atOutput;
+    atOutput = &ch;
+
+    if (ch.dlci == AT_CMUX_DLCI_AT) {
+        for (size_t i = 0; i < len && cmuxActive; i++) {
+            feedATChar((char)info[i]);
+        }
+    }
+    else if (ch.dlci == AT_CMUX_DLCI_SHELL) {
+        inShellMode = true;
+        for (size_t i = 0; i < len && cmuxActive; i++) {
+            feedShellChar((char)info[i]);
+            // 'exit' has no meaning on the shell channel: just prompt again
+            if (!inShellMode) {
+                startShellPrompt();
+                inShellMode = true;
+            }
+        }
+        inShellMode = false;
+    }
+    // Input on the log channel is ignored
+
+    atOutput = cmuxActive ? previous : atSerialOutput();
+}
+
+static void onCMUXFrame(uint8_t dlci, bool cr, uint8_t control, const uint8_t* info, size_t len, void*) {
+    (void)cr;
+    uint8_t type = control & ~CMUX_PF;
+    uint8_t pf = control & CMUX_PF;
+    CMUXChannel* ch = channelFor(dlci);
+
+    switch (type) {
+        case CMUX_SABM:
+            if (dlci != 0 && !ch) {
+                sendFrame(dlci, true, CMUX_DM | pf, nullptr, 0);
+                break;
+            }
+            sendFrame(dlci, true, CMUX_UA | pf, nullptr, 0);
+            if (ch && !ch->open) {
+                ch->open = true;
+                ch->stopped = false;
+                ch->head = ch->count = 0;
+                if (dlci == AT_CMUX_DLCI_SHELL) {
+                    Print* previous = atOutput;
+                    atOutput = ch;
+                    startShellPrompt();
+                    atOutput = previous;
+                }
+            }
+            break;
+
+        case CMUX_DISC:
+            sendFrame(dlci, true, (ch || dlci == 0 ? CMUX_UA : CMUX_DM) | pf, nullptr, 0);
+            if (dlci == 0) {
+                stopCMUX();
+            } else if (ch) {
+                ch->open = false;
+            }
+            break;
+
+        case CMUX_UIH:
+        case CMUX_UI:
+            if (dlci == 0) {
+                handleControlMessage(info, len);
+            } else if (ch && ch->open) {
+                deliverChannelData(*ch, info, len);
+            } else {
+                sendFrame(dlci, true, CMUX_DM | pf, nullptr, 0);
+            }
+            break;
+
+        default:
+            // UA / DM from the host: nothing to do as responder
+            break;
+    }
+}
+
+// ----------------------------
+// Service
+// ----------------------------
+
+void serviceCMUX() {
+    // The input budget counts the bytes of all channels and the lines of the AT / shell channels
+    size_t bytes = 0;
+    size_t firstLine = defaultAT.linesProcessed();
+    while (cmuxActive && atSerial->available() && inputBudgetLeft(bytes, defaultAT.linesProcessed() - firstLine)) {
+        uint8_t b = atSerial->read();
+        noteSerialRx(b);
+        cmuxDecoder.feed(b);
+        bytes++;
+    }
+    if (!cmuxActive) return;
+
+    // Fair scheduling: one frame per channel in turn, carrying on after the
+    // channel served last, until every channel is idle or stopped
+    uint8_t sent = 0;
+    uint8_t idle = 0;
+    while (idle < 3 && sent < AT_CMUX_FRAMES_PER_CALL) {
+        CMUXChannel& ch = cmuxChannels[cmuxNextChannel];
+        cmuxNextChannel = (cmuxNextChannel + 1) % 3;
+        if (sendChannelFrame(ch)) {
+            sent++;
+            idle = 0;
+        } else {
+            idle++;
+        }
+    }
+}
+
+void cmuxLog(const String& msg) {
+    cmuxChannels[AT_CMUX_DLCI_LOG - AT_CMUX_DLCI_AT].println(msg);
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+void startCMUX(uint16_t maxFrame) {
+    if (maxFrame == 0 || maxFrame > AT_CMUX_MAX_FRAME) maxFrame = AT_CMUX_MAX_FRAME;
+    cmuxN1 = maxFrame;
+
+    for (uint8_t i = 0; i < 3; i++) {
+        cmuxChannels[i].dlci = AT_CMUX_DLCI_AT + i;
+        cmuxChannels[i].open = false;
+        cmuxChannels[i].stopped = false;
+        cmuxChannels[i].head = cmuxChannels[i].count = 0;
+    }
+    cmuxStopped = false;
+    cmuxDecoder.reset();
+
+    inShellMode = false;
+    inLogMode = false;
+    defaultAT.resetInput();
+    cmuxActive = true;
+    atOutput = &cmuxChannels[AT_CMUX_DLCI_AT - AT_CMUX_DLCI_AT];
+}
+
+void stopCMUX() {
+    cmuxActive = false;
+    inShellMode = false;
+    defaultAT.resetInput();
+    atOutput = atSerialOutput();
+}
+
+bool isCMUXActive() {
+    return cmuxActive;
+}
+
+CMUXStats getCMUXStats() {
+    CMUXStats stats;
+    for (uint8_t i = 0; i < 3; i++) {
+        stats.dropped[i] = cmuxChannels[i].dropped;
+    }
+    return stats;
+}
+
+void handleCMUXATCommand(const char* cmd) {
+    if (strcmp(cmd, "AT+CMUX?") == 0) {
+        Print& out = beginATInfo();
+        out.print("+CMUX:0,0,,");
+        out.println(cmuxN1);
+        out.print("+CMUXDROP:");
+        for (uint8_t i = 0; i < 3; i++) {
+            if (i > 0) out.print(",");
+            out.print(cmuxChannels[i].dropped);
+        }
+        out.println();
+        sendATResult(AT_RESULT_OK);
+    }
+    else if (strncmp(cmd, "AT+CMUX=", 8) == 0 && !isCMUXActive() && !inTCPSession()) {
+        // AT+CMUX=<mode>[,<subset>[,<port_speed>[,<N1>]]]; only basic mode (0)
+        const char* params = cmd + 8;
+        if (params[0] != '0' || (params[1] != '\0' && params[1] != ',')) {
+            sendATResult(AT_RESULT_ERROR);
+            return;
+        }
+        long n1 = AT_CMUX_MAX_FRAME;
+        int field = 0;
+        for (const char* p = params; *p; p++) {
+            if (*p == ',' && ++field == 3 && p[1] != '\0') {
+                n1 = strtol(p + 1, nullptr, 10);
+            }
+        }
+        if (n1 <= 0 || n1 > AT_CMUX_MAX_FRAME) {
+            sendATResult(AT_RESULT_ERROR);
+            return;
+        }
+        // OK goes out in plain framing, everything after it is multiplexed
+        sendATResult(AT_RESULT_OK);
+        startCMUX((uint16_t)n1);
+    }
+    else {
+        sendATResult(AT_RESULT_ERROR);
+    }
+}
@@ -0,0 +1,129 @@
+/**
+ * MoeSimpleATCMUX.h - 3GPP TS 27.010 (CMUX basic option) frame codec
+ *
+ * Frame layout: F9 | Address | Control | Length (1-2 bytes) | Info | FCS | F9
+ *
+ * The codec (MoeSimpleATCMUXCodec.cpp) only needs the C library, so it can
+ * also be used on the host side, e.g. to demultiplex the output of a device
+ * running in CMUX mode.
+ */
+
+#ifndef MOE_SIMPLE_AT_CMUX_H
+#define MOE_SIMPLE_AT_CMUX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ----------------------------
+// Frame constants
+// ----------------------------
+
+#define CMUX_FLAG 0xF9
+
+// Control field values (P/F bit cleared)
+#define CMUX_SABM 0x2F   // Set asynchronous balanced mode (open channel)
+#define CMUX_UA   0x63   // Unnumbered acknowledgement
+#define CMUX_DM   0x0F   // Disconnected mode
+#define CMUX_DISC 0x43   // Disconnect (close channel)
+#define CMUX_UIH  0xEF   // Unnumbered information, FCS over header only
+#define CMUX_UI   0x03   // Unnumbered information, FCS over header and data
+#define CMUX_PF   0x10   // Poll/Final bit
+
+// Control channel (DLCI 0) message types (EA set, C/R cleared)
+#define CMUX_MSG_PN    0x81  // Parameter negotiation
+#define CMUX_MSG_PSC   0x41  // Power saving control
+#define CMUX_MSG_CLD   0xC1  // Multiplexer close down
+#define CMUX_MSG_TEST  0x21  // Test command
+#define CMUX_MSG_FCON  0xA1  // Flow control on (all channels)
+#define CMUX_MSG_FCOFF 0x61  // Flow control off (all channels)
+#define CMUX_MSG_MSC   0xE1  // Modem status command (per channel flow control)
+#define CMUX_MSG_NSC   0x11  // Non supported command response
+#define CMUX_MSG_CR    0x02  // C/R bit of a message type: set for commands
+
+// V.24 signal bits of an MSC message
+#define CMUX_V24_FC 0x02     // Flow control: receiver cannot accept frames
+
+// Bytes added around the information field by cmuxEncodeFrame() (worst case)
+#define CMUX_FRAME_OVERHEAD 7
+
+// ----------------------------
+// Codec functions
+// ----------------------------
+
+/**
+ * @brief Compute the 27.010 frame check sequence (reversed CRC-8, poly 0x07).
+ *
+ * @param data Bytes covered by the FCS (address, control, length[, info])
+ * @param len  Number of bytes
+ * @return FCS byte to transmit
+ */
+uint8_t cmuxFCS(const uint8_t* data, size_t len);
+
+/**
+ * @brief Encode one basic option frame.
+ *
+ * @param out     Output buffer (at least len + CMUX_FRAME_OVERHEAD bytes)
+ * @param outSize Size of the output buffer
+ * @param dlci    Data link connection identifier (0..63)
+ * @param cr      Command/response bit of the address field
+ * @param control Control field (frame type, optionally | CMUX_PF)
+ * @param info    Information field (may be nullptr if len is 0)
+ * @param len     Information field length (0..32767)
+ * @return Encoded frame length, or 0 if it does not fit
+ */
+size_t cmuxEncodeFrame(uint8_t* out, size_t outSize, uint8_t dlci, bool cr,
+                       uint8_t control, const uint8_t* info, size_t len);
+
+/**
+ * @brief Incremental basic option frame decoder.
+ *
+ * Bytes are fed one at a time; every frame with a valid FCS is reported to
+ * the callback. Corrupt or oversized frames are counted and skipped until
+ * the next flag.
+ */
+class CMUXDecoder {
+public:
+    typedef void (*FrameHandler)(uint8_t dlci, bool cr, uint8_t control,
+                                 const uint8_t* info, size_t len, void* context);
+
+    /**
+     * @param buffer   Storage for the information field of one frame
+     * @param capacity Size of buffer (largest accepted information field)
+     * @param handler  Called for every valid frame
+     * @param context  Passed to handler unchanged
+     */
+    CMUXDecoder(uint8_t* buffer, size_t capacity, FrameHandler handler, void* context = nullptr);
+
+    /**
+     * @brief Feed one received byte.
+     */
+    void feed(uint8_t b);
+
+    /**
+     * @brief Drop any partially received frame and wait for the next flag.
+     */
+    void reset();
+
+    uint32_t frames() const { return frameCount; }
+    uint32_t fcsErrors() const { return fcsErrorCount; }
+    uint32_t oversized() const { return oversizeCount; }
+
+private:
+    enum State : uint8_t { WAIT_FLAG, ADDRESS, CONTROL, LENGTH, LENGTH2, INFO, FCS, CLOSE_FLAG };
+
+    uint8_t* buf;
+    size_t cap;
+    FrameHandler onFrame;
+    void* onFrameContext;
+    State state;
+    uint8_t header[4];
+    uint8_t headerLen;
+    size_t infoLen;
+    size_t pos;
+    uint8_t fcs;
+    uint32_t frameCount;
+    uint32_t fcsErrorCount;
+    uint32_t oversizeCount;
+};
+
+#endif // MOE_SIMPLE_AT_CMUX_H
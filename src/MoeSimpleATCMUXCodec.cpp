@@ -0,0 +1,143 @@
+/**
+ * MoeSimpleATCMUXCodec.cpp - 3GPP TS 27.010 (CMUX basic option) frame codec
+ *
+ * Depends on the C library only, so it builds on the host as well (see
+ * MoeSimpleATCMUX.h). The multiplexer itself is in MoeSimpleATCMUX.cpp.
+ */
+
+#include <string.h>
+#include "MoeSimpleATCMUX.h"
+
+// ----------------------------
+// Frame codec
+// ----------------------------
+
+static uint8_t crcUpdate(uint8_t crc, const uint8_t* data, size_t len) {
+    while (len--) {
+        crc ^= *data++;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 0x01) ? (crc >> 1) ^ 0xE0 : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+uint8_t cmuxFCS(const uint8_t* data, size_t len) {
+    return 0xFF - crcUpdate(0xFF, data, len);
+}
+
+size_t cmuxEncodeFrame(uint8_t* out, size_t outSize, uint8_t dlci, bool cr,
+                       uint8_t control, const uint8_t* info, size_t len) {
+    if (len > 0x7FFF || outSize < len + CMUX_FRAME_OVERHEAD) return 0;
+
+    size_t n = 0;
+    out[n++] = CMUX_FLAG;
+    out[n++] = (uint8_t)((dlci << 2) | (cr ? 0x02 : 0) | 0x01);
+    out[n++] = control;
+    if (len <= 0x7F) {
+        out[n++] = (uint8_t)((len << 1) | 0x01);
+    } else {
+        out[n++] = (uint8_t)(len << 1);
+        out[n++] = (uint8_t)(len >> 7);
+    }
+    size_t headerLen = n - 1;
+    if (len > 0) {
+        memcpy(out + n, info, len);
+    }
+    n += len;
+
+    // UI frames also protect the information field
+    bool fullFCS = (control & ~CMUX_PF) == CMUX_UI;
+    out[n++] = cmuxFCS(out + 1, fullFCS ? headerLen + len : headerLen);
+    out[n++] = CMUX_FLAG;
+    return n;
+}
+
+CMUXDecoder::CMUXDecoder(uint8_t* buffer, size_t capacity, FrameHandler handler, void* context)
+    : buf(buffer), cap(capacity), onFrame(handler), onFrameContext(context), state(WAIT_FLAG), headerLen(0),
+      infoLen(0), pos(0), fcs(0), frameCount(0), fcsErrorCount(0), oversizeCount(0) {
+}
+
+void CMUXDecoder::reset() {
+    state = WAIT_FLAG;
+}
+
+void CMUXDecoder::feed(uint8_t b) {
+    switch (state) {
+        case WAIT_FLAG:
+            if (b == CMUX_FLAG) state = ADDRESS;
+            break;
+
+        case ADDRESS:
+            if (b == CMUX_FLAG) break;  // Repeated flag between frames
+            if (!(b & 0x01)) {          // Only 1-byte addresses exist in basic option
+                state = WAIT_FLAG;
+                break;
+            }
+            header[0] = b;
+            headerLen = 1;
+            state = CONTROL;
+            break;
+
+        case CONTROL:
+            header[headerLen++] = b;
+            state = LENGTH;
+            break;
+
+        case LENGTH:
+        case LENGTH2:
+            header[headerLen++] = b;
+            if (state == LENGTH) {
+                infoLen = b >> 1;
+                if (!(b & 0x01)) {  // EA clear: second length byte follows
+                    state = LENGTH2;
+                    break;
+                }
+            } else {
+                infoLen |= (size_t)b << 7;
+            }
+            if (infoLen > cap) {
+                oversizeCount++;
+                state = WAIT_FLAG;
+                break;
+            }
+            pos = 0;
+            state = infoLen ? INFO : FCS;
+            break;
+
+        case INFO:
+            buf[pos++] = b;
+            if (pos == infoLen) state = FCS;
+            break;
+
+        case FCS:
+            fcs = b;
+            state = CLOSE_FLAG;
+            break;
+
+        case CLOSE_FLAG: {
+            state = ADDRESS;
+            if (b != CMUX_FLAG) {
+                fcsErrorCount++;
+                state = WAIT_FLAG;
+                break;
+            }
+
+            uint8_t control = header[1];
+            uint8_t crc = crcUpdate(0xFF, header, headerLen);
+            if ((control & ~CMUX_PF) == CMUX_UI) {
+                crc = crcUpdate(crc, buf, infoLen);
+            }
+            if ((uint8_t)(0xFF - crc) != fcs) {
+                fcsErrorCount++;
+                break;
+            }
+
+            frameCount++;
+            if (onFrame) {
+                onFrame(header[0] >> 2, (header[0] & 0x02) != 0, control, buf, infoLen, onFrameContext);
+            }
+            break;
+        }
+    }
+}
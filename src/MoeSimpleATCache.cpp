@@ -0,0 +1,285 @@
+/**
+ * MoeSimpleATCache.cpp - Query response cache
+ *
+ * While a cacheable query runs, the response buffer copies its output into
+ * the free end of one shared byte buffer; if the command ends with OK the
+ * bytes before the result code are kept. Responses are packed back to back
+ * and the buffer is compacted when one is dropped, so there is no
+ * fragmentation. A replay writes the bytes and sends OK again, which
+ * follows the current ATV / ATQ settings.
+ */
+
+#include "MoeSimpleATInternal.h"
+
+static_assert(AT_CACHE_BUF_LEN <= 65535, "AT_CACHE_BUF_LEN must be at most 65535");
+
+struct CacheEntry {
+    char query[AT_COMMAND_NAME_LEN + 4];   // "AT+", a command name and "?"
+    const char* related;
+    uint32_t ttlMs;                        // 0: free slot
+    unsigned long storedMs;
+    uint16_t offset;
+    uint16_t len;
+    bool valid;
+    bool infoSent;                         // The handler used sendATInfo() / beginATInfo()
+    uint32_t hits;
+    uint32_t misses;
+};
+
+static CacheEntry cacheEntries[AT_CACHE_ENTRIES];
+static uint8_t cacheBuf[AT_CACHE_BUF_LEN];
+static size_t cacheUsed = 0;
+
+static ATCacheStats cacheStats;
+
+// Response being captured, behind the stored ones at cacheBuf[cacheUsed]
+static CacheEntry* capturing = nullptr;
+static size_t captured = 0;
+static size_t resultAt = 0;
+static bool resultSeen = false;
+static bool captureInfoSent = false;
+static bool captureOverflow = false;
+
+// ----------------------------
+// Buffer
+// ----------------------------
+
+// Free the bytes of a stored response and pack the following ones (and a capture) down
+static void dropResponse(CacheEntry& e) {
+    if (!e.valid) return;
+    size_t end = e.offset + e.len;
+    memmove(cacheBuf + e.offset, cacheBuf + end, cacheUsed + captured - end);
+    for (CacheEntry& other : cacheEntries) {
+        if (other.valid && other.offset > e.offset) other.offset -= e.len;
+    }
+    cacheUsed -= e.len;
+    e.valid = false;
+}
+
+static void invalidate(CacheEntry& e) {
+    if (!e.valid) return;
+    dropResponse(e);
+    cacheStats.invalidations++;
+}
+
+class CaptureTap : public Print {
+public:
+    size_t write(uint8_t c) override {
+        if (cacheUsed + captured < sizeof(cacheBuf)) {
+            cacheBuf[cacheUsed + captured++] = c;
+        } else if (!resultSeen) {
+            captureOverflow = true;
+        }
+        return 1;
+    }
+
+    using Print::write;
+};
+
+static CaptureTap captureTap;
+
+// Length of the command name in line, up to "=" / "?"
+static size_t commandNameLen(const char* line) {
+    return strcspn(line, "=?");
+}
+
+static bool sameCommand(const char* a, const char* b) {
+    size_t len = commandNameLen(a);
+    return len == commandNameLen(b) && strncasecmp(a, b, len) == 0;
+}
+
+// ----------------------------
+// Hooks
+// ----------------------------
+
+bool replayCachedResponse(const char* cmd, Print** tap) {
+    *tap = nullptr;
+    size_t len = strlen(cmd);
+    bool query = len > 0 && cmd[len - 1] == '?';
+
+    CacheEntry* match = nullptr;
+    for (CacheEntry& e : cacheEntries) {
+        if (e.ttlMs == 0) continue;
+        if (strcmp(e.query, cmd) == 0) {
+            match = &e;
+        }
+        else if (!query && (sameCommand(e.query, cmd) || (e.related && sameCommand(e.related, cmd)))) {
+            invalidate(e);
+        }
+    }
+    if (!match) return false;
+
+    if (match->valid && millis() - match->storedMs < match->ttlMs) {
+        match->hits++;
+        cacheStats.hits++;
+        atOutput->write(cacheBuf + match->offset, match->len);
+        if (match->infoSent) beginATInfo();
+        sendATResult(AT_RESULT_OK);
+        return true;
+    }
+
+    match->misses++;
+    cacheStats.misses++;
+    dropResponse(*match);
+    capturing = match;
+    captured = 0;
+    resultSeen = false;
+    captureOverflow = false;
+    *tap = &captureTap;
+    return false;
+}
+
+void noteCachedResult(ATResultCode code, bool infoSent) {
+    if (!capturing) return;
+    // The last result wins: nested commands report theirs first
+    resultAt = captured;
+    resultSeen = (code == AT_RESULT_OK);
+    captureInfoSent = infoSent;
+}
+
+void endCachedResponse() {
+    if (!capturing) return;
+    if (captureOverflow) {
+        cacheStats.oversize++;
+    }
+    else if (resultSeen) {
+        capturing->offset = cacheUsed;
+        capturing->len = resultAt;
+        capturing->storedMs = millis();
+        capturing->infoSent = captureInfoSent;
+        capturing->valid = true;
+        cacheUsed += resultAt;
+        cacheStats.stores++;
+    }
+    capturing = nullptr;
+    captured = 0;
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+bool setATQueryCache(const char* query, uint32_t ttlMs, const char* related) {
+    if (!query || strlen(query) >= sizeof(cacheEntries[0].query)) return false;
+
+    CacheEntry* slot = nullptr;
+    for (CacheEntry& e : cacheEntries) {
+        if (e.ttlMs != 0 && strcasecmp(e.query, query) == 0) {
+            slot = &e;
+            break;
+        }
+    }
+    if (!slot) {
+        if (ttlMs == 0) return true;
+        for (CacheEntry& e : cacheEntries) {
+            if (e.ttlMs == 0) {
+                slot = &e;
+                break;
+            }
+        }
+        if (!slot) return false;
+
+        size_t i = 0;
+        for (; query[i]; i++) slot->query[i] = toupper((unsigned char)query[i]);
+        slot->query[i] = '\0';
+        slot->valid = false;
+        slot->hits = 0;
+        slot->misses = 0;
+    }
+
+    dropResponse(*slot);
+    if (capturing == slot) capturing = nullptr;
+    slot->ttlMs = ttlMs;
+    slot->related = related;
+    return true;
+}
+
+void invalidateATCache(const char* command) {
+    for (CacheEntry& e : cacheEntries) {
+        if (e.ttlMs != 0 && (!command || sameCommand(e.query, command))) {
+            invalidate(e);
+        }
+    }
+}
+
+ATCacheStats getATCacheStats() {
+    return cacheStats;
+}
+
+void resetATCacheStats() {
+    cacheStats = ATCacheStats();
+    for (CacheEntry& e : cacheEntries) {
+        e.hits = 0;
+        e.misses = 0;
+    }
+}
+
+// ----------------------------
+// AT: AT+CACHE
+// ----------------------------
+
+void handleCacheATCommand(const char* cmd) {
+    if (strcmp(cmd, "AT+CACHE?") == 0) {
+        // +CACHE:<hits>,<misses>,<stores>,<invalidations>,<oversize>,<used bytes>,<buffer bytes>
+        // +CACHE:"<query>",<ttl ms>,<age ms or -1>,<bytes>,<hits>,<misses>
+        Print& out = beginATInfo();
+        out.print("+CACHE:");
+        out.print(cacheStats.hits);
+        out.print(",");
+        out.print(cacheStats.misses);
+        out.print(",");
+        out.print(cacheStats.stores);
+        out.print(",");
+        out.print(cacheStats.invalidations);
+        out.print(",");
+        out.print(cacheStats.oversize);
+        out.print(",");
+        out.print((unsigned long)cacheUsed);
+        out.print(",");
+        out.println((unsigned long)sizeof(cacheBuf));
+
+        unsigned long now = millis();
+        for (const CacheEntry& e : cacheEntries) {
+            if (e.ttlMs == 0) continue;
+            out.print("+CACHE:\"");
+            out.print(e.query);
+            out.print("\",");
+            out.print(e.ttlMs);
+            out.print(",");
+            if (e.valid) out.print(now - e.storedMs);
+            else out.print("-1");
+            out.print(",");
+            out.print(e.valid ? e.len : 0);
+            out.print(",");
+            out.print(e.hits);
+            out.print(",");
+            out.println(e.misses);
+        }
+        sendATResult(AT_RESULT_OK);
+        return;
+    }
+
+    if (strcmp(cmd, "AT+CACHE=0") == 0) {
+        invalidateATCache(nullptr);
+        resetATCacheStats();
+        sendATResult(AT_RESULT_OK);
+        return;
+    }
+
+    // AT+CACHE="<query>",<ttl ms>
+    bool ok = false;
+    if (strncmp(cmd, "AT+CACHE=\"", 10) == 0) {
+        const char* query = cmd + 10;
+        const char* quote = strchr(query, '"');
+        char line[sizeof(cacheEntries[0].query)];
+        size_t len = quote ? quote - query : 0;
+        if (len > 0 && len < sizeof(line) && quote[1] == ',') {
+            memcpy(line, query, len);
+            line[len] = '\0';
+            char* end;
+            unsigned long ttl = strtoul(quote + 2, &end, 10);
+            ok = end != quote + 2 && *end == '\0' && setATQueryCache(line, ttl);
+        }
+    }
+    sendATResult(ok ? AT_RESULT_OK : AT_RESULT_ERROR);
+}
@@ -0,0 +1,130 @@
+/**
+ * MoeSimpleATFormat.cpp - Number and column formatting
+ *
+ * Used by the built-in tables (free, AT+SYSRAM?, AT+GMR) and available to
+ * custom handlers. Text is built in small stack buffers and padding is
+ * written in chunks, so refreshing a table does not touch the heap.
+ */
+
+#include "MoeSimpleATInternal.h"
+
+// Longest text of formatNumber() / formatBytes(): a 64-bit long, sign and terminator
+static const size_t NUMBER_TEXT_LEN = 24;
+
+static const char spaces[] = "                ";
+
+// ----------------------------
+// Buffers
+// ----------------------------
+
+// Digits of value in reverse order, returns the count
+static size_t reverseDigits(char* digits, unsigned long long value) {
+    size_t count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    return count;
+}
+
+size_t appendText(char* buf, size_t size, size_t len, const char* text) {
+    while (*text && len + 1 < size) {
+        buf[len++] = *text++;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static size_t appendNumber(char* buf, size_t size, size_t len, unsigned long long value) {
+    char digits[NUMBER_TEXT_LEN];
+    size_t count = reverseDigits(digits, value);
+    while (count > 0 && len + 1 < size) {
+        buf[len++] = digits[--count];
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+size_t formatNumber(char* buf, size_t size, long value) {
+    if (!buf || size == 0) return 0;
+    buf[0] = '\0';
+
+    size_t len = 0;
+    unsigned long long magnitude = (unsigned long long)value;
+    if (value < 0) {
+        len = appendText(buf, size, len, "-");
+        magnitude = 0ULL - magnitude;
+    }
+    return appendNumber(buf, size, len, magnitude);
+}
+
+size_t formatBytes(char* buf, size_t size, unsigned long bytes, ByteUnit unit) {
+    if (!buf || size == 0) return 0;
+    buf[0] = '\0';
+
+    if (unit != BYTES_HUMAN) {
+        return appendNumber(buf, size, 0, bytes / unit);
+    }
+
+    if (bytes < 1024) {
+        size_t len = appendNumber(buf, size, 0, bytes);
+        return appendText(buf, size, len, "B");
+    }
+
+    // Value in tenths of the unit, moving up while it would print as 1024 or more
+    static const char suffixes[] = "KMG";
+    unsigned long long scale = 1024;
+    size_t suffix = 0;
+    unsigned long long tenths = ((unsigned long long)bytes * 10 + scale / 2) / scale;
+    while (tenths >= 10240 && suffix + 1 < sizeof(suffixes) - 1) {
+        scale *= 1024;
+        suffix++;
+        tenths = ((unsigned long long)bytes * 10 + scale / 2) / scale;
+    }
+
+    size_t len;
+    if (tenths < 100) {
+        len = appendNumber(buf, size, 0, tenths / 10);
+        len = appendText(buf, size, len, ".");
+        len = appendNumber(buf, size, len, tenths % 10);
+    } else {
+        len = appendNumber(buf, size, 0, (tenths + 5) / 10);
+    }
+    char letter[2] = { suffixes[suffix], '\0' };
+    return appendText(buf, size, len, letter);
+}
+
+// ----------------------------
+// Print helpers
+// ----------------------------
+
+static void printSpaces(Print& out, size_t count) {
+    while (count > 0) {
+        size_t chunk = count < sizeof(spaces) - 1 ? count : sizeof(spaces) - 1;
+        out.write((const uint8_t*)spaces, chunk);
+        count -= chunk;
+    }
+}
+
+void printPadded(Print& out, const char* text, int width) {
+    if (!text) text = "";
+    size_t len = strlen(text);
+    size_t column = (size_t)(width < 0 ? -width : width);
+    size_t pad = len < column ? column - len : 0;
+
+    if (width > 0) printSpaces(out, pad);
+    out.write((const uint8_t*)text, len);
+    if (width < 0) printSpaces(out, pad);
+}
+
+void printNumber(Print& out, long value, int width) {
+    char text[NUMBER_TEXT_LEN];
+    formatNumber(text, sizeof(text), value);
+    printPadded(out, text, width);
+}
+
+void printBytes(Print& out, unsigned long bytes, ByteUnit unit, int width) {
+    char text[NUMBER_TEXT_LEN];
+    formatBytes(text, sizeof(text), bytes, unit);
+    printPadded(out, text, width);
+}
@@ -0,0 +1,331 @@
+/**
+ * MoeSimpleATInternal.h - Internal interfaces shared between MoeSimpleAT modules
+ *
+ * Not part of the public API; sketches should include MoeSimpleAT.h only.
+ */
+
+#ifndef MOE_SIMPLE_AT_INTERNAL_H
+#define MOE_SIMPLE_AT_INTERNAL_H
+
+#include "MoeSimpleAT.h"
+
+// ----------------------------
+// Shell
+// ----------------------------
+
+/**
+ * @brief Reprint the "msh> " prompt and the partially typed line.
+ *
+ * Used after asynchronous output (e.g. a scheduled job) has been written
+ * over the prompt. Does nothing outside shell mode.
+ */
+void redrawShellPrompt();
+
+/**
+ * @brief Start a fresh shell input line and print the prompt to atOutput.
+ */
+void startShellPrompt();
+
+/**
+ * @brief Feed one received character to the shell line editor (writes to atOutput).
+ */
+void feedShellChar(char c);
+
+// ----------------------------
+// AT
+// ----------------------------
+
+/**
+ * @brief Feed one received character to the AT line assembler (writes to atOutput).
+ */
+void feedATChar(char c);
+
+// ----------------------------
+// Scheduler
+// ----------------------------
+
+/**
+ * @brief Advance the timer wheel and fire due jobs. Called from handleATCommands().
+ */
+void serviceScheduler();
+
+/**
+ * @brief Whether a scheduled job is currently being executed.
+ *
+ * Commands that would themselves create periodic jobs (e.g. "free -s")
+ * check this to avoid scheduling recursively.
+ */
+bool isSchedulerFiring();
+
+/**
+ * @brief Milliseconds until the next scheduled job is due (ULONG_MAX if none).
+ */
+unsigned long schedulerIdleMs();
+
+/**
+ * @brief Shell built-in: watch [-n sec] <command> | watch -c <id> | watch
+ */
+void handleWatchCommand(int argc, char* argv[], void* context);
+
+/**
+ * @brief AT built-in: AT+SCHED=<ms>,<cmd> | AT+SCHED? | AT+SCHEDDEL=<id>
+ *
+ * @param cmd Upper-cased command line starting with "AT+SCHED"
+ */
+void handleSchedATCommand(const char* cmd);
+
+// ----------------------------
+// Unsolicited result codes
+// ----------------------------
+
+/**
+ * @brief Write queued URCs between command responses. Called from handleATCommands().
+ */
+void serviceURCQueue();
+
+/**
+ * @brief AT built-in: AT+URC? | AT+URC=<policy>
+ *
+ * @param cmd Upper-cased command line starting with "AT+URC"
+ */
+void handleURCATCommand(const char* cmd);
+
+// ----------------------------
+// Idle power management
+// ----------------------------
+
+/**
+ * @brief Track RX activity and enter light sleep once idle. Called from handleATCommands().
+ */
+void servicePower();
+
+/**
+ * @brief AT built-in: AT+IDLE? | AT+IDLE=<idle_ms>[,<budget_ms>]
+ *
+ * @param cmd Upper-cased command line starting with "AT+IDLE"
+ */
+void handleIdleATCommand(const char* cmd);
+
+// ----------------------------
+// TCP transport
+// ----------------------------
+
+/**
+ * @brief Accept clients and process their input; called from handleATCommands().
+ */
+void serviceTCP();
+
+/**
+ * @brief Whether a network client's input is being processed right now.
+ */
+bool inTCPSession();
+
+/**
+ * @brief Whether beginTCPServer() is listening (light sleep would stall the network).
+ */
+bool tcpServerActive();
+
+/**
+ * @brief Send a log line to the network clients in log mode.
+ */
+void tcpLog(const String& msg);
+
+/**
+ * @brief AT built-in: AT+TCPSRV? | AT+TCPSRV=<port>[,<telnet>]
+ *
+ * @param cmd Upper-cased command line starting with "AT+TCPSRV"
+ */
+void handleTCPATCommand(const char* cmd);
+
+// ----------------------------
+// Script
+// ----------------------------
+
+/**
+ * @brief Run a slice of the running script; called from handleATCommands().
+ */
+void serviceScript();
+
+/**
+ * @brief Milliseconds until the script needs the CPU (0: now, ULONG_MAX: no script).
+ */
+unsigned long scriptIdleMs();
+
+/**
+ * @brief Shell built-ins: run [<name>|-k], script [[-d] <name> [<source>]]
+ */
+void handleRunCommand(const char* args);
+void handleScriptCommand(const char* args);
+
+/**
+ * @brief Result code of the last sendATResult() call.
+ */
+ATResultCode lastATResultCode();
+
+// ----------------------------
+// Input limits
+// ----------------------------
+
+/**
+ * @brief AT built-in: AT+LIMIT? | AT+LIMIT=0 | AT+LIMIT=BUDGET|AT|SHELL|"<cmd>",<a>,<b>
+ *
+ * @param cmd Upper-cased command line starting with "AT+LIMIT"
+ */
+void handleLimitATCommand(const char* cmd);
+
+// ----------------------------
+// Query cache
+// ----------------------------
+
+// Called by sendATResult(): marks where the response of a captured query ends
+void noteCachedResult(ATResultCode code, bool infoSent);
+
+/**
+ * @brief AT built-in: AT+CACHE? | AT+CACHE=0 | AT+CACHE="<query>",<ttl ms>
+ *
+ * @param cmd Upper-cased command line starting with "AT+CACHE"
+ */
+void handleCacheATCommand(const char* cmd);
+
+// ----------------------------
+// Loop monitor
+// ----------------------------
+
+// First and last thing handleATCommands() does
+void beginLoopMonitor();
+void endLoopMonitor();
+
+// Time the current call spent in idle light sleep (MoeSimpleATPower.cpp)
+void noteLoopSleep(uint32_t us);
+
+/**
+ * @brief AT built-in: AT+LOOPSTAT? | AT+LOOPSTAT=0 | AT+LOOPSTAT=WARN,<ms>
+ *
+ * @param cmd Upper-cased command line starting with "AT+LOOPSTAT"
+ */
+void handleLoopStatATCommand(const char* cmd);
+
+// ----------------------------
+// UART transport
+// ----------------------------
+
+// Baud rate atSerial was last opened with (MoeSimpleAT.cpp)
+extern long currentBaudRate;
+
+/**
+ * @brief Print that writes to atSerial and counts (and traces) what is sent.
+ *
+ * Use instead of atSerial wherever atOutput is reset to the serial port.
+ */
+Print* atSerialOutput();
+
+/**
+ * @brief Register for UART driver errors; called by initATCommands().
+ */
+void beginUARTStats();
+
+/**
+ * @brief Sample loop gap, RX backlog and driver errors; start of handleATCommands().
+ */
+void serviceUARTStats();
+
+/**
+ * @brief Mark the end of handleATCommands(); the next loop gap starts here.
+ */
+void endUARTStatsLoop();
+
+/**
+ * @brief Apply the line settings saved by AT+UART=; called by initATCommands().
+ */
+void beginUARTConfig();
+
+/**
+ * @brief Read input while autobaud hunts for the host's rate.
+ *
+ * @return true while hunting: the interpreters must not read atSerial
+ */
+bool serviceAutobaud();
+
+/**
+ * @brief Apply a line settings change requested with setUARTConfig(); end of handleATCommands().
+ */
+void serviceUARTConfig();
+
+/**
+ * @brief AT built-in: AT+UART? | AT+UART=<baud>[,<databits>,<stopbits>,<parity>,<flow>]
+ *
+ * @param cmd Upper-cased command line starting with "AT+UART"
+ */
+void handleUARTATCommand(const char* cmd);
+
+/**
+ * @brief Shell built-in: uartstat [-r]
+ */
+void handleUARTStatCommand(int argc, char* argv[], void* context);
+
+/**
+ * @brief AT built-in: AT+UARTSTAT? | AT+UARTSTAT=0
+ *
+ * @param cmd Upper-cased command line starting with "AT+UARTSTAT"
+ */
+void handleUARTStatATCommand(const char* cmd);
+
+// ----------------------------
+// Trace
+// ----------------------------
+
+/**
+ * @brief Record one received / transmitted byte (no-op unless recording).
+ */
+void traceRxByte(uint8_t c);
+void traceTxByte(uint8_t c);
+
+/**
+ * @brief Flush pending RX/TX bursts and record mode changes. Called from handleATCommands().
+ */
+void serviceTrace();
+
+/**
+ * @brief AT built-in: AT+TRACE? | AT+TRACE=<0|1>
+ *
+ * @param cmd Upper-cased command line starting with "AT+TRACE"
+ */
+void handleTraceATCommand(const char* cmd);
+
+// Called on every dispatch even when not recording (used by the host replayer)
+extern void (*traceDispatchObserver)(TraceEventType type, const char* line);
+
+// ----------------------------
+// CMUX
+// ----------------------------
+
+/**
+ * @brief Decode received frames and transmit pending channel output.
+ * Called from handleATCommands() while CMUX is active.
+ */
+void serviceCMUX();
+
+/**
+ * @brief Write a log line to the log channel.
+ */
+void cmuxLog(const String& msg);
+
+/**
+ * @brief AT built-in: AT+CMUX=<mode>[,<subset>[,<speed>[,<N1>]]] | AT+CMUX?
+ *
+ * @param cmd Upper-cased command line starting with "AT+CMUX"
+ */
+void handleCMUXATCommand(const char* cmd);
+
+// ----------------------------
+// Formatting
+// ----------------------------
+
+/**
+ * @brief Append text at buf[len], truncating to size and keeping the terminator.
+ *
+ * @return The new length
+ */
+size_t appendText(char* buf, size_t size, size_t len, const char* text);
+
+#endif // MOE_SIMPLE_AT_INTERNAL_H
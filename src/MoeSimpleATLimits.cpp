@@ -0,0 +1,255 @@
+/**
+ * MoeSimpleATLimits.cpp - Input budgets and rate limits
+ *
+ * The budget bounds how much input one handleATCommands() call reads and
+ * executes; whatever is left waits in the UART buffer. Rate limits are
+ * token buckets checked when a complete line arrives from the host (UART,
+ * CMUX or TCP), before it is executed.
+ */
+
+#include <limits.h>
+#include "MoeSimpleATInternal.h"
+
+// One token is 1000 milli-tokens, so slow rates refill in whole milliseconds
+static const uint32_t TOKEN = 1000;
+
+struct RateBucket {
+    uint16_t perSecond;       // 0: no limit
+    uint16_t burst;
+    uint32_t milliTokens;
+    unsigned long lastMs;
+};
+
+struct CommandLimit {
+    char name[AT_COMMAND_NAME_LEN + 3];   // "AT+" and a command name, or a shell command
+    RateBucket bucket;
+    uint32_t busy;
+};
+
+static size_t maxBytes = AT_INPUT_MAX_BYTES;
+static size_t maxLines = AT_INPUT_MAX_LINES;
+
+static RateBucket atBucket = { 0, 1, 0, 0 };
+static RateBucket shellBucket = { 0, 1, 0, 0 };
+static CommandLimit commandLimits[AT_RATE_LIMIT_COMMANDS];
+
+static InputLimitStats limitStats;
+
+// ----------------------------
+// Token buckets
+// ----------------------------
+
+static void setBucket(RateBucket& b, uint16_t perSecond, uint16_t burst) {
+    b.perSecond = perSecond;
+    b.burst = burst > 0 ? burst : 1;
+    b.milliTokens = (uint32_t)b.burst * TOKEN;   // Start full
+    b.lastMs = millis();
+}
+
+static void refill(RateBucket& b, unsigned long now) {
+    if (b.perSecond == 0) return;
+    uint32_t capacity = (uint32_t)b.burst * TOKEN;
+    uint64_t added = (uint64_t)(now - b.lastMs) * b.perSecond;   // perSecond tokens per 1000 ms
+    b.lastMs = now;
+    b.milliTokens = (added >= capacity - b.milliTokens) ? capacity : b.milliTokens + (uint32_t)added;
+}
+
+static bool hasToken(const RateBucket& b) {
+    return b.perSecond == 0 || b.milliTokens >= TOKEN;
+}
+
+static void takeToken(RateBucket& b) {
+    if (b.perSecond != 0) b.milliTokens -= TOKEN;
+}
+
+// ----------------------------
+// Hooks
+// ----------------------------
+
+bool inputBudgetLeft(size_t bytes, size_t lines) {
+    if (maxBytes > 0 && bytes >= maxBytes) {
+        limitStats.byteBudgetHits++;
+        return false;
+    }
+    if (maxLines > 0 && lines >= maxLines) {
+        limitStats.lineBudgetHits++;
+        return false;
+    }
+    return true;
+}
+
+// Limit whose name is the first word of line: up to '=' / '?' for AT, a space for the shell
+static CommandLimit* findCommandLimit(bool shell, const char* line) {
+    while (*line == ' ') line++;
+    size_t len = shell ? strcspn(line, " \t") : strcspn(line, "=? \t");
+    for (CommandLimit& limit : commandLimits) {
+        if (limit.bucket.perSecond != 0 && strlen(limit.name) == len && strncasecmp(limit.name, line, len) == 0) {
+            return &limit;
+        }
+    }
+    return nullptr;
+}
+
+bool admitInputLine(bool shell, const char* line) {
+    unsigned long now = millis();
+    RateBucket& mode = shell ? shellBucket : atBucket;
+    CommandLimit* command = findCommandLimit(shell, line);
+
+    refill(mode, now);
+    if (command) refill(command->bucket, now);
+
+    if (command && !hasToken(command->bucket)) {
+        command->busy++;
+        limitStats.commandBusy++;
+        return false;
+    }
+    if (!hasToken(mode)) {
+        if (shell) limitStats.shellBusy++;
+        else limitStats.atBusy++;
+        return false;
+    }
+
+    takeToken(mode);
+    if (command) takeToken(command->bucket);
+    return true;
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+void setInputBudget(size_t bytes, size_t lines) {
+    maxBytes = bytes;
+    maxLines = lines;
+}
+
+void setATRateLimit(uint16_t perSecond, uint16_t burst) {
+    setBucket(atBucket, perSecond, burst);
+}
+
+void setShellRateLimit(uint16_t perSecond, uint16_t burst) {
+    setBucket(shellBucket, perSecond, burst);
+}
+
+bool setCommandRateLimit(const char* command, uint16_t perSecond, uint16_t burst) {
+    if (!command || strlen(command) >= sizeof(commandLimits[0].name)) return false;
+
+    // Update or remove an existing limit
+    for (CommandLimit& limit : commandLimits) {
+        if (limit.bucket.perSecond != 0 && strcasecmp(limit.name, command) == 0) {
+            setBucket(limit.bucket, perSecond, burst);
+            return true;
+        }
+    }
+    if (perSecond == 0) return true;
+
+    for (CommandLimit& limit : commandLimits) {
+        if (limit.bucket.perSecond == 0) {
+            strcpy(limit.name, command);
+            setBucket(limit.bucket, perSecond, burst);
+            limit.busy = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+InputLimitStats getInputLimitStats() {
+    return limitStats;
+}
+
+void resetInputLimitStats() {
+    limitStats = InputLimitStats();
+    for (CommandLimit& limit : commandLimits) {
+        limit.busy = 0;
+    }
+}
+
+// ----------------------------
+// AT: AT+LIMIT
+// ----------------------------
+
+static void sendLimitInfo(const char* scope, const RateBucket& b, uint32_t busy) {
+    Print& out = beginATInfo();
+    out.print("+LIMIT:");
+    out.print(scope);
+    out.print(",");
+    out.print(b.perSecond);
+    out.print(",");
+    out.print(b.burst);
+    out.print(",");
+    out.println(busy);
+}
+
+// Parse "<a>,<b>" into two numbers of at most max
+static bool parsePair(const char* p, unsigned long max, unsigned long* a, unsigned long* b) {
+    char* end;
+    *a = strtoul(p, &end, 10);
+    if (end == p || *end != ',' || *a > max) return false;
+    p = end + 1;
+    *b = strtoul(p, &end, 10);
+    return end != p && *end == '\0' && *b <= max;
+}
+
+void handleLimitATCommand(const char* cmd) {
+    if (strcmp(cmd, "AT+LIMIT?") == 0) {
+        // +LIMIT:BUDGET,<bytes>,<lines>,<byte hits>,<line hits>
+        // +LIMIT:AT|SHELL|"<command>",<per second>,<burst>,<busy>
+        Print& out = beginATInfo();
+        out.print("+LIMIT:BUDGET,");
+        out.print((unsigned long)maxBytes);
+        out.print(",");
+        out.print((unsigned long)maxLines);
+        out.print(",");
+        out.print(limitStats.byteBudgetHits);
+        out.print(",");
+        out.println(limitStats.lineBudgetHits);
+        sendLimitInfo("AT", atBucket, limitStats.atBusy);
+        sendLimitInfo("SHELL", shellBucket, limitStats.shellBusy);
+
+        for (const CommandLimit& limit : commandLimits) {
+            if (limit.bucket.perSecond == 0) continue;
+            char scope[sizeof(limit.name) + 2];
+            scope[0] = '"';
+            strcpy(scope + 1, limit.name);
+            strcat(scope, "\"");
+            sendLimitInfo(scope, limit.bucket, limit.busy);
+        }
+        sendATResult(AT_RESULT_OK);
+        return;
+    }
+
+    if (strcmp(cmd, "AT+LIMIT=0") == 0) {
+        resetInputLimitStats();
+        sendATResult(AT_RESULT_OK);
+        return;
+    }
+
+    bool ok = false;
+    unsigned long a, b;
+    if (strncmp(cmd, "AT+LIMIT=BUDGET,", 16) == 0) {
+        ok = parsePair(cmd + 16, ULONG_MAX, &a, &b);
+        if (ok) setInputBudget(a, b);
+    }
+    else if (strncmp(cmd, "AT+LIMIT=AT,", 12) == 0) {
+        ok = parsePair(cmd + 12, UINT16_MAX, &a, &b);
+        if (ok) setATRateLimit(a, b);
+    }
+    else if (strncmp(cmd, "AT+LIMIT=SHELL,", 15) == 0) {
+        ok = parsePair(cmd + 15, UINT16_MAX, &a, &b);
+        if (ok) setShellRateLimit(a, b);
+    }
+    else if (strncmp(cmd, "AT+LIMIT=\"", 10) == 0) {
+        // AT+LIMIT="<command>",<per second>,<burst>
+        const char* name = cmd + 10;
+        const char* quote = strchr(name, '"');
+        char command[AT_COMMAND_NAME_LEN + 3];
+        size_t len = quote ? quote - name : 0;
+        if (len > 0 && len < sizeof(command) && quote[1] == ',') {
+            memcpy(command, name, len);
+            command[len] = '\0';
+            ok = parsePair(quote + 2, UINT16_MAX, &a, &b) && setCommandRateLimit(command, a, b);
+        }
+    }
+    sendATResult(ok ? AT_RESULT_OK : AT_RESULT_ERROR);
+}
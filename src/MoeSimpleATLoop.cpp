@@ -0,0 +1,222 @@
+/**
+ * MoeSimpleATLoop.cpp - Main loop latency monitor
+ *
+ * handleATCommands() stamps its start and end with micros(): the time from
+ * one start to the next is the loop interval, the time to the end is what
+ * the library itself took. Both go into histograms, and the calls that
+ * took longest are kept together with the command that ran longest in
+ * them. Dispatch hooks in the interpreter provide the command lines.
+ * Idle light sleep (servicePower()) is taken out of both: the chip was
+ * waiting on purpose, which is neither work nor a stall.
+ */
+
+#include "MoeSimpleATInternal.h"
+
+// Upper bucket edges in ms; the last bucket takes everything longer
+static const uint16_t histEdgesMs[AT_LOOP_HIST_BUCKETS - 1] = { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+
+static LoopStats loopStats;
+static uint64_t intervalSumUs = 0;
+static uint64_t busySumUs = 0;
+
+static uint32_t warnMs = AT_LOOP_WARN_MS;
+
+static bool callSeen = false;
+static unsigned long callStartUs = 0;
+static uint32_t callIntervalUs = 0;
+static uint32_t lastBusyUs = 0;
+static uint32_t callSleepUs = 0;
+
+// Longest command of the current call
+static char callCommand[AT_LOOP_WORST_LINE_LEN];
+static uint32_t callCommandUs = 0;
+
+// Command being dispatched (nested commands count towards the outer one)
+static char dispatchLine[AT_LOOP_WORST_LINE_LEN];
+static unsigned long dispatchStartUs = 0;
+static uint8_t dispatchDepth = 0;
+
+static void countInBucket(uint32_t* hist, uint32_t us) {
+    size_t i = 0;
+    while (i < AT_LOOP_HIST_BUCKETS - 1 && us >= histEdgesMs[i] * 1000UL) i++;
+    hist[i]++;
+}
+
+static void postLoopWarning(uint32_t intervalUs, uint32_t busyUs, const char* command) {
+    // +LOOPWARN:<interval ms>,<busy ms>,"<command>"
+    char line[AT_URC_LINE_LEN + 1];
+    char number[24];
+    size_t len = appendText(line, sizeof(line), 0, "+LOOPWARN:");
+    formatNumber(number, sizeof(number), intervalUs / 1000);
+    len = appendText(line, sizeof(line), len, number);
+    len = appendText(line, sizeof(line), len, ",");
+    formatNumber(number, sizeof(number), busyUs / 1000);
+    len = appendText(line, sizeof(line), len, number);
+    len = appendText(line, sizeof(line), len, ",\"");
+    len = appendText(line, sizeof(line), len, command);
+    appendText(line, sizeof(line), len, "\"");
+    loopStats.warnings++;
+    postURC(line, URC_NORMAL);
+}
+
+// ----------------------------
+// Hooks
+// ----------------------------
+
+void beginLoopMonitor() {
+    unsigned long now = micros();
+    callIntervalUs = 0;
+    if (callSeen) {
+        // The previous call's sleep is part of the time since it started
+        callIntervalUs = now - callStartUs - callSleepUs;
+        intervalSumUs += callIntervalUs;
+        if (callIntervalUs > loopStats.maxIntervalUs) loopStats.maxIntervalUs = callIntervalUs;
+        countInBucket(loopStats.intervalHist, callIntervalUs);
+    }
+    callSeen = true;
+    callStartUs = now;
+    callSleepUs = 0;
+    callCommand[0] = '\0';
+    callCommandUs = 0;
+}
+
+void endLoopMonitor() {
+    uint32_t busyUs = micros() - callStartUs - callSleepUs;
+    loopStats.calls++;
+    busySumUs += busyUs;
+    if (busyUs > loopStats.maxBusyUs) loopStats.maxBusyUs = busyUs;
+    countInBucket(loopStats.busyHist, busyUs);
+
+    // Keep the worst calls sorted, longest first
+    for (size_t i = 0; i < AT_LOOP_WORST; i++) {
+        if (busyUs <= loopStats.worst[i].busyUs) continue;
+        memmove(&loopStats.worst[i + 1], &loopStats.worst[i], (AT_LOOP_WORST - 1 - i) * sizeof(LoopOffender));
+        loopStats.worst[i].busyUs = busyUs;
+        strcpy(loopStats.worst[i].command, callCommand);
+        break;
+    }
+
+    // Warn about our own stall, or about the sketch's part of the interval; the
+    // previous call's processing time was reported with that call already
+    uint64_t warnUs = (uint64_t)warnMs * 1000;
+    if (warnUs > 0) {
+        if (busyUs >= warnUs) {
+            postLoopWarning(callIntervalUs, busyUs, callCommand);
+        }
+        else if (callIntervalUs >= warnUs && callIntervalUs - lastBusyUs >= warnUs) {
+            postLoopWarning(callIntervalUs, busyUs, "");
+        }
+    }
+    lastBusyUs = busyUs;
+}
+
+void noteLoopSleep(uint32_t us) {
+    callSleepUs += us;
+}
+
+void loopDispatchBegin(const char* line) {
+    if (dispatchDepth++ > 0) return;
+    appendText(dispatchLine, sizeof(dispatchLine), 0, line);
+    dispatchStartUs = micros();
+}
+
+void loopDispatchEnd() {
+    if (dispatchDepth == 0 || --dispatchDepth > 0) return;
+    uint32_t us = micros() - dispatchStartUs;
+    if (us >= callCommandUs) {
+        callCommandUs = us;
+        strcpy(callCommand, dispatchLine);
+    }
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+LoopStats getLoopStats() {
+    LoopStats s = loopStats;
+    uint32_t intervals = s.calls > 1 ? s.calls - 1 : 0;
+    s.avgIntervalUs = intervals ? (uint32_t)(intervalSumUs / intervals) : 0;
+    s.avgBusyUs = s.calls ? (uint32_t)(busySumUs / s.calls) : 0;
+    return s;
+}
+
+void resetLoopStats() {
+    loopStats = LoopStats();
+    intervalSumUs = 0;
+    busySumUs = 0;
+    // The running call is measured from its start; the next interval starts fresh
+    callSeen = false;
+}
+
+void setLoopWarning(uint32_t thresholdMs) {
+    warnMs = thresholdMs;
+}
+
+// ----------------------------
+// AT: AT+LOOPSTAT
+// ----------------------------
+
+static void printHistogram(Print& out, const char* name, const uint32_t* hist) {
+    out.print("+LOOPHIST:");
+    out.print(name);
+    for (size_t i = 0; i < AT_LOOP_HIST_BUCKETS; i++) {
+        out.print(",");
+        out.print(hist[i]);
+    }
+    out.println();
+}
+
+void handleLoopStatATCommand(const char* cmd) {
+    if (strcmp(cmd, "AT+LOOPSTAT?") == 0) {
+        // +LOOPSTAT:<calls>,<avg interval us>,<max interval us>,<avg busy us>,<max busy us>,<warn ms>,<warnings>
+        // +LOOPHIST:INTERVAL|BUSY,<count per bucket>
+        // +LOOPWORST:<busy us>,"<command>"
+        LoopStats s = getLoopStats();
+        Print& out = beginATInfo();
+        out.print("+LOOPSTAT:");
+        out.print(s.calls);
+        out.print(",");
+        out.print(s.avgIntervalUs);
+        out.print(",");
+        out.print(s.maxIntervalUs);
+        out.print(",");
+        out.print(s.avgBusyUs);
+        out.print(",");
+        out.print(s.maxBusyUs);
+        out.print(",");
+        out.print(warnMs);
+        out.print(",");
+        out.println(s.warnings);
+        printHistogram(out, "INTERVAL", s.intervalHist);
+        printHistogram(out, "BUSY", s.busyHist);
+        for (const LoopOffender& o : s.worst) {
+            if (o.busyUs == 0) break;
+            out.print("+LOOPWORST:");
+            out.print(o.busyUs);
+            out.print(",\"");
+            out.print(o.command);
+            out.println("\"");
+        }
+        sendATResult(AT_RESULT_OK);
+        return;
+    }
+
+    if (strcmp(cmd, "AT+LOOPSTAT=0") == 0) {
+        resetLoopStats();
+        sendATResult(AT_RESULT_OK);
+        return;
+    }
+
+    // AT+LOOPSTAT=WARN,<ms>
+    if (strncmp(cmd, "AT+LOOPSTAT=WARN,", 17) == 0) {
+        char* end;
+        unsigned long ms = strtoul(cmd + 17, &end, 10);
+        if (end != cmd + 17 && *end == '\0') {
+            setLoopWarning(ms);
+            sendATResult(AT_RESULT_OK);
+            return;
+        }
+    }
+    sendATResult(AT_RESULT_ERROR);
+}
@@ -0,0 +1,206 @@
+/**
+ * MoeSimpleATPower.cpp - Idle light sleep policy
+ *
+ * The policy only decides when and how long to sleep; the platform calls
+ * are behind PowerHooks so it can run against a simulated clock.
+ */
+
+#include "MoeSimpleATInternal.h"
+
+#if defined(ESP32)
+    #include <esp_sleep.h>
+    #include <driver/uart.h>
+#endif
+
+// ----------------------------
+// Platform hooks
+// ----------------------------
+
+#if defined(ESP32)
+
+class ESP32PowerHooks : public PowerHooks {
+public:
+    bool lightSleep(unsigned long maxMs) override {
+        // The edges of the first received byte(s) wake the chip
+        uart_set_wakeup_threshold((uart_port_t)AT_IDLE_UART_NUM, 3);
+        esp_sleep_enable_uart_wakeup(AT_IDLE_UART_NUM);
+        esp_sleep_enable_timer_wakeup((uint64_t)maxMs * 1000);
+        esp_light_sleep_start();
+        return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UART;
+    }
+};
+
+static ESP32PowerHooks platformHooks;
+static PowerHooks* defaultPowerHooks() { return &platformHooks; }
+
+#elif defined(ESP8266)
+
+class ESP8266PowerHooks : public PowerHooks {
+public:
+    bool lightSleep(unsigned long maxMs) override {
+        // Forced light sleep would turn the radio off and lose the waking
+        // bytes. delay() lets the SDK enter automatic light sleep instead
+        // (WiFi.setSleepMode(WIFI_LIGHT_SLEEP)) while RX keeps working.
+        unsigned long start = millis();
+        while (millis() - start < maxMs) {
+            if (atSerial->available()) return true;
+            delay(1);
+        }
+        return false;
+    }
+};
+
+static ESP8266PowerHooks platformHooks;
+static PowerHooks* defaultPowerHooks() { return &platformHooks; }
+
+#else
+
+static PowerHooks* defaultPowerHooks() { return nullptr; }
+
+#endif
+
+// ----------------------------
+// Policy
+// ----------------------------
+
+static PowerHooks* powerHooks = nullptr;
+static bool powerHooksSet = false;
+static unsigned long idleTimeoutMs = AT_IDLE_TIMEOUT_MS;
+static unsigned long latencyBudgetMs = AT_IDLE_LATENCY_MS;
+static unsigned long lastActivityMs = 0;
+static unsigned long uartWakeMs = 0;
+static bool awaitingFirstByte = false;
+static PowerStats powerStats = { 0, 0, 0, 0, 0 };
+
+static PowerHooks* activeHooks() {
+    if (!powerHooksSet) {
+        powerHooks = defaultPowerHooks();
+        powerHooksSet = true;
+    }
+    return powerHooks;
+}
+
+// Latency from a UART wakeup to the first byte the interpreter can read
+static bool checkFirstByte(unsigned long now) {
+    bool rx = atSerial->available() > 0;
+    if (rx && awaitingFirstByte) {
+        powerStats.lastLatencyMs = now - uartWakeMs;
+        if (powerStats.lastLatencyMs > powerStats.maxLatencyMs) {
+            powerStats.maxLatencyMs = powerStats.lastLatencyMs;
+        }
+        awaitingFirstByte = false;
+    }
+    return rx;
+}
+
+void servicePower() {
+    PowerHooks* hooks = activeHooks();
+    if (!hooks || idleTimeoutMs == 0 || !atSerial) return;
+
+    unsigned long now = hooks->now();
+    bool rx = checkFirstByte(now);
+
+    // Stay awake while the host is talking, output is still queued or
+    // network clients may connect (light sleep stops the Wi-Fi modem)
+    if (rx || isCMUXActive() || getURCStats().pending > 0 || tcpServerActive()) {
+        lastActivityMs = now;
+        return;
+    }
+    if (now - lastActivityMs < idleTimeoutMs) return;
+
+    unsigned long sleepMs = latencyBudgetMs;
+    unsigned long jobMs = schedulerIdleMs();
+    if (jobMs < sleepMs) sleepMs = jobMs;
+    unsigned long scriptMs = scriptIdleMs();
+    if (scriptMs < sleepMs) sleepMs = scriptMs;
+    if (sleepMs < AT_IDLE_MIN_SLEEP_MS) return;
+
+    atOutput->flush();  // The UART clock stops: drain TX first
+    unsigned long sleepStartUs = micros();
+    bool uart = hooks->lightSleep(sleepMs);
+    noteLoopSleep(micros() - sleepStartUs);
+    unsigned long woke = hooks->now();
+
+    powerStats.sleeps++;
+    powerStats.asleepMs += woke - now;
+    awaitingFirstByte = false;
+    if (uart) {
+        // Stay awake for a full idle period to receive what woke us
+        powerStats.uartWakes++;
+        uartWakeMs = woke;
+        lastActivityMs = woke;
+        awaitingFirstByte = true;
+        checkFirstByte(woke);
+    }
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+void setIdlePolicy(unsigned long idleMs, unsigned long budgetMs) {
+    idleTimeoutMs = idleMs;
+    latencyBudgetMs = budgetMs;
+    PowerHooks* hooks = activeHooks();
+    lastActivityMs = hooks ? hooks->now() : 0;
+}
+
+void setPowerHooks(PowerHooks* hooks) {
+    powerHooks = hooks ? hooks : defaultPowerHooks();
+    powerHooksSet = true;
+    lastActivityMs = powerHooks ? powerHooks->now() : 0;
+}
+
+PowerStats getPowerStats() {
+    return powerStats;
+}
+
+// ----------------------------
+// AT: AT+IDLE
+// ----------------------------
+
+void handleIdleATCommand(const char* cmd) {
+    if (strcmp(cmd, "AT+IDLE?") == 0) {
+        Print& out = beginATInfo();
+        out.print("+IDLE:");
+        out.print(idleTimeoutMs);
+        out.print(",");
+        out.print(latencyBudgetMs);
+        out.print(",");
+        out.print(powerStats.sleeps);
+        out.print(",");
+        out.print(powerStats.asleepMs);
+        out.print(",");
+        out.print(powerStats.uartWakes);
+        out.print(",");
+        out.print(powerStats.lastLatencyMs);
+        out.print(",");
+        out.println(powerStats.maxLatencyMs);
+        sendATResult(AT_RESULT_OK);
+    }
+    else if (strncmp(cmd, "AT+IDLE=", 8) == 0) {
+        // AT+IDLE=<idle_ms>[,<budget_ms>]
+        char* end;
+        long idleMs = strtol(cmd + 8, &end, 10);
+        long budgetMs = latencyBudgetMs;
+        if (end != cmd + 8 && *end == ',') {
+            const char* budget = end + 1;
+            budgetMs = strtol(budget, &end, 10);
+            if (end == budget) budgetMs = -1;
+        }
+        if (end == cmd + 8 || *end != '\0' || idleMs < 0 || budgetMs < AT_IDLE_MIN_SLEEP_MS) {
+            sendATResult(AT_RESULT_ERROR);
+            return;
+        }
+        if (idleMs > 0 && !activeHooks()) {
+            // No way to sleep on this board
+            sendATResult(AT_RESULT_ERROR);
+            return;
+        }
+        setIdlePolicy(idleMs, budgetMs);
+        sendATResult(AT_RESULT_OK);
+    }
+    else {
+        sendATResult(AT_RESULT_ERROR);
+    }
+}
@@ -0,0 +1,432 @@
+/**
+ * MoeSimpleATScheduler.cpp - Timer wheel scheduler for periodic commands
+ *
+ * Jobs live in a fixed table and are threaded onto a hashed timer wheel
+ * (intrusive doubly linked lists, one per slot). Scheduling and cancelling
+ * touch a single list; every tick only visits the jobs hashed to one slot.
+ * Periods longer than one wheel revolution are handled with a round counter.
+ */
+
+#include <limits.h>
+#include "MoeSimpleATInternal.h"
+
+static_assert(AT_SCHED_MAX_JOBS > 0 && AT_SCHED_MAX_JOBS <= 127, "AT_SCHED_MAX_JOBS must be 1..127");
+static_assert(AT_SCHED_WHEEL_SLOTS > 0, "AT_SCHED_WHEEL_SLOTS must be positive");
+static_assert(AT_SCHED_TICK_MS > 0, "AT_SCHED_TICK_MS must be positive");
+
+// ----------------------------
+// Job table
+// ----------------------------
+
+static const int8_t SLOT_NONE = -1;    // Job is on the free list
+static const int8_t SLOT_FIRING = -2;  // Job is on the list of the slot being fired
+
+struct SchedJob {
+    int8_t next;
+    int8_t prev;
+    int16_t slot;             // Wheel slot, SLOT_NONE or SLOT_FIRING
+    bool active;
+    ScheduledJobKind kind;
+    uint16_t generation;      // Bumped on every reuse so stale IDs never match
+    uint32_t periodTicks;
+    uint32_t rounds;          // Full wheel revolutions left before firing
+    char command[AT_SCHED_CMD_LEN];
+};
+
+static SchedJob jobs[AT_SCHED_MAX_JOBS];
+static int8_t wheel[AT_SCHED_WHEEL_SLOTS];
+static int8_t freeHead = -1;
+static int8_t firingHead = -1;
+static uint32_t cursor = 0;          // Slot processed by the most recent tick
+static unsigned long lastTickMs = 0;
+static bool schedInitialized = false;
+static bool schedFiring = false;
+
+static void ensureSchedInit() {
+    if (schedInitialized) return;
+    for (int i = 0; i < AT_SCHED_WHEEL_SLOTS; i++) {
+        wheel[i] = -1;
+    }
+    for (int i = AT_SCHED_MAX_JOBS - 1; i >= 0; i--) {
+        jobs[i].active = false;
+        jobs[i].slot = SLOT_NONE;
+        jobs[i].prev = -1;
+        jobs[i].next = freeHead;
+        freeHead = i;
+    }
+    lastTickMs = millis();
+    schedInitialized = true;
+}
+
+// ----------------------------
+// Intrusive list helpers
+// ----------------------------
+
+static int8_t* listOf(int8_t j) {
+    if (jobs[j].slot >= 0) return &wheel[jobs[j].slot];
+    if (jobs[j].slot == SLOT_FIRING) return &firingHead;
+    return &freeHead;
+}
+
+static void listPush(int8_t* head, int8_t j) {
+    jobs[j].prev = -1;
+    jobs[j].next = *head;
+    if (*head >= 0) jobs[*head].prev = j;
+    *head = j;
+}
+
+static void listUnlink(int8_t* head, int8_t j) {
+    if (jobs[j].prev >= 0) jobs[jobs[j].prev].next = jobs[j].next;
+    else *head = jobs[j].next;
+    if (jobs[j].next >= 0) jobs[jobs[j].next].prev = jobs[j].prev;
+    jobs[j].prev = jobs[j].next = -1;
+}
+
+// Hash a job onto the wheel so it fires delayTicks ticks after the cursor
+static void armJob(int8_t j, uint32_t delayTicks) {
+    if (delayTicks == 0) delayTicks = 1;
+    jobs[j].slot = (cursor + delayTicks % AT_SCHED_WHEEL_SLOTS) % AT_SCHED_WHEEL_SLOTS;
+    jobs[j].rounds = (delayTicks - 1) / AT_SCHED_WHEEL_SLOTS;
+    listPush(&wheel[jobs[j].slot], j);
+}
+
+static int jobId(int8_t j) {
+    return (int)jobs[j].generation * AT_SCHED_MAX_JOBS + j + 1;
+}
+
+static int8_t jobIndex(int id) {
+    if (id <= 0) return -1;
+    int8_t j = (id - 1) % AT_SCHED_MAX_JOBS;
+    if (!jobs[j].active || jobId(j) != id) return -1;
+    return j;
+}
+
+// ----------------------------
+// Firing
+// ----------------------------
+
+static void fireJob(int8_t j) {
+    // Copy first: the command may cancel or replace its own job
+    char line[AT_SCHED_CMD_LEN];
+    memcpy(line, jobs[j].command, sizeof(line));
+    ScheduledJobKind kind = jobs[j].kind;
+
+    bool shell = inShellMode;
+    if (shell) {
+        atOutput->println();  // Break the pending prompt line
+    }
+
+    schedFiring = true;
+    if (kind == JOB_SHELL) {
+        processShellCommand(line);
+    } else {
+        processATCommand(line);
+    }
+    schedFiring = false;
+
+    if (shell) {
+        redrawShellPrompt();
+    }
+}
+
+static void processSlot(uint32_t slot) {
+    // Detach the slot so re-armed jobs landing on it wait a full revolution
+    firingHead = wheel[slot];
+    wheel[slot] = -1;
+    for (int8_t j = firingHead; j >= 0; j = jobs[j].next) {
+        jobs[j].slot = SLOT_FIRING;
+    }
+
+    while (firingHead >= 0) {
+        int8_t j = firingHead;
+        listUnlink(&firingHead, j);
+        if (jobs[j].rounds > 0) {
+            jobs[j].rounds--;
+            jobs[j].slot = slot;
+            listPush(&wheel[slot], j);
+            continue;
+        }
+        armJob(j, jobs[j].periodTicks);
+        fireJob(j);
+    }
+}
+
+void serviceScheduler() {
+    ensureSchedInit();
+
+    unsigned long now = millis();
+    unsigned long ticks = (now - lastTickMs) / AT_SCHED_TICK_MS;
+    if (ticks == 0) return;
+
+    if (ticks > AT_SCHED_WHEEL_SLOTS) {
+        // The loop stalled for more than a revolution: fire each due job once
+        // and drop the backlog instead of replaying every missed period.
+        ticks = AT_SCHED_WHEEL_SLOTS;
+        lastTickMs = now;
+    } else {
+        lastTickMs += ticks * AT_SCHED_TICK_MS;
+    }
+
+    while (ticks--) {
+        cursor = (cursor + 1) % AT_SCHED_WHEEL_SLOTS;
+        processSlot(cursor);
+    }
+}
+
+unsigned long schedulerIdleMs() {
+    ensureSchedInit();
+
+    uint32_t ticks = 0xFFFFFFFFUL;
+    for (int8_t j = 0; j < AT_SCHED_MAX_JOBS; j++) {
+        if (!jobs[j].active || jobs[j].slot < 0) continue;
+        uint32_t distance = (jobs[j].slot + AT_SCHED_WHEEL_SLOTS - cursor) % AT_SCHED_WHEEL_SLOTS;
+        if (distance == 0) distance = AT_SCHED_WHEEL_SLOTS;
+        distance += jobs[j].rounds * AT_SCHED_WHEEL_SLOTS;
+        if (distance < ticks) ticks = distance;
+    }
+    if (ticks == 0xFFFFFFFFUL) return ULONG_MAX;
+
+    unsigned long elapsed = millis() - lastTickMs;
+    unsigned long due = ticks * AT_SCHED_TICK_MS;
+    return due > elapsed ? due - elapsed : 0;
+}
+
+bool isSchedulerFiring() {
+    return schedFiring;
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+int scheduleCommand(ScheduledJobKind kind, const char* cmdLine, unsigned long periodMs) {
+    ensureSchedInit();
+
+    // Trimmed in place of a copy
+    if (!cmdLine) return -1;
+    while (*cmdLine == ' ' || *cmdLine == '\t') cmdLine++;
+    size_t len = strlen(cmdLine);
+    while (len > 0 && isspace((unsigned char)cmdLine[len - 1])) len--;
+    if (len == 0 || len >= AT_SCHED_CMD_LEN || freeHead < 0) {
+        return -1;
+    }
+
+    int8_t j = freeHead;
+    listUnlink(&freeHead, j);
+    jobs[j].active = true;
+    jobs[j].kind = kind;
+    jobs[j].periodTicks = (periodMs + AT_SCHED_TICK_MS - 1) / AT_SCHED_TICK_MS;
+    if (jobs[j].periodTicks == 0) jobs[j].periodTicks = 1;
+    memcpy(jobs[j].command, cmdLine, len);
+    jobs[j].command[len] = '\0';
+    armJob(j, jobs[j].periodTicks);
+    return jobId(j);
+}
+
+int scheduleCommand(ScheduledJobKind kind, const String& cmdLine, unsigned long periodMs) {
+    return scheduleCommand(kind, cmdLine.c_str(), periodMs);
+}
+
+bool cancelScheduledCommand(int id) {
+    ensureSchedInit();
+
+    int8_t j = jobIndex(id);
+    if (j < 0) return false;
+
+    listUnlink(listOf(j), j);
+    jobs[j].active = false;
+    jobs[j].generation++;
+    jobs[j].slot = SLOT_NONE;
+    listPush(&freeHead, j);
+    return true;
+}
+
+size_t listScheduledCommands(const std::function<void(const ScheduledJobInfo& job)>& callback) {
+    ensureSchedInit();
+
+    size_t count = 0;
+    for (int8_t j = 0; j < AT_SCHED_MAX_JOBS; j++) {
+        if (!jobs[j].active) continue;
+        ScheduledJobInfo info = {
+            jobId(j), jobs[j].kind, jobs[j].periodTicks * AT_SCHED_TICK_MS, jobs[j].command
+        };
+        if (callback) callback(info);
+        count++;
+    }
+    return count;
+}
+
+// ----------------------------
+// Shell: watch
+// ----------------------------
+
+// Join words back into a command line, quoting those that would not split the same again
+static bool joinShellArgs(char* line, size_t size, int argc, char* argv[]) {
+    size_t len = 0;
+    bool fits = true;
+    auto put = [&](char c) {
+        if (len + 1 < size) line[len++] = c;
+        else fits = false;
+    };
+
+    for (int i = 0; i < argc; i++) {
+        const char* arg = argv[i];
+        bool quote = (*arg == '\0') || strpbrk(arg, " \t'\"\\") != nullptr;
+
+        if (i > 0) put(' ');
+        if (quote) put('"');
+        for (; *arg; arg++) {
+            if (*arg == '"' || *arg == '\\') put('\\');
+            put(*arg);
+        }
+        if (quote) put('"');
+    }
+    line[fits ? len : 0] = '\0';
+    return fits;
+}
+
+// True if line is an AT command ("AT", "AT+...", "AT&...", or settings such as "ATE0")
+// rather than a shell command that happens to start with "at"
+static bool isATCommandLine(const char* line) {
+    if (strncasecmp(line, "AT", 2) != 0) return false;
+    const char* p = line + 2;
+    if (*p == '\0' || *p == '+' || *p == '&') return true;
+    while (*p) {
+        if (!strchr("EVQevq", *p)) return false;
+        p++;
+        if (isdigit((unsigned char)*p)) p++;
+    }
+    return true;
+}
+
+static void printWatchUsage() {
+    atOutput->println("usage: watch [-n sec] <command> | watch -c <id> | watch");
+}
+
+void handleWatchCommand(int argc, char* argv[], void*) {
+    // No arguments: list jobs
+    if (argc == 1) {
+        size_t n = listScheduledCommands([](const ScheduledJobInfo& job) {
+            atOutput->print("[");
+            atOutput->print(job.id);
+            atOutput->print("] every ");
+            atOutput->print(job.periodMs);
+            atOutput->print(" ms ");
+            atOutput->print(job.kind == JOB_SHELL ? "(shell): " : "(AT): ");
+            atOutput->println(job.command);
+        });
+        if (n == 0) {
+            atOutput->println("watch: no jobs");
+        }
+        return;
+    }
+
+    // watch -c <id>: cancel
+    if (strncmp(argv[1], "-c", 2) == 0) {
+        const char* id = argv[1][2] ? argv[1] + 2 : (argc > 2 ? argv[2] : "");
+        if (!cancelScheduledCommand(atoi(id))) {
+            atOutput->println("watch: no such job");
+        }
+        return;
+    }
+
+    // watch [-n sec] <command>
+    unsigned long periodMs = 2000;
+    int first = 1;
+    if (strcmp(argv[1], "-n") == 0) {
+        if (argc < 4) {
+            printWatchUsage();
+            return;
+        }
+        float sec = atof(argv[2]);
+        periodMs = (sec > 0) ? (unsigned long)(sec * 1000) : AT_SCHED_TICK_MS;
+        first = 3;
+    }
+
+    if (strcmp(argv[first], "watch") == 0) {
+        atOutput->println("watch: cannot watch itself");
+        return;
+    }
+
+    char line[AT_SCHED_CMD_LEN];
+    int id = -1;
+    if (joinShellArgs(line, sizeof(line), argc - first, argv + first)) {
+        ScheduledJobKind kind = isATCommandLine(line) ? JOB_AT : JOB_SHELL;
+        id = scheduleCommand(kind, line, periodMs);
+    }
+    if (id < 0) {
+        atOutput->println("watch: job table full or command too long");
+        return;
+    }
+    atOutput->print("[");
+    atOutput->print(id);
+    atOutput->print("] every ");
+    atOutput->print(periodMs);
+    atOutput->print(" ms: ");
+    atOutput->println(line);
+}
+
+// ----------------------------
+// AT: AT+SCHED
+// ----------------------------
+
+static void sendSchedInfo(const ScheduledJobInfo& job) {
+    Print& out = beginATInfo();
+    out.print("+SCHED:");
+    out.print(job.id);
+    out.print(",");
+    out.print(job.periodMs);
+    out.print(job.kind == JOB_SHELL ? ",SHELL,\"" : ",AT,\"");
+    out.print(job.command);
+    out.println("\"");
+}
+
+void handleSchedATCommand(const char* cmd) {
+    if (strcmp(cmd, "AT+SCHED?") == 0) {
+        listScheduledCommands(sendSchedInfo);
+        sendATResult(AT_RESULT_OK);
+    }
+    else if (strncmp(cmd, "AT+SCHED=", 9) == 0) {
+        // AT+SCHED=<period_ms>,<AT command>
+        const char* params = cmd + 9;
+        const char* comma = strchr(params, ',');
+        long periodMs = comma ? strtol(params, nullptr, 10) : 0;
+
+        // The command, trimmed and without enclosing quotes
+        char line[AT_SCHED_CMD_LEN];
+        size_t len = 0;
+        if (comma) {
+            const char* start = comma + 1;
+            while (*start == ' ') start++;
+            len = strlen(start);
+            while (len > 0 && start[len - 1] == ' ') len--;
+            if (len >= 2 && start[0] == '"' && start[len - 1] == '"') {
+                start++;
+                len -= 2;
+            }
+            if (len >= sizeof(line)) len = 0;
+            memcpy(line, start, len);
+        }
+        line[len] = '\0';
+
+        int id = -1;
+        if (periodMs > 0 && strncmp(line, "AT", 2) == 0 && strncmp(line, "AT+SCHED", 8) != 0 && !isSchedulerFiring()) {
+            id = scheduleCommand(JOB_AT, line, periodMs);
+        }
+        if (id < 0) {
+            sendATResult(AT_RESULT_ERROR);
+            return;
+        }
+        Print& out = beginATInfo();
+        out.print("+SCHED:");
+        out.println(id);
+        sendATResult(AT_RESULT_OK);
+    }
+    else if (strncmp(cmd, "AT+SCHEDDEL=", 12) == 0) {
+        int id = atoi(cmd + 12);
+        sendATResult(cancelScheduledCommand(id) ? AT_RESULT_OK : AT_RESULT_ERROR);
+    }
+    else {
+        sendATResult(AT_RESULT_ERROR);
+    }
+}
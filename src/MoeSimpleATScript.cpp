@@ -0,0 +1,860 @@
+/**
+ * MoeSimpleATScript.cpp - msh scripting: compiler and bytecode interpreter
+ *
+ * A script is compiled once into a fixed code buffer and then executed a
+ * slice at a time from handleATCommands(), so loops and sleeps never block
+ * loop(). Everything is statically sized: AT_SCRIPT_CODE_LEN bytes of code,
+ * AT_SCRIPT_VARS variables and an evaluation stack of AT_SCRIPT_STACK
+ * entries, whose depth the compiler checks so the interpreter does not have to.
+ *
+ * Saved scripts are kept in the settings store as one blob of
+ * "name\0source\0" pairs, split over the keys SETTING_SCRIPTS .. SETTING_USER - 1.
+ */
+
+#include <limits.h>
+#include "MoeSimpleATInternal.h"
+
+static_assert(AT_SCRIPT_CODE_LEN >= 16 && AT_SCRIPT_CODE_LEN <= 65535, "AT_SCRIPT_CODE_LEN must be 16..65535");
+static_assert(AT_SCRIPT_VARS >= 1 && AT_SCRIPT_VARS <= 255, "AT_SCRIPT_VARS must be 1..255");
+static_assert(AT_SCRIPT_STACK >= 2, "AT_SCRIPT_STACK must be at least 2");
+
+// ----------------------------
+// Bytecode
+// ----------------------------
+
+enum ScriptOp : uint8_t {
+    OP_END = 0,
+    OP_PUSH8,      // int8 operand
+    OP_PUSH32,     // int32 operand, little endian
+    OP_LOAD,       // variable slot
+    OP_STORE,      // variable slot
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+    OP_EQ, OP_NE, OP_LT, OP_GT, OP_LE, OP_GE,
+    OP_AND, OP_OR, OP_NEG, OP_NOT,
+    OP_JMP,        // uint16 target
+    OP_JZ,         // uint16 target, pops the condition
+    OP_SLEEP,      // pops milliseconds
+    OP_SHELL,      // uint8 length + command text
+    OP_AT          // uint8 length + command text
+};
+
+// In command text: VAR_MARK followed by a slot is replaced by the value
+static const uint8_t VAR_MARK = 0x01;
+
+// Variable slot 0 holds the numeric result code of the last AT command
+static const uint8_t VAR_RC = 0;
+
+struct ScriptProgram {
+    uint8_t code[AT_SCRIPT_CODE_LEN];
+    size_t codeLen;
+    char varNames[AT_SCRIPT_VARS][AT_SCRIPT_VAR_NAME_LEN];
+    uint8_t varCount;
+};
+
+// ----------------------------
+// Compiler
+// ----------------------------
+
+enum BlockKind : uint8_t { BLOCK_IF, BLOCK_ELSE, BLOCK_WHILE };
+
+struct ScriptBlock {
+    BlockKind kind;
+    uint16_t patch;      // Operand of the forward jump to fix at else / end
+    uint16_t loop;       // Start of the while condition
+};
+
+struct ScriptCompiler {
+    ScriptProgram& p;
+    const char* s;       // Cursor in the current statement
+    uint8_t depth;       // Evaluation stack depth at the cursor
+    uint8_t parens;
+    const char* error;
+};
+
+static void emit(ScriptCompiler& c, uint8_t b) {
+    if (c.error) return;
+    if (c.p.codeLen >= AT_SCRIPT_CODE_LEN) {
+        c.error = "script too long";
+        return;
+    }
+    c.p.code[c.p.codeLen++] = b;
+}
+
+static void emit16(ScriptCompiler& c, uint16_t v) {
+    emit(c, v & 0xFF);
+    emit(c, v >> 8);
+}
+
+static void patch16(ScriptCompiler& c, uint16_t at, uint16_t v) {
+    if (c.error) return;
+    c.p.code[at] = v & 0xFF;
+    c.p.code[at + 1] = v >> 8;
+}
+
+static void pushed(ScriptCompiler& c) {
+    if (++c.depth > AT_SCRIPT_STACK && !c.error) c.error = "expression too complex";
+}
+
+static void skipSpaces(ScriptCompiler& c) {
+    while (*c.s == ' ' || *c.s == '\t') c.s++;
+}
+
+static bool isNameStart(char ch) {
+    return isalpha((unsigned char)ch) || ch == '_';
+}
+
+static bool isNameChar(char ch) {
+    return isalnum((unsigned char)ch) || ch == '_';
+}
+
+static int findVar(const ScriptProgram& p, const char* name) {
+    for (uint8_t i = 0; i < p.varCount; i++) {
+        if (strcmp(p.varNames[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+// Read a name at the cursor and return its slot, adding the variable if new
+static uint8_t parseVar(ScriptCompiler& c) {
+    char name[AT_SCRIPT_VAR_NAME_LEN];
+    size_t n = 0;
+    while (isNameChar(*c.s)) {
+        if (n >= sizeof(name) - 1) {
+            if (!c.error) c.error = "name too long";
+            return 0;
+        }
+        name[n++] = *c.s++;
+    }
+    name[n] = '\0';
+
+    int slot = findVar(c.p, name);
+    if (slot >= 0) return slot;
+    if (c.p.varCount >= AT_SCRIPT_VARS) {
+        if (!c.error) c.error = "too many variables";
+        return 0;
+    }
+    strcpy(c.p.varNames[c.p.varCount], name);
+    return c.p.varCount++;
+}
+
+static void parseExpr(ScriptCompiler& c);
+
+static void parsePrimary(ScriptCompiler& c) {
+    skipSpaces(c);
+    if (isdigit((unsigned char)*c.s)) {
+        char* end;
+        long v = strtol(c.s, &end, 10);
+        c.s = end;
+        if (v >= -128 && v <= 127) {
+            emit(c, OP_PUSH8);
+            emit(c, (uint8_t)(int8_t)v);
+        } else {
+            emit(c, OP_PUSH32);
+            for (uint8_t i = 0; i < 4; i++) emit(c, ((uint32_t)v >> (8 * i)) & 0xFF);
+        }
+        pushed(c);
+    }
+    else if (isNameStart(*c.s)) {
+        uint8_t slot = parseVar(c);
+        emit(c, OP_LOAD);
+        emit(c, slot);
+        pushed(c);
+    }
+    else if (*c.s == '(') {
+        if (++c.parens > AT_SCRIPT_STACK) {
+            if (!c.error) c.error = "expression too complex";
+            return;
+        }
+        c.s++;
+        parseExpr(c);
+        skipSpaces(c);
+        if (*c.s != ')') {
+            if (!c.error) c.error = "missing )";
+            return;
+        }
+        c.s++;
+        c.parens--;
+    }
+    else if (!c.error) {
+        c.error = "syntax error";
+    }
+}
+
+static void parseUnary(ScriptCompiler& c) {
+    skipSpaces(c);
+    if (*c.s == '-' || (*c.s == '!' && c.s[1] != '=')) {
+        uint8_t op = (*c.s == '-') ? OP_NEG : OP_NOT;
+        c.s++;
+        parseUnary(c);
+        emit(c, op);
+        return;
+    }
+    parsePrimary(c);
+}
+
+struct ScriptOperator {
+    const char* token;
+    uint8_t level;       // Higher binds tighter
+    uint8_t op;
+};
+
+// Two-character tokens first so "<=" is not read as "<"
+static const ScriptOperator scriptOperators[] = {
+    { "||", 0, OP_OR }, { "&&", 1, OP_AND },
+    { "==", 2, OP_EQ }, { "!=", 2, OP_NE }, { "<=", 2, OP_LE }, { ">=", 2, OP_GE },
+    { "<", 2, OP_LT }, { ">", 2, OP_GT },
+    { "+", 3, OP_ADD }, { "-", 3, OP_SUB },
+    { "*", 4, OP_MUL }, { "/", 4, OP_DIV }, { "%", 4, OP_MOD }
+};
+
+static void parseBinary(ScriptCompiler& c, uint8_t level) {
+    if (level > 4) {
+        parseUnary(c);
+        return;
+    }
+    parseBinary(c, level + 1);
+    while (!c.error) {
+        skipSpaces(c);
+        const ScriptOperator* match = nullptr;
+        for (const ScriptOperator& o : scriptOperators) {
+            if (o.level == level && strncmp(c.s, o.token, strlen(o.token)) == 0) {
+                match = &o;
+                break;
+            }
+        }
+        if (!match) return;
+        c.s += strlen(match->token);
+        parseBinary(c, level + 1);
+        emit(c, match->op);
+        c.depth--;
+    }
+}
+
+static void parseExpr(ScriptCompiler& c) {
+    parseBinary(c, 0);
+}
+
+// Compile an expression that must fill the rest of the statement
+static void compileCondition(ScriptCompiler& c) {
+    parseExpr(c);
+    skipSpaces(c);
+    if (*c.s && !c.error) c.error = "unexpected text after expression";
+    c.depth = 0;
+}
+
+// Statement starting with a keyword; returns the text after it or nullptr
+static const char* keyword(const char* stmt, const char* word) {
+    size_t n = strlen(word);
+    if (strncmp(stmt, word, n) != 0 || (stmt[n] != '\0' && stmt[n] != ' ' && stmt[n] != '\t')) return nullptr;
+    return stmt + n;
+}
+
+static void compileCommand(ScriptCompiler& c, const char* line) {
+    bool at = (line[0] == 'A' || line[0] == 'a') && (line[1] == 'T' || line[1] == 't');
+    emit(c, at ? OP_AT : OP_SHELL);
+    size_t lenAt = c.p.codeLen;
+    emit(c, 0);
+
+    size_t len = 0;
+    for (c.s = line; *c.s && !c.error; ) {
+        if (*c.s == '$' && isNameStart(c.s[1])) {
+            c.s++;
+            uint8_t slot = parseVar(c);
+            emit(c, VAR_MARK);
+            emit(c, slot);
+            len += 2;
+        }
+        else {
+            if ((uint8_t)*c.s != VAR_MARK) {
+                emit(c, *c.s);
+                len++;
+            }
+            c.s++;
+        }
+    }
+    if (len > 255 && !c.error) c.error = "command too long";
+    if (!c.error) c.p.code[lenAt] = (uint8_t)len;
+}
+
+/**
+ * @brief Compile a script into p.
+ *
+ * @param line Receives the number of the failing line
+ * @return nullptr on success, otherwise the error message
+ */
+static const char* compileScript(ScriptProgram& p, const char* source, size_t* line) {
+    p.codeLen = 0;
+    p.varCount = 1;
+    strcpy(p.varNames[VAR_RC], "rc");
+
+    ScriptCompiler c = { p, nullptr, 0, 0, nullptr };
+    ScriptBlock blocks[AT_SCRIPT_NEST];
+    uint8_t nest = 0;
+    size_t current = 1;
+
+    const char* s = source;
+    while (*s && !c.error) {
+        *line = current;
+
+        // Cut the next statement at ';' or a line break
+        char stmt[AT_LINE_LEN];
+        size_t n = 0;
+        while (*s == ' ' || *s == '\t') s++;
+        while (*s && *s != ';' && *s != '\n' && *s != '\r') {
+            if (n >= sizeof(stmt) - 1) {
+                c.error = "line too long";
+                break;
+            }
+            stmt[n++] = *s++;
+        }
+        while (n > 0 && (stmt[n - 1] == ' ' || stmt[n - 1] == '\t')) n--;
+        stmt[n] = '\0';
+        if (*s == '\n') current++;
+        if (*s) s++;
+        if (c.error) break;
+        if (n == 0 || stmt[0] == '#') continue;
+
+        const char* rest;
+        if ((rest = keyword(stmt, "let")) != nullptr) {
+            c.s = rest;
+            skipSpaces(c);
+            if (!isNameStart(*c.s)) {
+                c.error = "let: missing name";
+                break;
+            }
+            uint8_t slot = parseVar(c);
+            skipSpaces(c);
+            if (*c.s != '=' || c.s[1] == '=') {
+                c.error = "let: missing =";
+                break;
+            }
+            c.s++;
+            compileCondition(c);
+            emit(c, OP_STORE);
+            emit(c, slot);
+        }
+        else if ((rest = keyword(stmt, "if")) != nullptr || (rest = keyword(stmt, "while")) != nullptr) {
+            if (nest >= AT_SCRIPT_NEST) {
+                c.error = "nested too deep";
+                break;
+            }
+            bool loop = stmt[0] == 'w';
+            ScriptBlock& b = blocks[nest++];
+            b.kind = loop ? BLOCK_WHILE : BLOCK_IF;
+            b.loop = c.p.codeLen;
+            c.s = rest;
+            compileCondition(c);
+            emit(c, OP_JZ);
+            b.patch = c.p.codeLen;
+            emit16(c, 0);
+        }
+        else if (keyword(stmt, "else")) {
+            if (nest == 0 || blocks[nest - 1].kind != BLOCK_IF || stmt[4]) {
+                c.error = stmt[4] ? "else: unexpected text" : "else without if";
+                break;
+            }
+            ScriptBlock& b = blocks[nest - 1];
+            emit(c, OP_JMP);
+            uint16_t jump = c.p.codeLen;
+            emit16(c, 0);
+            patch16(c, b.patch, c.p.codeLen);
+            b.kind = BLOCK_ELSE;
+            b.patch = jump;
+        }
+        else if (keyword(stmt, "end")) {
+            if (nest == 0 || stmt[3]) {
+                c.error = stmt[3] ? "end: unexpected text" : "end without if / while";
+                break;
+            }
+            ScriptBlock& b = blocks[--nest];
+            if (b.kind == BLOCK_WHILE) {
+                emit(c, OP_JMP);
+                emit16(c, b.loop);
+            }
+            patch16(c, b.patch, c.p.codeLen);
+        }
+        else if ((rest = keyword(stmt, "sleep")) != nullptr) {
+            c.s = rest;
+            compileCondition(c);
+            emit(c, OP_SLEEP);
+        }
+        else {
+            compileCommand(c, stmt);
+        }
+    }
+
+    if (!c.error && nest > 0) c.error = "missing end";
+    emit(c, OP_END);
+    return c.error;
+}
+
+// ----------------------------
+// Interpreter
+// ----------------------------
+
+static ScriptProgram program;
+static int32_t vars[AT_SCRIPT_VARS];
+static int32_t stack[AT_SCRIPT_STACK];
+static char runningName[AT_COMMAND_NAME_LEN];
+static bool scriptRunning = false;
+static bool scriptSleeping = false;
+static bool autoexecChecked = false;
+static bool promptBroken = false;     // Script output started below the shell prompt
+static size_t pc = 0;
+static uint8_t sp = 0;
+static unsigned long wakeMs = 0;
+static ScriptStats scriptStats;
+
+static uint16_t read16(size_t at) {
+    return program.code[at] | (program.code[at + 1] << 8);
+}
+
+static void printScriptError(const char* name, const char* msg) {
+    atOutput->print("script: ");
+    atOutput->print(name);
+    atOutput->print(": ");
+    atOutput->println(msg);
+}
+
+// Start script output on a fresh line instead of after "msh> "
+static void breakPrompt() {
+    if (inShellMode && !promptBroken) {
+        atOutput->println();
+        promptBroken = true;
+    }
+}
+
+static void scriptError(const char* msg) {
+    breakPrompt();
+    printScriptError(runningName, msg);
+    scriptRunning = false;
+    scriptStats.errors++;
+}
+
+// Replace the variable marks of a command with decimal values
+static bool expandCommand(const uint8_t* text, size_t len, char* out, size_t outLen) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] != VAR_MARK) {
+            if (n + 1 >= outLen) return false;
+            out[n++] = text[i];
+            continue;
+        }
+        int32_t v = vars[text[++i]];
+        char digits[11];
+        uint8_t d = 0;
+        uint32_t u = v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+        do {
+            digits[d++] = '0' + u % 10;
+            u /= 10;
+        } while (u);
+        if (n + d + (v < 0 ? 1 : 0) >= outLen) return false;
+        if (v < 0) out[n++] = '-';
+        while (d) out[n++] = digits[--d];
+    }
+    out[n] = '\0';
+    return true;
+}
+
+static int32_t arith(uint8_t op, int32_t a, int32_t b) {
+    // Wrap on overflow instead of undefined behaviour
+    switch (op) {
+        case OP_ADD: return (int32_t)((uint32_t)a + (uint32_t)b);
+        case OP_SUB: return (int32_t)((uint32_t)a - (uint32_t)b);
+        case OP_MUL: return (int32_t)((uint32_t)a * (uint32_t)b);
+        case OP_DIV: return b == -1 ? (int32_t)(0u - (uint32_t)a) : a / b;
+        case OP_MOD: return b == -1 ? 0 : a % b;
+        case OP_EQ: return a == b;
+        case OP_NE: return a != b;
+        case OP_LT: return a < b;
+        case OP_GT: return a > b;
+        case OP_LE: return a <= b;
+        case OP_GE: return a >= b;
+        case OP_AND: return a && b;
+        default: return a || b;  // OP_OR
+    }
+}
+
+unsigned long scriptIdleMs() {
+    if (!scriptRunning) return ULONG_MAX;
+    if (!scriptSleeping) return 0;
+    long left = (long)(wakeMs - millis());
+    return left > 0 ? (unsigned long)left : 0;
+}
+
+void serviceScript() {
+    if (!autoexecChecked) {
+        // Deferred to the first loop so setup() can still register scripts
+        autoexecChecked = true;
+        runScript("autoexec");
+    }
+    if (!scriptRunning) return;
+    if (scriptSleeping) {
+        if ((long)(millis() - wakeMs) < 0) return;
+        scriptSleeping = false;
+    }
+
+    bool yield = false;
+    for (uint16_t budget = AT_SCRIPT_SLICE_OPS; budget > 0 && scriptRunning && !yield; budget--) {
+        uint8_t op = program.code[pc++];
+        scriptStats.ops++;
+
+        switch (op) {
+            case OP_END:
+                scriptRunning = false;
+                break;
+            case OP_PUSH8:
+                stack[sp++] = (int8_t)program.code[pc++];
+                break;
+            case OP_PUSH32: {
+                uint32_t v = 0;
+                for (uint8_t i = 0; i < 4; i++) v |= (uint32_t)program.code[pc + i] << (8 * i);
+                stack[sp++] = (int32_t)v;
+                pc += 4;
+                break;
+            }
+            case OP_LOAD:
+                stack[sp++] = vars[program.code[pc++]];
+                break;
+            case OP_STORE:
+                vars[program.code[pc++]] = stack[--sp];
+                break;
+            case OP_NEG:
+                stack[sp - 1] = (int32_t)(0u - (uint32_t)stack[sp - 1]);
+                break;
+            case OP_NOT:
+                stack[sp - 1] = !stack[sp - 1];
+                break;
+            case OP_JMP:
+                pc = read16(pc);
+                break;
+            case OP_JZ:
+                pc = stack[--sp] ? pc + 2 : read16(pc);
+                break;
+            case OP_SLEEP: {
+                int32_t ms = stack[--sp];
+                wakeMs = millis() + (ms > 0 ? ms : 0);
+                scriptSleeping = true;
+                yield = true;
+                break;
+            }
+            case OP_SHELL:
+            case OP_AT: {
+                size_t len = program.code[pc++];
+                char line[AT_LINE_LEN];
+                bool fits = expandCommand(program.code + pc, len, line, sizeof(line));
+                pc += len;
+                if (!fits) {
+                    scriptError("command too long");
+                    break;
+                }
+                breakPrompt();
+                scriptStats.commands++;
+                if (op == OP_AT) {
+                    processATCommand(line);
+                    vars[VAR_RC] = lastATResultCode();
+                } else {
+                    processShellCommand(line);
+                }
+                // Give the rest of loop() a turn after every command
+                yield = true;
+                break;
+            }
+            default: {
+                if (op < OP_ADD || op > OP_OR) {
+                    scriptError("bad bytecode");
+                    break;
+                }
+                int32_t b = stack[--sp];
+                int32_t a = stack[sp - 1];
+                if ((op == OP_DIV || op == OP_MOD) && b == 0) {
+                    scriptError("division by zero");
+                    break;
+                }
+                stack[sp - 1] = arith(op, a, b);
+                break;
+            }
+        }
+    }
+
+    // Give the prompt back while the script waits or once it is done
+    if (promptBroken && (scriptSleeping || !scriptRunning)) {
+        promptBroken = false;
+        if (inShellMode) redrawShellPrompt();
+    }
+}
+
+// ----------------------------
+// Script sources
+// ----------------------------
+
+struct RegisteredScript {
+    const char* name;
+    const char* source;
+};
+
+static RegisteredScript registeredScripts[AT_SCRIPT_MAX_REGISTERED];
+static size_t registeredCount = 0;
+
+static const size_t STORE_LEN = (SETTING_USER - SETTING_SCRIPTS) * AT_SETTINGS_MAX_VALUE;
+
+// Concatenate the stored chunks into buf (STORE_LEN + 1 bytes)
+static size_t loadStore(char* buf) {
+    size_t len = 0;
+    if (getSettingsStats().mounted) {
+        for (uint8_t key = SETTING_SCRIPTS; key < SETTING_USER; key++) {
+            int n = settingsRead(key, buf + len, AT_SETTINGS_MAX_VALUE);
+            if (n <= 0) break;
+            len += n;
+        }
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static bool saveStore(const char* buf, size_t len) {
+    if (!getSettingsStats().mounted) return false;
+    for (uint8_t key = SETTING_SCRIPTS; key < SETTING_USER; key++) {
+        size_t offset = (key - SETTING_SCRIPTS) * AT_SETTINGS_MAX_VALUE;
+        if (offset < len) {
+            size_t n = len - offset < AT_SETTINGS_MAX_VALUE ? len - offset : AT_SETTINGS_MAX_VALUE;
+            if (!settingsWrite(key, buf + offset, n)) return false;
+        }
+        else if (!settingsRemove(key)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Find a saved script: returns the offset of its name, or -1
+static long findStored(const char* buf, size_t len, const char* name, const char** source) {
+    size_t i = 0;
+    while (i < len && buf[i]) {
+        const char* entry = buf + i;
+        const char* src = entry + strlen(entry) + 1;
+        if ((size_t)(src - buf) >= len) break;  // Truncated blob
+        if (strcmp(entry, name) == 0) {
+            if (source) *source = src;
+            return i;
+        }
+        i = (src - buf) + strlen(src) + 1;
+    }
+    return -1;
+}
+
+static const char* findRegistered(const char* name) {
+    for (size_t i = 0; i < registeredCount; i++) {
+        if (strcmp(registeredScripts[i].name, name) == 0) return registeredScripts[i].source;
+    }
+    return nullptr;
+}
+
+// Saved scripts override registered ones of the same name
+static const char* lookupScript(const char* name, char* store) {
+    size_t len = loadStore(store);
+    const char* source = nullptr;
+    if (findStored(store, len, name, &source) < 0) {
+        source = findRegistered(name);
+    }
+    return source;
+}
+
+static bool startScript(const char* name, const char* source) {
+    size_t line;
+    const char* error = compileScript(program, source, &line);
+    if (error) {
+        atOutput->print("script: ");
+        atOutput->print(name);
+        atOutput->print(": line ");
+        atOutput->print((unsigned long)line);
+        atOutput->print(": ");
+        atOutput->println(error);
+        scriptStats.errors++;
+        return false;
+    }
+
+    memset(vars, 0, sizeof(vars));
+    strncpy(runningName, name, sizeof(runningName) - 1);
+    runningName[sizeof(runningName) - 1] = '\0';
+    pc = 0;
+    sp = 0;
+    scriptSleeping = false;
+    scriptRunning = true;
+    scriptStats.runs++;
+    return true;
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+bool registerScript(const char* name, const char* source) {
+    if (!name || !source || strlen(name) >= AT_COMMAND_NAME_LEN) return false;
+    for (size_t i = 0; i < registeredCount; i++) {
+        if (strcmp(registeredScripts[i].name, name) == 0) {
+            registeredScripts[i].source = source;
+            return true;
+        }
+    }
+    if (registeredCount >= AT_SCRIPT_MAX_REGISTERED) return false;
+    registeredScripts[registeredCount++] = { name, source };
+    return true;
+}
+
+bool runScript(const char* name) {
+    if (scriptRunning) return false;
+    char store[STORE_LEN + 1];
+    const char* source = lookupScript(name, store);
+    return source && startScript(name, source);
+}
+
+void stopScript() {
+    scriptRunning = false;
+}
+
+bool isScriptRunning() {
+    return scriptRunning;
+}
+
+bool setScriptVar(const char* name, long value) {
+    if (!scriptRunning) return false;
+    int slot = findVar(program, name);
+    if (slot < 0) return false;
+    vars[slot] = value;
+    return true;
+}
+
+bool getScriptVar(const char* name, long* value) {
+    if (!scriptRunning) return false;
+    int slot = findVar(program, name);
+    if (slot < 0) return false;
+    if (value) *value = vars[slot];
+    return true;
+}
+
+ScriptStats getScriptStats() {
+    return scriptStats;
+}
+
+// ----------------------------
+// Shell: run, script
+// ----------------------------
+
+void handleRunCommand(const char* args) {
+    if (strcmp(args, "-k") == 0) {
+        if (!scriptRunning) atOutput->println("run: no script running");
+        stopScript();
+        return;
+    }
+    if (*args == '\0') {
+        if (scriptRunning) {
+            atOutput->print("running: ");
+            atOutput->println(runningName);
+        } else {
+            atOutput->println("run: no script running");
+        }
+        return;
+    }
+    if (scriptRunning) {
+        atOutput->print("run: busy with ");
+        atOutput->println(runningName);
+        return;
+    }
+    char store[STORE_LEN + 1];
+    const char* source = lookupScript(args, store);
+    if (!source) {
+        atOutput->println("run: no such script");
+        return;
+    }
+    startScript(args, source);
+}
+
+void handleScriptCommand(const char* args) {
+    char store[STORE_LEN + 1];
+    size_t len = loadStore(store);
+
+    // No arguments: list
+    if (*args == '\0') {
+        size_t i = 0;
+        while (i < len && store[i]) {
+            const char* name = store + i;
+            const char* src = name + strlen(name) + 1;
+            if ((size_t)(src - store) >= len) break;
+            atOutput->print(name);
+            atOutput->print("  (saved, ");
+            atOutput->print((unsigned long)strlen(src));
+            atOutput->println(" bytes)");
+            i = (src - store) + strlen(src) + 1;
+        }
+        for (size_t r = 0; r < registeredCount; r++) {
+            if (findStored(store, len, registeredScripts[r].name, nullptr) >= 0) continue;
+            atOutput->print(registeredScripts[r].name);
+            atOutput->println("  (built-in)");
+        }
+        atOutput->print((unsigned long)len);
+        atOutput->print(" of ");
+        atOutput->print((unsigned long)STORE_LEN);
+        atOutput->println(" bytes of script storage used");
+        return;
+    }
+
+    bool remove = strncmp(args, "-d ", 3) == 0;
+    if (remove) args += 3;
+
+    char name[AT_COMMAND_NAME_LEN];
+    size_t n = 0;
+    while (*args && *args != ' ') {
+        if (n >= sizeof(name) - 1) {
+            atOutput->println("script: name too long");
+            return;
+        }
+        name[n++] = *args++;
+    }
+    name[n] = '\0';
+    while (*args == ' ') args++;
+
+    const char* source = nullptr;
+    long at = findStored(store, len, name, &source);
+
+    // script <name>: show the source
+    if (!remove && *args == '\0') {
+        if (!source) source = findRegistered(name);
+        if (source) atOutput->println(source);
+        else atOutput->println("script: no such script");
+        return;
+    }
+
+    // Drop the old entry (if any), then append the new one
+    if (at >= 0) {
+        size_t entryLen = (source - (store + at)) + strlen(source) + 1;
+        memmove(store + at, store + at + entryLen, len - at - entryLen);
+        len -= entryLen;
+    }
+    else if (remove) {
+        atOutput->println("script: no such script");
+        return;
+    }
+
+    if (!remove) {
+        ScriptProgram check;
+        size_t line;
+        const char* error = compileScript(check, args, &line);
+        if (error) {
+            printScriptError(name, error);
+            return;
+        }
+        size_t srcLen = strlen(args);
+        if (len + n + srcLen + 2 > STORE_LEN) {
+            atOutput->println("script: storage full");
+            return;
+        }
+        memcpy(store + len, name, n + 1);
+        memcpy(store + len + n + 1, args, srcLen + 1);
+        len += n + srcLen + 2;
+    }
+
+    if (!saveStore(store, len)) {
+        atOutput->println("script: cannot write settings");
+    }
+}
@@ -0,0 +1,388 @@
+/**
+ * MoeSimpleATSettings.cpp - Wear-levelled key/value settings store
+ *
+ * Sector layout: header { magic, sequence } followed by records
+ * { key, length, crc, state } + value padded to 4 bytes. A record is
+ * programmed with state 0xFF and committed by rewriting its header with
+ * RECORD_VALID, so a write cut by a reset is skipped on the next mount.
+ * Sectors are used in ring order; the sequence number orders them.
+ */
+
+#include "MoeSimpleATInternal.h"
+
+#if defined(ESP32)
+    #include <esp_partition.h>
+#endif
+
+static_assert(AT_SETTINGS_MAX_KEYS > 0 && AT_SETTINGS_MAX_KEYS <= 240, "AT_SETTINGS_MAX_KEYS must be 1..240");
+static_assert(AT_SETTINGS_MAX_VALUE > 0 && AT_SETTINGS_MAX_VALUE <= 255, "AT_SETTINGS_MAX_VALUE must be 1..255");
+
+static const uint32_t SECTOR_MAGIC = 0x5441534DUL;  // "MSAT"
+static const uint8_t KEY_ERASED = 0xFF;
+static const uint8_t KEY_CLEAR = 0xFE;              // Drops every older record
+static const uint8_t RECORD_VALID = 0x5A;
+
+struct SectorHeader {
+    uint32_t magic;
+    uint32_t sequence;
+};
+
+// Aligned like every buffer handed to SettingsFlash (the ESP8266 SDK reads
+// and writes through uint32_t pointers)
+struct alignas(4) RecordHeader {
+    uint8_t key;
+    uint8_t length;      // 0 deletes the key
+    uint8_t crc;
+    uint8_t state;       // 0xFF while being written, RECORD_VALID once complete
+};
+
+static SettingsFlash* settingsFlash = nullptr;
+static bool settingsMounted = false;
+static uint32_t settingsIndex[AT_SETTINGS_MAX_KEYS];  // Record address per key, 0 = no value
+static uint8_t settingsSectors = 0;                   // Sectors in use (at most 255)
+static uint8_t activeSector = 0;
+static uint32_t activeSequence = 0;
+static uint32_t writePos = 0;                         // Offset in the active sector
+static uint32_t settingsWrites = 0;
+static uint32_t settingsErases = 0;
+
+static constexpr size_t align4(size_t n) {
+    return (n + 3) & ~(size_t)3;
+}
+
+static uint8_t recordCRC(uint8_t key, const uint8_t* data, uint8_t len) {
+    uint8_t crc = 0xFF;
+    uint8_t head[2] = { key, len };
+    for (size_t i = 0; i < 2u + len; i++) {
+        crc ^= (i < 2) ? head[i] : data[i - 2];
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// ----------------------------
+// Platform backends
+// ----------------------------
+
+#if defined(ESP32)
+
+class PartitionSettingsFlash : public SettingsFlash {
+public:
+    explicit PartitionSettingsFlash(const esp_partition_t* p) : part(p) {}
+    size_t sectorSize() const override { return SPI_FLASH_SEC_SIZE; }
+    size_t sectorCount() const override { return part->size / SPI_FLASH_SEC_SIZE; }
+    bool read(uint32_t addr, void* data, size_t len) override {
+        return esp_partition_read(part, addr, data, len) == ESP_OK;
+    }
+    bool write(uint32_t addr, const void* data, size_t len) override {
+        return esp_partition_write(part, addr, data, len) == ESP_OK;
+    }
+    bool eraseSector(size_t sector) override {
+        return esp_partition_erase_range(part, sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE) == ESP_OK;
+    }
+private:
+    const esp_partition_t* part;
+};
+
+static SettingsFlash* defaultSettingsFlash() {
+    static PartitionSettingsFlash* flash = nullptr;
+    if (!flash) {
+        const esp_partition_t* p = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                            ESP_PARTITION_SUBTYPE_ANY, AT_SETTINGS_PARTITION);
+        if (!p) return nullptr;
+        static PartitionSettingsFlash instance(p);
+        flash = &instance;
+    }
+    return flash;
+}
+
+#elif defined(ESP8266) && defined(AT_SETTINGS_FLASH_ADDR)
+
+class RawSettingsFlash : public SettingsFlash {
+public:
+    size_t sectorSize() const override { return SPI_FLASH_SEC_SIZE; }
+    size_t sectorCount() const override { return AT_SETTINGS_SECTORS; }
+    bool read(uint32_t addr, void* data, size_t len) override {
+        return ESP.flashRead(AT_SETTINGS_FLASH_ADDR + addr, (uint32_t*)data, len);
+    }
+    bool write(uint32_t addr, const void* data, size_t len) override {
+        return ESP.flashWrite(AT_SETTINGS_FLASH_ADDR + addr, (uint32_t*)data, len);
+    }
+    bool eraseSector(size_t sector) override {
+        return ESP.flashEraseSector(AT_SETTINGS_FLASH_ADDR / SPI_FLASH_SEC_SIZE + sector);
+    }
+};
+
+static SettingsFlash* defaultSettingsFlash() {
+    static RawSettingsFlash flash;
+    return &flash;
+}
+
+#else
+
+static SettingsFlash* defaultSettingsFlash() {
+    return nullptr;
+}
+
+#endif
+
+// ----------------------------
+// Log helpers
+// ----------------------------
+
+static uint32_t sectorBase(uint8_t sector) {
+    return (uint32_t)sector * settingsFlash->sectorSize();
+}
+
+static bool readSectorHeader(uint8_t sector, SectorHeader& h) {
+    return settingsFlash->read(sectorBase(sector), &h, sizeof(h)) && h.magic == SECTOR_MAGIC;
+}
+
+static bool eraseSettingsSector(uint8_t sector) {
+    settingsErases++;
+    return settingsFlash->eraseSector(sector);
+}
+
+static bool openSector(uint8_t sector, uint32_t sequence) {
+    SectorHeader h = { SECTOR_MAGIC, sequence };
+    if (!settingsFlash->write(sectorBase(sector), &h, sizeof(h))) return false;
+    activeSector = sector;
+    activeSequence = sequence;
+    writePos = sizeof(SectorHeader);
+    return true;
+}
+
+static bool sectorIsBlank(uint8_t sector) {
+    uint32_t words[8];
+    for (uint32_t off = 0; off < settingsFlash->sectorSize(); off += sizeof(words)) {
+        if (!settingsFlash->read(sectorBase(sector) + off, words, sizeof(words))) return false;
+        for (uint32_t w : words) {
+            if (w != 0xFFFFFFFFUL) return false;
+        }
+    }
+    return true;
+}
+
+// Program one record into the active sector (the caller checked the space)
+static bool programRecord(uint8_t key, const uint8_t* data, uint8_t len) {
+    alignas(4) uint8_t buf[sizeof(RecordHeader) + align4(AT_SETTINGS_MAX_VALUE)];
+    size_t total = sizeof(RecordHeader) + align4(len);
+    RecordHeader* h = (RecordHeader*)buf;
+    h->key = key;
+    h->length = len;
+    h->crc = recordCRC(key, data, len);
+    h->state = 0xFF;
+    memset(buf + sizeof(RecordHeader), 0xFF, total - sizeof(RecordHeader));
+    if (len) memcpy(buf + sizeof(RecordHeader), data, len);
+
+    uint32_t addr = sectorBase(activeSector) + writePos;
+    if (!settingsFlash->write(addr, buf, total)) return false;
+    h->state = RECORD_VALID;
+    if (!settingsFlash->write(addr, h, sizeof(RecordHeader))) return false;
+
+    writePos += total;
+    settingsWrites++;
+    if (key < AT_SETTINGS_MAX_KEYS) {
+        settingsIndex[key] = len ? addr : 0;
+    }
+    return true;
+}
+
+// Move the live records of a sector into the active one, then erase it
+static bool reclaimSector(uint8_t sector) {
+    uint32_t begin = sectorBase(sector);
+    uint32_t end = begin + settingsFlash->sectorSize();
+    for (uint8_t key = 0; key < AT_SETTINGS_MAX_KEYS; key++) {
+        uint32_t addr = settingsIndex[key];
+        if (addr == 0 || addr < begin || addr >= end) continue;
+
+        alignas(4) uint8_t buf[sizeof(RecordHeader) + align4(AT_SETTINGS_MAX_VALUE)];
+        RecordHeader* h = (RecordHeader*)buf;
+        if (!settingsFlash->read(addr, buf, sizeof(RecordHeader))) return false;
+        if (!settingsFlash->read(addr + sizeof(RecordHeader), buf + sizeof(RecordHeader), align4(h->length))) return false;
+        if (!programRecord(key, buf + sizeof(RecordHeader), h->length)) return false;
+    }
+    return eraseSettingsSector(sector);
+}
+
+// Continue in the next (erased) sector and reclaim the oldest one
+static bool advanceSector() {
+    uint8_t count = settingsSectors;
+    uint8_t next = (activeSector + 1) % count;
+    if (!openSector(next, activeSequence + 1)) return false;
+
+    uint8_t oldest = (next + 1) % count;
+    SectorHeader h;
+    if (readSectorHeader(oldest, h)) {
+        return reclaimSector(oldest);
+    }
+    return true;
+}
+
+static bool appendRecord(uint8_t key, const uint8_t* data, uint8_t len) {
+    if (!settingsMounted) return false;
+    if (writePos + sizeof(RecordHeader) + align4(len) > settingsFlash->sectorSize()) {
+        if (!advanceSector()) return false;
+    }
+    return programRecord(key, data, len);
+}
+
+// Rebuild the RAM index from one sector; returns the end of its records
+static uint32_t replaySector(uint8_t sector) {
+    uint32_t base = sectorBase(sector);
+    uint32_t pos = sizeof(SectorHeader);
+    while (pos + sizeof(RecordHeader) <= settingsFlash->sectorSize()) {
+        RecordHeader h;
+        if (!settingsFlash->read(base + pos, &h, sizeof(h))) break;
+        if (h.key == KEY_ERASED) break;
+
+        uint32_t total = sizeof(RecordHeader) + align4(h.length);
+        if (pos + total > settingsFlash->sectorSize()) break;
+
+        alignas(4) uint8_t data[align4(AT_SETTINGS_MAX_VALUE)];
+        bool valid = h.state == RECORD_VALID && h.length <= AT_SETTINGS_MAX_VALUE
+                     && settingsFlash->read(base + pos + sizeof(RecordHeader), data, align4(h.length))
+                     && h.crc == recordCRC(h.key, data, h.length);
+        if (valid) {
+            if (h.key == KEY_CLEAR) {
+                memset(settingsIndex, 0, sizeof(settingsIndex));
+            }
+            else if (h.key < AT_SETTINGS_MAX_KEYS) {
+                settingsIndex[h.key] = h.length ? base + pos : 0;
+            }
+        }
+        pos += total;
+    }
+    return pos;
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+bool beginSettings(SettingsFlash* flash) {
+    if (!flash) flash = defaultSettingsFlash();
+    if (!flash) return false;
+
+    // Every live value must fit in one sector next to a new record
+    size_t worst = sizeof(SectorHeader)
+                   + (AT_SETTINGS_MAX_KEYS + 2) * (sizeof(RecordHeader) + align4(AT_SETTINGS_MAX_VALUE));
+    if (flash->sectorCount() < 2 || flash->sectorSize() < worst) {
+        return false;
+    }
+
+    // Sector numbers are one byte: a larger region is only used in part
+    size_t sectors = flash->sectorCount();
+    if (sectors > 255) {
+        char line[64];
+        char number[12];
+        strcpy(line, "settings: using 255 of ");
+        formatNumber(number, sizeof(number), (long)sectors);
+        strcat(line, number);
+        strcat(line, " sectors");
+        log(line);
+        sectors = 255;
+    }
+
+    settingsFlash = flash;
+    settingsMounted = false;
+    memset(settingsIndex, 0, sizeof(settingsIndex));
+    settingsSectors = sectors;
+    uint8_t count = settingsSectors;
+
+    // Replay the valid sectors in sequence order
+    bool found = false;
+    uint32_t last = 0;
+    while (true) {
+        int sector = -1;
+        uint32_t best = 0;
+        for (uint8_t s = 0; s < count; s++) {
+            SectorHeader h;
+            if (readSectorHeader(s, h) && (!found || h.sequence > last) && (sector < 0 || h.sequence < best)) {
+                sector = s;
+                best = h.sequence;
+            }
+        }
+        if (sector < 0) break;
+        activeSector = sector;
+        activeSequence = best;
+        writePos = replaySector(sector);
+        last = best;
+        found = true;
+    }
+
+    if (!found) {
+        // Blank or foreign content: format once
+        for (uint8_t s = 0; s < count; s++) {
+            if (!sectorIsBlank(s) && !eraseSettingsSector(s)) return false;
+        }
+        if (!openSector(0, 1)) return false;
+    }
+    else {
+        // A reset during advanceSector() can leave the sector after the
+        // active one unreclaimed or half erased: finish the job
+        uint8_t next = (activeSector + 1) % count;
+        SectorHeader h;
+        if (readSectorHeader(next, h)) {
+            if (!reclaimSector(next)) return false;
+        }
+        else if (!sectorIsBlank(next) && !eraseSettingsSector(next)) {
+            return false;
+        }
+    }
+
+    settingsMounted = true;
+    return true;
+}
+
+bool settingsWrite(uint8_t key, const void* data, size_t len) {
+    if (!settingsMounted || key >= AT_SETTINGS_MAX_KEYS || !data || len == 0 || len > AT_SETTINGS_MAX_VALUE) {
+        return false;
+    }
+
+    // Rewriting the current value costs no flash cycle
+    uint8_t current[AT_SETTINGS_MAX_VALUE];
+    if (settingsRead(key, current, sizeof(current)) == (int)len && memcmp(current, data, len) == 0) {
+        return true;
+    }
+    return appendRecord(key, (const uint8_t*)data, len);
+}
+
+int settingsRead(uint8_t key, void* data, size_t maxLen) {
+    if (!settingsMounted || key >= AT_SETTINGS_MAX_KEYS || settingsIndex[key] == 0) return -1;
+
+    alignas(4) uint8_t buf[sizeof(RecordHeader) + align4(AT_SETTINGS_MAX_VALUE)];
+    RecordHeader* h = (RecordHeader*)buf;
+    uint32_t addr = settingsIndex[key];
+    if (!settingsFlash->read(addr, buf, sizeof(RecordHeader))) return -1;
+    if (!settingsFlash->read(addr + sizeof(RecordHeader), buf + sizeof(RecordHeader), align4(h->length))) return -1;
+
+    memcpy(data, buf + sizeof(RecordHeader), h->length < maxLen ? h->length : maxLen);
+    return h->length;
+}
+
+bool settingsRemove(uint8_t key) {
+    if (!settingsMounted || key >= AT_SETTINGS_MAX_KEYS) return false;
+    if (settingsIndex[key] == 0) return true;
+    return appendRecord(key, nullptr, 0);
+}
+
+bool settingsClear() {
+    if (!settingsMounted) return false;
+    if (!appendRecord(KEY_CLEAR, nullptr, 0)) return false;
+    memset(settingsIndex, 0, sizeof(settingsIndex));
+    return true;
+}
+
+SettingsStats getSettingsStats() {
+    SettingsStats stats = { settingsMounted, 0, activeSector, 0, settingsWrites, settingsErases };
+    if (settingsMounted) {
+        stats.freeBytes = settingsFlash->sectorSize() - writePos;
+        for (uint8_t key = 0; key < AT_SETTINGS_MAX_KEYS; key++) {
+            if (settingsIndex[key]) stats.liveKeys++;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,116 @@
+/**
+ * MoeSimpleATSettings.h - Flash backend interface of the settings store
+ *
+ * The settings store (beginSettings(), settingsWrite(), ...) keeps an
+ * append-only log of key/value records in a ring of flash sectors. It only
+ * needs the NOR flash primitives below, so a board (or the host build) can
+ * plug in its own storage.
+ *
+ * Included from MoeSimpleAT.h; do not include directly.
+ */
+
+#ifndef MOE_SIMPLE_AT_SETTINGS_H
+#define MOE_SIMPLE_AT_SETTINGS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ----------------------------
+// Flash backend
+// ----------------------------
+
+/**
+ * @brief NOR flash region used by the settings store.
+ *
+ * Addresses are relative to the start of the region. The store only issues
+ * 4-byte aligned reads and writes whose length is a multiple of 4, from
+ * 4-byte aligned buffers, and relies on NOR semantics: erasing sets every byte to 0xFF, writing can
+ * only clear bits.
+ */
+class SettingsFlash {
+public:
+    virtual ~SettingsFlash() {}
+
+    virtual size_t sectorSize() const = 0;
+    virtual size_t sectorCount() const = 0;
+    virtual bool read(uint32_t addr, void* data, size_t len) = 0;
+    virtual bool write(uint32_t addr, const void* data, size_t len) = 0;
+    virtual bool eraseSector(size_t sector) = 0;
+};
+
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * @brief Host-side flash simulator backed by a file.
+ *
+ * Keeps the image in a file so it survives "reboots" of a host program,
+ * enforces NOR write semantics and counts erase cycles per sector, which
+ * is what wear-levelling checks need.
+ */
+class FileSettingsFlash : public SettingsFlash {
+public:
+    FileSettingsFlash(const char* path, size_t sectorSize = 4096, size_t sectorCount = 2)
+        : secSize(sectorSize), secCount(sectorCount), erases(sectorCount, 0) {
+        file = fopen(path, "r+b");
+        if (!file) {
+            file = fopen(path, "w+b");
+            std::vector<uint8_t> blank(secSize, 0xFF);
+            for (size_t s = 0; file && s < secCount; s++) {
+                fwrite(blank.data(), 1, secSize, file);
+            }
+        }
+    }
+
+    ~FileSettingsFlash() override {
+        if (file) fclose(file);
+    }
+
+    size_t sectorSize() const override { return secSize; }
+    size_t sectorCount() const override { return secCount; }
+
+    bool read(uint32_t addr, void* data, size_t len) override {
+        if (!file || addr + len > secSize * secCount) return false;
+        fseek(file, addr, SEEK_SET);
+        return fread(data, 1, len, file) == len;
+    }
+
+    bool write(uint32_t addr, const void* data, size_t len) override {
+        std::vector<uint8_t> cell(len);
+        if (!read(addr, cell.data(), len)) return false;
+        for (size_t i = 0; i < len; i++) {
+            cell[i] &= ((const uint8_t*)data)[i];  // Programming only clears bits
+        }
+        fseek(file, addr, SEEK_SET);
+        bool ok = fwrite(cell.data(), 1, len, file) == len;
+        fflush(file);
+        return ok;
+    }
+
+    bool eraseSector(size_t sector) override {
+        if (!file || sector >= secCount) return false;
+        std::vector<uint8_t> blank(secSize, 0xFF);
+        fseek(file, sector * secSize, SEEK_SET);
+        bool ok = fwrite(blank.data(), 1, secSize, file) == secSize;
+        fflush(file);
+        erases[sector]++;
+        return ok;
+    }
+
+    uint32_t eraseCount(size_t sector) const {
+        return sector < secCount ? erases[sector] : 0;
+    }
+
+private:
+    FILE* file;
+    size_t secSize;
+    size_t secCount;
+    std::vector<uint32_t> erases;
+};
+
+#endif // !ARDUINO
+
+#endif // MOE_SIMPLE_AT_SETTINGS_H
@@ -0,0 +1,508 @@
+/**
+ * MoeSimpleATTCP.cpp - TCP / Telnet transport for the AT and shell interpreters
+ *
+ * Every client has its own line buffers, mode (AT / shell / log), echo and
+ * result code settings and a bounded transmit buffer. While a client's
+ * input is fed to defaultAT, its state is swapped into the globals the
+ * interpreter uses and atOutput points to the client, so command handlers
+ * work unchanged. Background output (URCs, watch jobs, scripts) stays on
+ * the serial port.
+ */
+
+#include "MoeSimpleATInternal.h"
+
+#if defined(ESP32)
+    #include <WiFi.h>
+    #include <lwip/sockets.h>
+    #include <errno.h>
+#elif defined(ESP8266)
+    #include <ESP8266WiFi.h>
+#elif !defined(ARDUINO)
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+#endif
+
+static_assert(AT_TCP_MAX_CLIENTS > 0, "AT_TCP_MAX_CLIENTS must be positive");
+static_assert(AT_TCP_TX_LEN >= 16, "AT_TCP_TX_LEN must be at least 16");
+
+// ----------------------------
+// Platform backends
+// ----------------------------
+
+#if defined(ESP32) || defined(ESP8266)
+
+class WiFiTCPBackend : public TCPBackend {
+public:
+    WiFiTCPBackend() : server(AT_TCP_PORT) {}
+
+    bool listen(uint16_t port) override {
+        server.begin(port);
+        server.setNoDelay(true);
+        return true;
+    }
+
+    void stop() override {
+        server.stop();
+    }
+
+    int accept() override {
+        WiFiClient client = server.available();
+        if (!client) return -1;
+        for (int i = 0; i < (int)(sizeof(clients) / sizeof(clients[0])); i++) {
+            if (!clients[i]) {
+                clients[i] = client;
+                clients[i].setNoDelay(true);
+                return i;
+            }
+        }
+        client.stop();
+        return -1;
+    }
+
+    int read(int conn, uint8_t* data, size_t len) override {
+        WiFiClient& c = clients[conn];
+        if (c.available()) return c.read(data, len);
+        return c.connected() ? 0 : -1;
+    }
+
+    int write(int conn, const uint8_t* data, size_t len) override {
+        WiFiClient& c = clients[conn];
+        if (!c.connected()) return -1;
+        #if defined(ESP32)
+            // WiFiClient::write() waits for buffer space; send directly instead
+            int n = send(c.fd(), data, len, MSG_DONTWAIT);
+            if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+            return n;
+        #else
+            size_t room = c.availableForWrite();
+            return c.write(data, len < room ? len : room);
+        #endif
+    }
+
+    void disconnect(int conn) override {
+        clients[conn].stop();
+    }
+
+private:
+    WiFiServer server;
+    WiFiClient clients[AT_TCP_MAX_CLIENTS + 1];  // One spare to refuse with
+};
+
+static WiFiTCPBackend platformBackend;
+static TCPBackend* defaultTCPBackend() { return &platformBackend; }
+
+#else
+
+static TCPBackend* defaultTCPBackend() { return nullptr; }
+
+#endif
+
+#if !defined(ARDUINO)
+
+bool PosixTCPBackend::listen(uint16_t port) {
+    stop();
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, 4) < 0) {
+        ::close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    listenFd = fd;
+    return true;
+}
+
+void PosixTCPBackend::stop() {
+    if (listenFd >= 0) ::close(listenFd);
+    listenFd = -1;
+}
+
+int PosixTCPBackend::accept() {
+    if (listenFd < 0) return -1;
+    int fd = ::accept(listenFd, nullptr, nullptr);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+int PosixTCPBackend::read(int conn, uint8_t* data, size_t len) {
+    ssize_t n = recv(conn, data, len, 0);
+    if (n > 0) return (int)n;
+    if (n == 0) return -1;
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+}
+
+int PosixTCPBackend::write(int conn, const uint8_t* data, size_t len) {
+    #ifdef MSG_NOSIGNAL
+        ssize_t n = send(conn, data, len, MSG_NOSIGNAL);
+    #else
+        ssize_t n = send(conn, data, len, 0);
+    #endif
+    if (n >= 0) return (int)n;
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+}
+
+void PosixTCPBackend::disconnect(int conn) {
+    ::close(conn);
+}
+
+#endif // !ARDUINO
+
+// ----------------------------
+// Client sessions
+// ----------------------------
+
+static TCPBackend* tcpBackend = nullptr;
+static bool tcpListening = false;
+static bool tcpTelnet = true;
+static uint16_t tcpPort = 0;
+static TCPStats tcpStats;
+
+// Telnet commands (RFC 854)
+static const uint8_t TELNET_SE = 240;
+static const uint8_t TELNET_SB = 250;
+static const uint8_t TELNET_WILL = 251;
+static const uint8_t TELNET_WONT = 252;
+static const uint8_t TELNET_DO = 253;
+static const uint8_t TELNET_DONT = 254;
+static const uint8_t TELNET_IAC = 255;
+
+enum TelnetState : uint8_t { TN_DATA, TN_IAC, TN_OPTION, TN_SUB, TN_SUB_IAC };
+
+/**
+ * @brief Transmit buffer of one client; what the socket does not take is queued.
+ */
+class TCPClientOutput : public Print {
+public:
+    void reset(int connection, bool telnet) {
+        conn = connection;
+        escapeIAC = telnet;
+        head = count = 0;
+        failed = false;
+    }
+
+    size_t write(uint8_t c) override {
+        if (escapeIAC && c == TELNET_IAC && !put(TELNET_IAC)) return 0;
+        return put(c) ? 1 : 0;
+    }
+
+    size_t write(const uint8_t* data, size_t size) override {
+        for (size_t i = 0; i < size; i++) {
+            write(data[i]);
+        }
+        return size;
+    }
+
+    // Bytes sent as-is (Telnet negotiation)
+    void writeRaw(const uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            put(data[i]);
+        }
+    }
+
+    int availableForWrite() override {
+        return (int)(AT_TCP_TX_LEN - count);
+    }
+
+    // Hand queued bytes to the socket without blocking
+    void flush() override {
+        while (count > 0 && !failed) {
+            size_t chunk = AT_TCP_TX_LEN - head < count ? AT_TCP_TX_LEN - head : count;
+            int n = tcpBackend->write(conn, buf + head, chunk);
+            if (n < 0) failed = true;
+            if (n <= 0) break;
+            head = (head + n) % AT_TCP_TX_LEN;
+            count -= n;
+            tcpStats.txBytes += n;
+        }
+    }
+
+    bool hasFailed() const { return failed; }
+
+    using Print::write;
+
+private:
+    bool put(uint8_t c) {
+        if (count == AT_TCP_TX_LEN) flush();
+        if (count == AT_TCP_TX_LEN) {
+            tcpStats.txDropped++;
+            return false;
+        }
+        buf[(head + count) % AT_TCP_TX_LEN] = c;
+        count++;
+        return true;
+    }
+
+    int conn;
+    bool escapeIAC;
+    bool failed;
+    size_t head;
+    size_t count;
+    uint8_t buf[AT_TCP_TX_LEN];
+};
+
+struct TCPSession {
+    bool used;
+    int conn;
+    ATSession modes;                // Modes and echo of the client; output is always out
+    MoeSimpleATDefault::InputState input;
+    TCPClientOutput out;
+    TelnetState telnet;
+    uint8_t telnetCommand;
+    bool lastCR;
+};
+
+static TCPSession sessions[AT_TCP_MAX_CLIENTS];
+static TCPSession* currentSession = nullptr;
+static ATSession savedModes;
+static MoeSimpleATDefault::InputState* savedInput = nullptr;
+
+static void enterSession(TCPSession& s) {
+    storeATSession(savedModes);
+    loadATSession(s.modes);
+    savedInput = defaultAT.attachInput(&s.input);
+    currentSession = &s;
+}
+
+static void leaveSession(TCPSession& s) {
+    currentSession = nullptr;
+    defaultAT.attachInput(savedInput);
+    storeATSession(s.modes);
+    s.modes.output = &s.out;
+    loadATSession(savedModes);
+}
+
+static void openSession(TCPSession& s, int conn) {
+    s.used = true;
+    s.conn = conn;
+    // Clients echo locally (Telnet line mode, netcat), so echo starts off
+    s.modes = { &s.out, false, false, false, true, false, false };
+    s.input = MoeSimpleATDefault::InputState();
+    s.out.reset(conn, tcpTelnet);
+    s.telnet = TN_DATA;
+    s.lastCR = false;
+    tcpStats.accepted++;
+    tcpStats.clients++;
+
+    s.out.println();
+    s.out.println(AT_WELCOME);
+    s.out.println("ready");
+    s.out.flush();
+}
+
+static void closeSession(TCPSession& s) {
+    tcpBackend->disconnect(s.conn);
+    s.used = false;
+    tcpStats.clients--;
+}
+
+// Strip Telnet commands from the input and refuse every option
+static int telnetFilter(TCPSession& s, uint8_t b) {
+    switch (s.telnet) {
+        case TN_DATA:
+            if (b == TELNET_IAC) {
+                s.telnet = TN_IAC;
+                return -1;
+            }
+            if (b == 0 && s.lastCR) {
+                // CR NUL is a bare carriage return
+                s.lastCR = false;
+                return -1;
+            }
+            s.lastCR = (b == '\r');
+            return b;
+
+        case TN_IAC:
+            s.telnet = TN_DATA;
+            if (b == TELNET_IAC) return b;  // Escaped 0xFF
+            if (b >= TELNET_WILL) {
+                s.telnetCommand = b;
+                s.telnet = TN_OPTION;
+            }
+            else if (b == TELNET_SB) {
+                s.telnet = TN_SUB;
+            }
+            return -1;
+
+        case TN_OPTION: {
+            s.telnet = TN_DATA;
+            uint8_t reply = 0;
+            if (s.telnetCommand == TELNET_DO) reply = TELNET_WONT;
+            else if (s.telnetCommand == TELNET_WILL) reply = TELNET_DONT;
+            if (reply) {
+                uint8_t frame[3] = { TELNET_IAC, reply, b };
+                s.out.writeRaw(frame, sizeof(frame));
+            }
+            return -1;
+        }
+
+        case TN_SUB:
+            if (b == TELNET_IAC) s.telnet = TN_SUB_IAC;
+            return -1;
+
+        default:  // TN_SUB_IAC
+            s.telnet = (b == TELNET_SE) ? TN_DATA : TN_SUB;
+            return -1;
+    }
+}
+
+void serviceTCP() {
+    if (!tcpListening) return;
+
+    // Accept new clients; refuse them when every session is in use
+    for (int tries = 0; tries <= AT_TCP_MAX_CLIENTS; tries++) {
+        int conn = tcpBackend->accept();
+        if (conn < 0) break;
+        TCPSession* slot = nullptr;
+        for (TCPSession& s : sessions) {
+            if (!s.used) {
+                slot = &s;
+                break;
+            }
+        }
+        if (slot) {
+            openSession(*slot, conn);
+        } else {
+            tcpBackend->disconnect(conn);
+            tcpStats.rejected++;
+        }
+    }
+
+    for (TCPSession& s : sessions) {
+        if (!s.used) continue;
+
+        s.out.flush();
+        uint8_t chunk[AT_TCP_RX_CHUNK];
+        int n = tcpBackend->read(s.conn, chunk, sizeof(chunk));
+        if (n < 0 || s.out.hasFailed()) {
+            closeSession(s);
+            continue;
+        }
+        if (n == 0) continue;
+        tcpStats.rxBytes += n;
+
+        enterSession(s);
+        for (int i = 0; i < n; i++) {
+            int c = tcpTelnet ? telnetFilter(s, chunk[i]) : chunk[i];
+            if (c >= 0) defaultAT.feed((char)c);
+        }
+        defaultAT.showPendingPrompt();
+        leaveSession(s);
+        s.out.flush();
+    }
+}
+
+bool tcpServerActive() {
+    return tcpListening;
+}
+
+bool inTCPSession() {
+    return currentSession != nullptr;
+}
+
+void tcpLog(const String& msg) {
+    for (TCPSession& s : sessions) {
+        // The client being served (if any) was already handled by log()
+        if (!s.used || !s.modes.logMode || &s == currentSession) continue;
+        s.out.println(msg);
+        s.out.flush();
+    }
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+bool beginTCPServer(uint16_t port, bool telnet, TCPBackend* backend) {
+    stopTCPServer();
+    if (backend) tcpBackend = backend;
+    if (!tcpBackend) tcpBackend = defaultTCPBackend();
+    if (!tcpBackend || !tcpBackend->listen(port)) return false;
+    tcpListening = true;
+    tcpTelnet = telnet;
+    tcpPort = port;
+    return true;
+}
+
+void stopTCPServer() {
+    if (!tcpListening) return;
+    for (TCPSession& s : sessions) {
+        if (s.used) closeSession(s);
+    }
+    tcpBackend->stop();
+    tcpListening = false;
+    tcpPort = 0;
+}
+
+TCPStats getTCPStats() {
+    return tcpStats;
+}
+
+// ----------------------------
+// AT: AT+TCPSRV
+// ----------------------------
+
+void handleTCPATCommand(const char* cmd) {
+    if (strcmp(cmd, "AT+TCPSRV?") == 0) {
+        // +TCPSRV:<port>,<telnet>,<clients>,<accepted>,<rejected>,<rx bytes>,<tx bytes>,<tx dropped>
+        Print& out = beginATInfo();
+        out.print("+TCPSRV:");
+        out.print(tcpPort);
+        out.print(",");
+        out.print(tcpTelnet ? 1 : 0);
+        out.print(",");
+        out.print(tcpStats.clients);
+        out.print(",");
+        out.print(tcpStats.accepted);
+        out.print(",");
+        out.print(tcpStats.rejected);
+        out.print(",");
+        out.print(tcpStats.rxBytes);
+        out.print(",");
+        out.print(tcpStats.txBytes);
+        out.print(",");
+        out.println(tcpStats.txDropped);
+        sendATResult(AT_RESULT_OK);
+    }
+    else if (strncmp(cmd, "AT+TCPSRV=", 10) == 0 && !inTCPSession()) {
+        // AT+TCPSRV=<port>[,<telnet>] starts, AT+TCPSRV=0 stops
+        char* end;
+        long port = strtol(cmd + 10, &end, 10);
+        bool telnet = true;
+        if (*end == ',') {
+            telnet = end[1] == '1';
+            if ((end[1] != '0' && end[1] != '1') || end[2] != '\0') port = -1;
+        }
+        else if (*end != '\0') {
+            port = -1;
+        }
+
+        if (port == 0) {
+            stopTCPServer();
+            sendATResult(AT_RESULT_OK);
+        }
+        else if (port > 0 && port <= 65535 && beginTCPServer(port, telnet)) {
+            sendATResult(AT_RESULT_OK);
+        }
+        else {
+            sendATResult(AT_RESULT_ERROR);
+        }
+    }
+    else {
+        // Clients cannot restart the server they are connected through
+        sendATResult(AT_RESULT_ERROR);
+    }
+}
@@ -0,0 +1,73 @@
+/**
+ * MoeSimpleATTCP.h - Socket backend interface of the TCP transport
+ *
+ * The TCP transport (beginTCPServer()) serves the AT and shell interpreters
+ * to network clients. It only needs the non-blocking socket primitives
+ * below: the ESP32 / ESP8266 builds use the WiFi library, the host build
+ * uses POSIX sockets.
+ *
+ * Included from MoeSimpleAT.h; do not include directly.
+ */
+
+#ifndef MOE_SIMPLE_AT_TCP_H
+#define MOE_SIMPLE_AT_TCP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ----------------------------
+// Socket backend
+// ----------------------------
+
+/**
+ * @brief Non-blocking TCP listener and its connections.
+ *
+ * Connections are identified by small non-negative handles chosen by the
+ * backend. No call may block.
+ */
+class TCPBackend {
+public:
+    virtual ~TCPBackend() {}
+
+    // Start listening on all interfaces
+    virtual bool listen(uint16_t port) = 0;
+
+    // Stop listening (open connections are closed with disconnect())
+    virtual void stop() = 0;
+
+    // Take a pending connection: its handle, or -1 if none is waiting
+    virtual int accept() = 0;
+
+    // Bytes read, 0 if nothing is pending, -1 once the peer has closed
+    virtual int read(int conn, uint8_t* data, size_t len) = 0;
+
+    // Bytes accepted for sending (possibly fewer than len), -1 on error
+    virtual int write(int conn, const uint8_t* data, size_t len) = 0;
+
+    virtual void disconnect(int conn) = 0;
+};
+
+#if !defined(ARDUINO)
+
+/**
+ * @brief Host-side backend on POSIX sockets (e.g. for loopback tests).
+ */
+class PosixTCPBackend : public TCPBackend {
+public:
+    PosixTCPBackend() : listenFd(-1) {}
+    ~PosixTCPBackend() override { stop(); }
+
+    bool listen(uint16_t port) override;
+    void stop() override;
+    int accept() override;
+    int read(int conn, uint8_t* data, size_t len) override;
+    int write(int conn, const uint8_t* data, size_t len) override;
+    void disconnect(int conn) override;
+
+private:
+    int listenFd;
+};
+
+#endif // !ARDUINO
+
+#endif // MOE_SIMPLE_AT_TCP_H
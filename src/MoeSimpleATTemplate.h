@@ -0,0 +1,759 @@
+/**
+ * MoeSimpleATTemplate.h - Heap-free AT / shell interpreter with compile-time capacities
+ *
+ * MoeSimpleAT<MaxATCommands, MaxShellCommands, LineLen, TxLen> keeps its
+ * command tables, input line buffers and response buffer in fixed arrays,
+ * so it makes no allocations after construction. Each instance has its own
+ * modes, echo settings and output (an ATSession), which it puts into the
+ * globals atOutput, inShellMode, ... while it runs. The free functions of
+ * MoeSimpleAT.h (registerATCommand(), handleATCommands(), ...) are thin
+ * wrappers over the default instance, defaultAT.
+ *
+ * Included from MoeSimpleAT.h; do not include directly.
+ */
+
+#ifndef MOE_SIMPLE_AT_TEMPLATE_H
+#define MOE_SIMPLE_AT_TEMPLATE_H
+
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+// ----------------------------
+// Shared built-ins (implemented in MoeSimpleAT.cpp)
+// ----------------------------
+
+// Run a built-in AT command; cmd is trimmed and upper-cased. false if unknown.
+bool processBuiltinATCommand(const char* cmd);
+
+// Run a built-in shell command; line is trimmed and may be split in place. false if unknown.
+bool processBuiltinShellCommand(char* line);
+
+// Split a shell line in place and run an argv-style handler (or report the syntax error)
+void runShellArgv(char* line, ShellArgvFunction fn, void* context);
+
+// Print the built-in part of the AT+HELP / shell help text
+void printBuiltinATHelp(Print& out);
+void printBuiltinShellHelp(Print& out);
+
+// Transport hooks (MoeSimpleATUart.cpp, MoeSimpleATTrace.cpp)
+void noteSerialRx(uint8_t c);
+void noteRxDiscarded(size_t count);
+void noteRxLineDropped();
+void traceDispatchBegin(bool shell, const char* line);
+void traceDispatchEnd();
+
+// Loop monitor (MoeSimpleATLoop.cpp): time of each command line
+void loopDispatchBegin(const char* line);
+void loopDispatchEnd();
+
+// Input limits (MoeSimpleATLimits.cpp): false once this call's budget is used up,
+// or if a rate limit refuses the line (both counted)
+bool inputBudgetLeft(size_t bytes, size_t lines);
+bool admitInputLine(bool shell, const char* line);
+
+// Query cache (MoeSimpleATCache.cpp): true if cmd was answered from the cache;
+// otherwise *tap is set to the capture of a cacheable query, or nullptr
+bool replayCachedResponse(const char* cmd, Print** tap);
+void endCachedResponse();
+
+// Result code and bandwidth accounting of one command line
+void beginATResponse();
+void noteATBytesSaved(uint32_t bytes);
+void endATTransaction();
+
+// Interpreter state (MoeSimpleAT.cpp): copy the globals atOutput, inShellMode,
+// ... into a session, or set them from one. activeATSession is where the
+// running instance saves its state when another instance takes over.
+extern ATSession* activeATSession;
+void storeATSession(ATSession& session);
+void loadATSession(const ATSession& session);
+
+// ----------------------------
+// Response buffer
+// ----------------------------
+
+/**
+ * @brief Fixed-size Print that collects a response and forwards it in one write.
+ *
+ * Bytes are passed on to the attached sink when the buffer is full and on
+ * flush(). Handlers that block for a long time can call atOutput->flush()
+ * to push partial output out immediately. A tap, if set, gets a copy of
+ * every byte (used by the query cache).
+ */
+template <size_t TxLen>
+class ATResponseBuffer : public Print {
+public:
+    ATResponseBuffer() : sink(nullptr), tap(nullptr), len(0) {}
+
+    void attach(Print* target) {
+        sink = target;
+        len = 0;
+    }
+
+    void setTap(Print* target) {
+        tap = target;
+    }
+
+    size_t write(uint8_t c) override {
+        if (tap) tap->write(c);
+        if (len == TxLen) flushBuffer();
+        buf[len++] = c;
+        return 1;
+    }
+
+    size_t write(const uint8_t* data, size_t size) override {
+        for (size_t i = 0; i < size; i++) {
+            write(data[i]);
+        }
+        return size;
+    }
+
+    int availableForWrite() override {
+        return (int)(TxLen - len);
+    }
+
+    void flush() override {
+        flushBuffer();
+        if (sink) sink->flush();
+    }
+
+    using Print::write;
+
+private:
+    void flushBuffer() {
+        if (sink && len > 0) sink->write(buf, len);
+        len = 0;
+    }
+
+    Print* sink;
+    Print* tap;
+    size_t len;
+    uint8_t buf[TxLen];
+};
+
+// ----------------------------
+// Interpreter instance
+// ----------------------------
+
+template <size_t MaxATCommands, size_t MaxShellCommands, size_t LineLen, size_t TxLen>
+class MoeSimpleAT {
+    static_assert(LineLen >= 8, "LineLen must be at least 8");
+    static_assert(TxLen > 0, "TxLen must be positive");
+
+public:
+    /**
+     * @brief Line buffers and prompt state of one input stream.
+     *
+     * An instance has its own; other transports (e.g. TCP clients) keep one
+     * each and attach it while feeding their input.
+     */
+    struct InputState {
+        InputState()
+            : atLen(0), atPrev(0), atOverflow(false), shellLen(0), shellExpectLF(false),
+              promptShown(false), logLen(0) {}
+
+        char atLine[LineLen];
+        size_t atLen;
+        char atPrev;
+        bool atOverflow;
+
+        char shellLine[LineLen];
+        size_t shellLen;
+        bool shellExpectLF;
+        bool promptShown;
+
+        char logLine[8];
+        size_t logLen;
+    };
+
+    MoeSimpleAT() : atCount(0), shellCount(0), lineCount(0), in(&ownInput) {
+        state = { nullptr, false, false, AT_DEFAULT_ECHO, true, false, true };
+    }
+
+    /**
+     * @brief Saved modes, echo settings and output of the instance.
+     *
+     * Up to date while the instance is not running; while it runs they are
+     * in the globals (atOutput, inShellMode, ...).
+     */
+    ATSession* session() { return &state; }
+
+    /**
+     * @brief Set where the instance prints to (nullptr: atSerial).
+     */
+    void setOutput(Print* output) {
+        if (activeATSession == &state) atOutput = output ? output : atSerial;
+        else state.output = output;
+    }
+
+    /**
+     * @brief Switch to another set of line buffers (nullptr: the instance's own).
+     *
+     * @return The previously attached state
+     */
+    InputState* attachInput(InputState* state) {
+        InputState* previous = in;
+        in = state ? state : &ownInput;
+        return previous;
+    }
+
+    /**
+     * @brief Register an AT command (name without "AT+", matched case-insensitively).
+     *
+     * @return false if the table is full or the name is longer than AT_COMMAND_NAME_LEN - 1
+     */
+    bool registerATCommand(const char* cmd, ATCommandFunction fn, const char* help, void* context = nullptr) {
+        if (atCount >= MaxATCommands || !fn || !cmd || strlen(cmd) >= AT_COMMAND_NAME_LEN) return false;
+        Entry& e = atCommands[atCount];
+        size_t i = 0;
+        for (; cmd[i]; i++) e.name[i] = toupper((unsigned char)cmd[i]);
+        e.name[i] = '\0';
+        e.nameLen = i;
+        e.help = help ? help : "";
+        e.fn = fn;
+        e.argvFn = nullptr;
+        e.context = context;
+        atCount++;
+        return true;
+    }
+
+    /**
+     * @brief Register a shell command (name matched exactly).
+     *
+     * @return false if the table is full or the name is longer than AT_COMMAND_NAME_LEN - 1
+     */
+    bool registerShellCommand(const char* cmd, ShellCommandFunction fn, const char* help, void* context = nullptr) {
+        Entry* e = fn ? addShellCommand(cmd, help, context) : nullptr;
+        if (!e) return false;
+        e->fn = fn;
+        return true;
+    }
+
+    /**
+     * @brief Register a shell command whose handler gets the line split into argc / argv.
+     *
+     * @return false if the table is full or the name is longer than AT_COMMAND_NAME_LEN - 1
+     */
+    bool registerShellCommand(const char* cmd, ShellArgvFunction fn, const char* help, void* context = nullptr) {
+        Entry* e = fn ? addShellCommand(cmd, help, context) : nullptr;
+        if (!e) return false;
+        e->argvFn = fn;
+        return true;
+    }
+
+    size_t atCommandCount() const { return atCount; }
+    size_t shellCommandCount() const { return shellCount; }
+
+    /**
+     * @brief Parse and execute one AT command line (see processATCommand()).
+     */
+    void processATCommand(const char* fullCmd) {
+        char cmd[LineLen];
+        if (copyTrimmed(cmd, fullCmd) == 0) return;
+        SessionScope scope(state);
+
+        // Log mode only respond to EXIT
+        if (inLogMode) {
+            if (strcasecmp(cmd, "EXIT") == 0) {
+                traceDispatchBegin(false, cmd);
+                loopDispatchBegin(cmd);
+                inLogMode = false;
+                sendATResult(AT_RESULT_OK);
+                loopDispatchEnd();
+                traceDispatchEnd();
+            }
+            return;
+        }
+
+        for (char* p = cmd; *p; p++) *p = toupper((unsigned char)*p);
+        traceDispatchBegin(false, cmd);
+        loopDispatchBegin(cmd);
+
+        Print* previous = beginResponse();
+        bool wasShell = inShellMode;
+        beginATResponse();
+
+        // Only the outermost command is cached; nested output is part of its response
+        Print* tap = nullptr;
+        bool cached = (previous != &tx) && replayCachedResponse(cmd, &tap);
+        if (tap) tx.setTap(tap);
+
+        if (cached) {
+            // Answered from the query cache (see setATQueryCache())
+        }
+        else if (strcmp(cmd, "AT+HELP") == 0 || strcmp(cmd, "AT+?") == 0) {
+            printBuiltinATHelp(*atOutput);
+            printATHelp(*atOutput);
+            sendATResult(AT_RESULT_OK);
+        }
+        else if (!processBuiltinATCommand(cmd)) {
+            // Attempt to match user-defined commands
+            const Entry* e = nullptr;
+            if (strncmp(cmd, "AT+", 3) == 0) {
+                for (size_t i = 0; i < atCount; i++) {
+                    if (strncmp(cmd + 3, atCommands[i].name, atCommands[i].nameLen) == 0) {
+                        e = &atCommands[i];
+                        break;
+                    }
+                }
+            }
+            if (e) {
+                e->fn(cmd + 3 + e->nameLen, e->context);
+            } else {
+                sendATResult(AT_RESULT_ERROR);
+            }
+        }
+
+        if (tap) {
+            tx.setTap(nullptr);
+            endCachedResponse();
+        }
+
+        if (!wasShell && inShellMode) {
+            in->promptShown = false;
+            in->shellLen = 0;
+        }
+        endResponse(previous);
+        loopDispatchEnd();
+        traceDispatchEnd();
+    }
+
+    /**
+     * @brief Parse and execute one shell command line (see processShellCommand()).
+     */
+    void processShellCommand(const char* fullCmd) {
+        char cmd[LineLen];
+        if (copyTrimmed(cmd, fullCmd) == 0) return;
+        SessionScope scope(state);
+
+        traceDispatchBegin(true, cmd);
+        loopDispatchBegin(cmd);
+        Print* previous = beginResponse();
+
+        if (strcmp(cmd, "help") == 0 || strcmp(cmd, "HELP") == 0 || strcmp(cmd, "?") == 0) {
+            atOutput->println();
+            printBuiltinShellHelp(*atOutput);
+            printShellHelp(*atOutput);
+        }
+        else if (!processBuiltinShellCommand(cmd)) {
+            char* args = cmd;
+            while (*args && *args != ' ') args++;
+            size_t nameLen = args - cmd;
+            while (*args == ' ') args++;
+
+            // Built-in extended commands are provided by user handlers,
+            // which receive the whole line
+            static const char* const extendedCmds[] = { "ping", "ifconfig", "top", "kill" };
+            bool extended = false;
+            for (const char* name : extendedCmds) {
+                if (strlen(name) == nameLen && strncmp(cmd, name, nameLen) == 0) {
+                    extended = true;
+                    break;
+                }
+            }
+
+            const Entry* e = nullptr;
+            for (size_t i = 0; i < shellCount; i++) {
+                if (shellCommands[i].nameLen == nameLen && strncmp(cmd, shellCommands[i].name, nameLen) == 0) {
+                    e = &shellCommands[i];
+                    break;
+                }
+            }
+
+            if (e && e->argvFn) {
+                runShellArgv(cmd, e->argvFn, e->context);
+            }
+            else if (e) {
+                e->fn(extended && *args ? cmd : args, e->context);
+            } else {
+                atOutput->println(extended ? "msh: applet not found" : "msh: not found");
+            }
+        }
+
+        endResponse(previous);
+        loopDispatchEnd();
+        traceDispatchEnd();
+    }
+
+    /**
+     * @brief Feed one received character in AT mode.
+     */
+    void feedAT(char c) {
+        SessionScope scope(state);
+        if (atEcho) atOutput->write((uint8_t)c);
+        else noteATBytesSaved(1);
+
+        if (c == '\n') {
+            completeATLine();
+            in->atPrev = 0;
+        }
+        else if (c == '\r') {
+            in->atPrev = c;
+        }
+        else {
+            if (in->atPrev == '\r') {
+                appendAT('\r');
+            }
+            appendAT(c);
+            in->atPrev = 0;
+        }
+    }
+
+    /**
+     * @brief Feed one received character in shell mode (line editing and echo).
+     */
+    void feedShell(char c) {
+        SessionScope scope(state);
+        showPendingPrompt();
+
+        // handle line breaks
+        if (c == '\r') {
+            // Received CR, waiting for LF (entering CRLF mode)
+            in->shellExpectLF = true;
+            return;
+        }
+        else if (c == '\n') {
+            // A lone LF and the LF of CRLF both end the line
+            in->shellExpectLF = false;
+
+            if (in->shellLen > 0) {
+                if (shellEcho) {
+                    atOutput->println();  // Line break, end input display
+                } else {
+                    noteATBytesSaved(2);
+                }
+
+                char line[LineLen];
+                memcpy(line, in->shellLine, in->shellLen);
+                line[in->shellLen] = '\0';
+                in->shellLen = 0;
+                lineCount++;
+                if (admitInputLine(true, line)) {
+                    processShellCommand(line);
+                } else {
+                    atOutput->println("msh: busy");
+                }
+                endATTransaction();
+                if (!inShellMode) {
+                    return;
+                }
+            }
+
+            // Output a new prompt
+            atOutput->print("msh> ");
+            in->shellLen = 0;
+        }
+        else {
+            in->shellExpectLF = false;
+
+            if (c == 8 || c == 127) { // Backspace/Delete
+                if (in->shellLen > 0) {
+                    in->shellLen--;
+                    if (shellEcho) atOutput->print("\b \b");
+                    else noteATBytesSaved(3);
+                }
+            }
+            else if (c >= 32 && c < 127) { // Printable
+                if (in->shellLen < LineLen - 1) {
+                    in->shellLine[in->shellLen++] = c;
+                    if (shellEcho) atOutput->print(c);
+                    else noteATBytesSaved(1);
+                }
+                else {
+                    noteRxDiscarded(1);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Feed one received character in log mode (only "EXIT" is recognised).
+     */
+    void feedLog(char c) {
+        SessionScope scope(state);
+        if (c == '\r' || c == '\n') {
+            in->logLine[in->logLen < sizeof(in->logLine) ? in->logLen : sizeof(in->logLine) - 1] = '\0';
+            if (in->logLen < sizeof(in->logLine) && in->logLen > 0) {
+                lineCount++;
+                processATCommand(in->logLine);
+            }
+            in->logLen = 0;
+        }
+        else if (in->logLen < sizeof(in->logLine)) {
+            in->logLine[in->logLen++] = c;
+        }
+        else {
+            noteRxDiscarded(1);
+        }
+    }
+
+    /**
+     * @brief Feed one received character to the interpreter of the current mode.
+     */
+    void feed(char c) {
+        SessionScope scope(state);
+        if (inShellMode) feedShell(c);
+        else if (inLogMode) feedLog(c);
+        else feedAT(c);
+    }
+
+    /**
+     * @brief Print the shell prompt if shell mode was just entered.
+     */
+    void showPendingPrompt() {
+        SessionScope scope(state);
+        if (inShellMode && !in->promptShown) {
+            atOutput->println();
+            atOutput->print("msh> ");
+            in->promptShown = true;
+        }
+    }
+
+    /**
+     * @brief Command lines completed so far (AT, shell and log mode).
+     */
+    size_t linesProcessed() const { return lineCount; }
+
+    /**
+     * @brief Read and process what is available on atSerial in the current mode.
+     *
+     * Stops when the input budget of the call is used up (see setInputBudget()).
+     */
+    void poll() {
+        SessionScope scope(state);
+        size_t bytes = 0;
+        size_t firstLine = lineCount;
+
+        if (inShellMode) {
+            showPendingPrompt();
+            while (inShellMode && atSerial->available() && inputBudgetLeft(bytes, lineCount - firstLine)) {
+                feedShell(readInput());
+                bytes++;
+            }
+            return;
+        }
+
+        if (inLogMode) {
+            while (inLogMode && atSerial->available() && inputBudgetLeft(bytes, lineCount - firstLine)) {
+                feedLog(readInput());
+                bytes++;
+            }
+            return;
+        }
+
+        // Stop at a mode switch (AT+SHELL / AT+LOG / AT+CMUX) so the rest of
+        // the input is handled by the new mode on the next call
+        while (atSerial->available() && !inShellMode && !inLogMode && !isCMUXActive()
+               && inputBudgetLeft(bytes, lineCount - firstLine)) {
+            feedAT(readInput());
+            bytes++;
+        }
+    }
+
+    /**
+     * @brief Start a fresh shell input line and print the prompt.
+     */
+    void startPrompt() {
+        SessionScope scope(state);
+        in->shellLen = 0;
+        atOutput->print("msh> ");
+        in->promptShown = true;
+    }
+
+    /**
+     * @brief Reprint the prompt and the partially typed shell line.
+     */
+    void redrawPrompt() {
+        SessionScope scope(state);
+        if (!inShellMode || !in->promptShown) return;
+        atOutput->print("msh> ");
+        atOutput->write((const uint8_t*)in->shellLine, in->shellLen);
+    }
+
+    /**
+     * @brief Discard partially received AT and shell input.
+     */
+    void resetInput() {
+        in->atLen = 0;
+        in->atPrev = 0;
+        in->atOverflow = false;
+        in->shellLen = 0;
+        in->logLen = 0;
+    }
+
+    /**
+     * @brief Print the custom part of the AT help text.
+     */
+    void printATHelp(Print& out) const {
+        out.print("Custom Commands:\r\n");
+        if (atCount == 0) {
+            out.print("  No custom commands registered.\r\n");
+        }
+        for (size_t i = 0; i < atCount; i++) {
+            out.print("  AT+");
+            out.print(atCommands[i].name);
+            out.print("  - ");
+            out.print(atCommands[i].help);
+            out.print("\r\n");
+        }
+    }
+
+    /**
+     * @brief Print the custom part of the shell help text.
+     */
+    void printShellHelp(Print& out) const {
+        out.print("Custom Commands:\r\n");
+        if (shellCount == 0) {
+            out.print("  No custom shell commands registered.\r\n");
+        }
+        for (size_t i = 0; i < shellCount; i++) {
+            out.print("  ");
+            out.print(shellCommands[i].name);
+            out.print("  - ");
+            out.print(shellCommands[i].help);
+            out.print("\r\n");
+        }
+    }
+
+private:
+    // Makes an instance's state current in the globals for one call; nested
+    // calls into the running instance cost a pointer compare
+    class SessionScope {
+    public:
+        explicit SessionScope(ATSession& own) : own(own), previous(activeATSession) {
+            if (previous == &own) return;
+            storeATSession(*previous);
+            loadATSession(own);
+            activeATSession = &own;
+        }
+
+        ~SessionScope() {
+            if (previous == &own) return;
+            storeATSession(own);
+            loadATSession(*previous);
+            activeATSession = previous;
+        }
+
+    private:
+        ATSession& own;
+        ATSession* previous;
+    };
+
+    struct Entry {
+        char name[AT_COMMAND_NAME_LEN];
+        uint8_t nameLen;
+        const char* help;
+        void (*fn)(const char* args, void* context);
+        ShellArgvFunction argvFn;     // Shell commands registered with argc / argv instead of fn
+        void* context;
+    };
+
+    Entry* addShellCommand(const char* cmd, const char* help, void* context) {
+        if (shellCount >= MaxShellCommands || !cmd || strlen(cmd) >= AT_COMMAND_NAME_LEN) return nullptr;
+        Entry& e = shellCommands[shellCount++];
+        strcpy(e.name, cmd);
+        e.nameLen = strlen(cmd);
+        e.help = help ? help : "";
+        e.fn = nullptr;
+        e.argvFn = nullptr;
+        e.context = context;
+        return &e;
+    }
+
+    static char readInput() {
+        char c = atSerial->read();
+        noteSerialRx(c);
+        return c;
+    }
+
+    // Copy src into dst without surrounding whitespace; returns the length
+    static size_t copyTrimmed(char* dst, const char* src) {
+        while (*src && isspace((unsigned char)*src)) src++;
+        size_t n = strlen(src);
+        while (n > 0 && isspace((unsigned char)src[n - 1])) n--;
+        if (n > LineLen - 1) n = LineLen - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+        return n;
+    }
+
+    void appendAT(char c) {
+        if (in->atLen < LineLen - 1) {
+            in->atLine[in->atLen++] = c;
+        }
+        else {
+            in->atOverflow = true;
+            noteRxDiscarded(1);
+        }
+    }
+
+    void completeATLine() {
+        in->atLine[in->atLen] = '\0';
+        bool blank = true;
+        for (size_t i = 0; i < in->atLen && blank; i++) {
+            blank = isspace((unsigned char)in->atLine[i]);
+        }
+        if (in->atOverflow) {
+            // Never execute a truncated command
+            lineCount++;
+            noteRxDiscarded(in->atLen);
+            noteRxLineDropped();
+            beginATResponse();
+            sendATResult(AT_RESULT_ERROR);
+            endATTransaction();
+        }
+        else if (!blank && !admitInputLine(false, in->atLine)) {
+            lineCount++;
+            beginATResponse();
+            sendATResult(AT_RESULT_BUSY);
+            endATTransaction();
+        }
+        else if (!blank) {
+            lineCount++;
+            processATCommand(in->atLine);
+            endATTransaction();
+        }
+        in->atLen = 0;
+        in->atOverflow = false;
+    }
+
+    // Route atOutput through the response buffer for one command
+    Print* beginResponse() {
+        Print* previous = atOutput;
+        if (previous != &tx) {
+            tx.attach(previous);
+            atOutput = &tx;
+        }
+        return previous;
+    }
+
+    void endResponse(Print* previous) {
+        if (previous == &tx) return;  // Nested command: the outer one flushes
+        tx.flush();
+        // A handler may have redirected output itself (e.g. AT+CMUX)
+        if (atOutput == &tx) atOutput = previous;
+    }
+
+    Entry atCommands[MaxATCommands];
+    Entry shellCommands[MaxShellCommands];
+    size_t atCount;
+    size_t shellCount;
+    size_t lineCount;
+
+    InputState ownInput;
+    InputState* in;
+    ATSession state;
+
+    ATResponseBuffer<TxLen> tx;
+};
+
+/**
+ * @brief Type of the default instance behind the free-function API.
+ */
+typedef MoeSimpleAT<AT_MAX_AT_COMMANDS, AT_MAX_SHELL_COMMANDS, AT_LINE_LEN, AT_TX_LEN> MoeSimpleATDefault;
+
+// Default instance used by registerATCommand(), handleATCommands(), ...
+extern MoeSimpleATDefault defaultAT;
+
+#endif // MOE_SIMPLE_AT_TEMPLATE_H
@@ -0,0 +1,253 @@
+/**
+ * MoeSimpleATTrace.cpp - RX/TX/dispatch trace recorder
+ *
+ * Records are appended to a byte ring; when it is full the oldest records
+ * are dropped whole. RX and TX bytes are collected into bursts first, so a
+ * command line or a response costs one record instead of one per byte.
+ * The bytes come from the serial tap in MoeSimpleATUart.cpp.
+ * Compiled to stubs when AT_TRACE_BUF_LEN is 0.
+ */
+
+#include "MoeSimpleATInternal.h"
+
+void (*traceDispatchObserver)(TraceEventType type, const char* line) = nullptr;
+
+#if AT_TRACE_BUF_LEN > 0
+
+static_assert(AT_TRACE_BUF_LEN >= AT_LINE_LEN + TRACE_RECORD_OVERHEAD, "AT_TRACE_BUF_LEN must hold a command line");
+static_assert(AT_TRACE_BURST_LEN > 0 && AT_TRACE_BURST_LEN + TRACE_RECORD_OVERHEAD <= AT_TRACE_BUF_LEN,
+              "AT_TRACE_BURST_LEN must fit in the trace buffer");
+
+static uint8_t traceRing[AT_TRACE_BUF_LEN];
+static size_t traceHead = 0;         // Oldest record
+static size_t traceCount = 0;        // Bytes used
+static uint32_t traceBaseUs = 0;     // Time of the oldest record
+static uint32_t traceLastUs = 0;     // Time of the newest record
+static uint32_t traceDropped = 0;    // Records dropped to make room
+static bool traceEnabled = false;
+static bool tracePaused = false;     // Set while dumping
+static uint8_t traceMode = 0;
+
+// Pending RX / TX burst
+static uint8_t burst[AT_TRACE_BURST_LEN];
+static size_t burstLen = 0;
+static TraceEventType burstType = TRACE_RX;
+static uint32_t burstUs = 0;
+
+static uint8_t ringAt(size_t i) {
+    return traceRing[(traceHead + i) % AT_TRACE_BUF_LEN];
+}
+
+static uint32_t ringVarint(size_t& i) {
+    uint32_t v = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+        uint8_t b = ringAt(i++);
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+    }
+    return v;
+}
+
+static void dropOldest() {
+    size_t i = 1;
+    ringVarint(i);
+    size_t len = ringVarint(i);
+    i += len;
+    traceHead = (traceHead + i) % AT_TRACE_BUF_LEN;
+    traceCount -= i;
+    traceDropped++;
+
+    // The new oldest record is now the base of the dump
+    if (traceCount > 0) {
+        size_t j = 1;
+        traceBaseUs += ringVarint(j);
+    }
+}
+
+static void ringPush(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        traceRing[(traceHead + traceCount) % AT_TRACE_BUF_LEN] = data[i];
+        traceCount++;
+    }
+}
+
+static void appendRecord(TraceEventType type, uint32_t timeUs, const uint8_t* data, size_t len) {
+    uint8_t header[TRACE_RECORD_OVERHEAD];
+    size_t n = 0;
+    header[n++] = type;
+    n += traceEncodeVarint(header + n, traceCount ? timeUs - traceLastUs : 0);
+    n += traceEncodeVarint(header + n, len);
+    if (n + len > AT_TRACE_BUF_LEN) return;
+
+    while (AT_TRACE_BUF_LEN - traceCount < n + len) {
+        dropOldest();
+    }
+    if (traceCount == 0) traceBaseUs = timeUs;
+    ringPush(header, n);
+    ringPush(data, len);
+    traceLastUs = timeUs;
+}
+
+static void flushBurst() {
+    if (burstLen == 0) return;
+    appendRecord(burstType, burstUs, burst, burstLen);
+    burstLen = 0;
+}
+
+static void traceByte(TraceEventType type, uint8_t c) {
+    if (!traceEnabled || tracePaused) return;
+    if (burstLen > 0 && burstType != type) flushBurst();
+    if (burstLen == 0) {
+        burstType = type;
+        burstUs = micros();
+    }
+    burst[burstLen++] = c;
+    if (burstLen == AT_TRACE_BURST_LEN) flushBurst();
+}
+
+static uint8_t currentMode() {
+    return (inLogMode ? TRACE_MODE_LOG : 0) | (inShellMode ? TRACE_MODE_SHELL : 0)
+           | (isCMUXActive() ? TRACE_MODE_CMUX : 0);
+}
+
+// ----------------------------
+// Hooks
+// ----------------------------
+
+void traceRxByte(uint8_t c) {
+    traceByte(TRACE_RX, c);
+}
+
+void traceTxByte(uint8_t c) {
+    traceByte(TRACE_TX, c);
+}
+
+void traceDispatchBegin(bool shell, const char* line) {
+    TraceEventType type = shell ? TRACE_SHELL_BEGIN : TRACE_AT_BEGIN;
+    if (traceDispatchObserver) traceDispatchObserver(type, line);
+    if (!traceEnabled || tracePaused) return;
+    flushBurst();
+    appendRecord(type, micros(), (const uint8_t*)line, strlen(line));
+}
+
+void traceDispatchEnd() {
+    if (traceDispatchObserver) traceDispatchObserver(TRACE_DISPATCH_END, "");
+    if (!traceEnabled || tracePaused) return;
+    flushBurst();
+    appendRecord(TRACE_DISPATCH_END, micros(), nullptr, 0);
+}
+
+void serviceTrace() {
+    if (!traceEnabled || tracePaused) return;
+    flushBurst();
+    uint8_t mode = currentMode();
+    if (mode != traceMode) {
+        traceMode = mode;
+        appendRecord(TRACE_MODE, micros(), &mode, 1);
+    }
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+void startTrace() {
+    traceHead = traceCount = 0;
+    traceDropped = 0;
+    burstLen = 0;
+    traceEnabled = true;
+    traceMode = currentMode();
+    appendRecord(TRACE_MODE, micros(), &traceMode, 1);
+}
+
+void stopTrace() {
+    flushBurst();
+    traceEnabled = false;
+}
+
+size_t readTrace(uint8_t* out, size_t maxLen, uint32_t* baseUs) {
+    flushBurst();
+    size_t n = traceCount < maxLen ? traceCount : maxLen;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = ringAt(i);
+    }
+    if (baseUs) *baseUs = traceBaseUs;
+    return n;
+}
+
+// ----------------------------
+// AT: AT+TRACE
+// ----------------------------
+
+void handleTraceATCommand(const char* cmd) {
+    if (strcmp(cmd, "AT+TRACE?") == 0) {
+        flushBurst();
+        tracePaused = true;  // The dump itself must not be recorded
+
+        // +TRACE:<enabled>,<bytes>,<dropped records>,<base us>, then hex lines
+        Print& out = beginATInfo();
+        out.print("+TRACE:");
+        out.print(traceEnabled ? 1 : 0);
+        out.print(",");
+        out.print((unsigned long)traceCount);
+        out.print(",");
+        out.print(traceDropped);
+        out.print(",");
+        out.println(traceBaseUs);
+
+        static const char hex[] = "0123456789ABCDEF";
+        for (size_t i = 0; i < traceCount; i++) {
+            uint8_t b = ringAt(i);
+            out.write(hex[b >> 4]);
+            out.write(hex[b & 0x0F]);
+            if (i % 32 == 31 || i == traceCount - 1) out.println();
+        }
+
+        sendATResult(AT_RESULT_OK);
+        atOutput->flush();
+        tracePaused = false;
+    }
+    else if (strcmp(cmd, "AT+TRACE=1") == 0) {
+        startTrace();
+        sendATResult(AT_RESULT_OK);
+    }
+    else if (strcmp(cmd, "AT+TRACE=0") == 0) {
+        stopTrace();
+        sendATResult(AT_RESULT_OK);
+    }
+    else {
+        sendATResult(AT_RESULT_ERROR);
+    }
+}
+
+#else // AT_TRACE_BUF_LEN == 0
+
+void traceRxByte(uint8_t) {}
+
+void traceTxByte(uint8_t) {}
+
+void traceDispatchBegin(bool shell, const char* line) {
+    if (traceDispatchObserver) traceDispatchObserver(shell ? TRACE_SHELL_BEGIN : TRACE_AT_BEGIN, line);
+}
+
+void traceDispatchEnd() {
+    if (traceDispatchObserver) traceDispatchObserver(TRACE_DISPATCH_END, "");
+}
+
+void serviceTrace() {}
+
+void startTrace() {}
+
+void stopTrace() {}
+
+size_t readTrace(uint8_t*, size_t, uint32_t* baseUs) {
+    if (baseUs) *baseUs = 0;
+    return 0;
+}
+
+void handleTraceATCommand(const char*) {
+    // Recorder not compiled in
+    sendATResult(AT_RESULT_ERROR);
+}
+
+#endif // AT_TRACE_BUF_LEN
@@ -0,0 +1,182 @@
+/**
+ * MoeSimpleATTrace.h - Binary trace format (RX/TX bytes, modes, dispatch)
+ *
+ * Record: type (1 byte) | time delta in us (varint) | length (varint) | payload
+ *
+ * The delta is relative to the previous record; the first record of a dump
+ * is at the base time reported by AT+TRACE?. Like the CMUX codec, this file
+ * has no Arduino dependency so host tools can decode device traces.
+ */
+
+#ifndef MOE_SIMPLE_AT_TRACE_H
+#define MOE_SIMPLE_AT_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ----------------------------
+// Record types
+// ----------------------------
+
+enum TraceEventType : uint8_t {
+    TRACE_RX = 1,            // Bytes read from atSerial
+    TRACE_TX = 2,            // Bytes written to atSerial
+    TRACE_MODE = 3,          // 1 byte: TRACE_MODE_* flags after a mode change
+    TRACE_AT_BEGIN = 4,      // AT command line dispatched
+    TRACE_SHELL_BEGIN = 5,   // Shell command line dispatched
+    TRACE_DISPATCH_END = 6   // The command started by the last *_BEGIN returned
+};
+
+#define TRACE_MODE_LOG   0x01
+#define TRACE_MODE_SHELL 0x02
+#define TRACE_MODE_CMUX  0x04
+
+// Largest record header: type + two 5-byte varints
+#define TRACE_RECORD_OVERHEAD 11
+
+/**
+ * @brief Encode an unsigned LEB128 varint.
+ *
+ * @param out Output buffer (at least 5 bytes)
+ * @return Number of bytes written
+ */
+inline size_t traceEncodeVarint(uint8_t* out, uint32_t v) {
+    size_t n = 0;
+    do {
+        out[n] = (v & 0x7F) | (v > 0x7F ? 0x80 : 0);
+        v >>= 7;
+        n++;
+    } while (v);
+    return n;
+}
+
+/**
+ * @brief One decoded record.
+ */
+struct TraceRecord {
+    TraceEventType type;
+    uint32_t timeUs;         // Absolute time (base + deltas)
+    const uint8_t* data;     // Payload, points into the trace buffer
+    size_t len;
+};
+
+/**
+ * @brief Iterates the records of a linear trace dump.
+ */
+class TraceReader {
+public:
+    TraceReader(const uint8_t* trace, size_t len, uint32_t baseUs)
+        : buf(trace), size(len), pos(0), timeUs(baseUs), first(true) {}
+
+    /**
+     * @brief Decode the next record.
+     *
+     * @return false at the end of the trace or on a truncated record
+     */
+    bool next(TraceRecord& r) {
+        if (pos >= size) return false;
+        uint8_t type = buf[pos++];
+        uint32_t delta, len;
+        if (!readVarint(delta) || !readVarint(len) || len > size - pos) {
+            pos = size;
+            return false;
+        }
+        if (!first) timeUs += delta;
+        first = false;
+        r.type = (TraceEventType)type;
+        r.timeUs = timeUs;
+        r.data = buf + pos;
+        r.len = len;
+        pos += len;
+        return true;
+    }
+
+private:
+    bool readVarint(uint32_t& v) {
+        v = 0;
+        for (uint8_t shift = 0; shift < 35 && pos < size; shift += 7) {
+            uint8_t b = buf[pos++];
+            v |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    const uint8_t* buf;
+    size_t size;
+    size_t pos;
+    uint32_t timeUs;
+    bool first;
+};
+
+#if !defined(ARDUINO)
+
+#include <functional>
+
+// ----------------------------
+// Host replay (MoeSimpleATTraceReplay.cpp)
+// ----------------------------
+
+/**
+ * @brief Connects the replayer to the host build's serial and clock mocks.
+ */
+class TraceReplayHooks {
+public:
+    virtual ~TraceReplayHooks() {}
+
+    // Make bytes readable from atSerial
+    virtual void feedRx(const uint8_t* data, size_t len) = 0;
+
+    // Advance the clock behind millis() / micros()
+    virtual void advanceUs(uint32_t us) = 0;
+
+    // Remove and return what was written to atSerial so far
+    virtual size_t takeTx(uint8_t* out, size_t maxLen) = 0;
+};
+
+/**
+ * @brief Recorded and replayed timing of one dispatched command.
+ */
+struct TraceCommandTiming {
+    const char* line;        // Command line (not terminated, see lineLen)
+    size_t lineLen;
+    bool shell;              // Shell command (else AT)
+    uint32_t recordedUs;     // Duration on the device
+    uint32_t replayUs;       // Duration in this replay (host wall clock)
+    bool outputMatched;      // TX so far still equals the recording
+};
+
+/**
+ * @brief Result of a replay.
+ */
+struct TraceReplayReport {
+    uint32_t rxBytes;
+    uint32_t txBytesExpected;
+    uint32_t txBytesActual;
+    uint32_t commands;
+    bool matched;                 // Recorded TX stream reproduced exactly
+    uint32_t firstMismatchOffset; // Offset in the TX stream (if !matched)
+};
+
+/**
+ * @brief Feed a captured trace back through handleATCommands().
+ *
+ * RX bursts are fed at their recorded times, handleATCommands() is called
+ * after each one, and the produced TX stream is compared with the recorded
+ * one. Output the recording does not cover (the reply to AT+TRACE=1 and
+ * everything after the end of the trace) is not compared. Call from a host
+ * build after initATCommands(), with tracing off.
+ *
+ * @param trace     Dump from AT+TRACE? (decoded from hex)
+ * @param len       Dump length
+ * @param baseUs    Base time reported by AT+TRACE?
+ * @param hooks     Serial and clock of the host build
+ * @param onCommand Called for every dispatched command (may be empty)
+ * @return Replay summary
+ */
+TraceReplayReport replayTrace(const uint8_t* trace, size_t len, uint32_t baseUs, TraceReplayHooks& hooks,
+                              const std::function<void(const TraceCommandTiming& timing)>& onCommand);
+
+#endif // !ARDUINO
+
+#endif // MOE_SIMPLE_AT_TRACE_H
@@ -0,0 +1,138 @@
+/**
+ * MoeSimpleATTraceReplay.cpp - Replay a device trace in a host build
+ *
+ * Only compiled for non-Arduino builds, where the serial port and the clock
+ * are mocks that TraceReplayHooks can drive.
+ */
+
+#if !defined(ARDUINO)
+
+#include <chrono>
+#include <vector>
+#include "MoeSimpleATInternal.h"
+
+struct ReplayCommand {
+    const uint8_t* line;
+    size_t lineLen;
+    bool shell;
+    uint32_t recordedBeginUs;
+    uint32_t recordedUs;
+};
+
+// Host timing of the commands dispatched during the replay
+struct ReplayState {
+    typedef std::chrono::steady_clock Clock;
+    std::vector<uint32_t> replayUs;                           // Per command, in dispatch order
+    std::vector<std::pair<size_t, Clock::time_point>> open;   // Commands can nest
+};
+
+static ReplayState* replayState = nullptr;
+
+static void observeDispatch(TraceEventType type, const char* line) {
+    (void)line;
+    ReplayState& st = *replayState;
+    if (type != TRACE_DISPATCH_END) {
+        st.open.push_back({ st.replayUs.size(), ReplayState::Clock::now() });
+        st.replayUs.push_back(0);
+    }
+    else if (!st.open.empty()) {
+        st.replayUs[st.open.back().first] = std::chrono::duration_cast<std::chrono::microseconds>(
+            ReplayState::Clock::now() - st.open.back().second).count();
+        st.open.pop_back();
+    }
+}
+
+TraceReplayReport replayTrace(const uint8_t* trace, size_t len, uint32_t baseUs, TraceReplayHooks& hooks,
+                              const std::function<void(const TraceCommandTiming& timing)>& onCommand) {
+    TraceReplayReport report = { 0, 0, 0, 0, true, 0 };
+
+    // Pass 1: expected TX stream and recorded command durations
+    std::vector<uint8_t> expected;
+    std::vector<ReplayCommand> commands;
+    std::vector<size_t> open;
+    TraceReader reader(trace, len, baseUs);
+    TraceRecord r;
+    bool seenRx = false;
+    while (reader.next(r)) {
+        seenRx = seenRx || r.type == TRACE_RX;
+        if (r.type == TRACE_TX && seenRx) {
+            // Output before the first input is the reply to AT+TRACE=1
+            expected.insert(expected.end(), r.data, r.data + r.len);
+        }
+        else if (r.type == TRACE_AT_BEGIN || r.type == TRACE_SHELL_BEGIN) {
+            open.push_back(commands.size());
+            commands.push_back({ r.data, r.len, r.type == TRACE_SHELL_BEGIN, r.timeUs, 0 });
+        }
+        else if (r.type == TRACE_DISPATCH_END && !open.empty()) {
+            ReplayCommand& c = commands[open.back()];
+            c.recordedUs = r.timeUs - c.recordedBeginUs;
+            open.pop_back();
+        }
+    }
+    report.txBytesExpected = expected.size();
+
+    // Pass 2: feed RX at the recorded times and compare the output
+    ReplayState state;
+    replayState = &state;
+    traceDispatchObserver = observeDispatch;
+
+    std::vector<uint8_t> actual;
+    std::vector<bool> outputMatched;     // Per replayed command, once its RX burst is handled
+    uint8_t chunk[256];
+    auto collect = [&]() {
+        size_t n;
+        while ((n = hooks.takeTx(chunk, sizeof(chunk))) > 0) {
+            actual.insert(actual.end(), chunk, chunk + n);
+        }
+        // Output past the recording (e.g. the AT+TRACE? dump) is not compared
+        for (size_t i = report.txBytesActual; i < actual.size() && i < expected.size() && report.matched; i++) {
+            if (actual[i] != expected[i]) {
+                report.matched = false;
+                report.firstMismatchOffset = i;
+            }
+        }
+        report.txBytesActual = actual.size();
+    };
+
+    TraceReader replay(trace, len, baseUs);
+    uint32_t clockUs = baseUs;
+    while (replay.next(r)) {
+        if (r.type != TRACE_RX) continue;
+        hooks.advanceUs(r.timeUs - clockUs);
+        clockUs = r.timeUs;
+        hooks.feedRx(r.data, r.len);
+        report.rxBytes += r.len;
+        handleATCommands();
+        collect();
+
+        while (outputMatched.size() < state.replayUs.size()) {
+            outputMatched.push_back(report.matched);
+        }
+    }
+    // Let scheduled work and queued output drain
+    handleATCommands();
+    collect();
+    while (outputMatched.size() < state.replayUs.size()) {
+        outputMatched.push_back(report.matched);
+    }
+    if (actual.size() < expected.size() && report.matched) {
+        report.matched = false;
+        report.firstMismatchOffset = actual.size();
+    }
+
+    traceDispatchObserver = nullptr;
+    replayState = nullptr;
+
+    report.commands = commands.size();
+    for (size_t i = 0; i < commands.size(); i++) {
+        TraceCommandTiming t = {
+            (const char*)commands[i].line, commands[i].lineLen, commands[i].shell,
+            commands[i].recordedUs, i < state.replayUs.size() ? state.replayUs[i] : 0,
+            i < outputMatched.size() && outputMatched[i]
+        };
+        if (onCommand) onCommand(t);
+    }
+    return report;
+}
+
+#endif // !ARDUINO
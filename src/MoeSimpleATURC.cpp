@@ -0,0 +1,209 @@
+/**
+ * MoeSimpleATURC.cpp - Unsolicited result code queue
+ *
+ * URC lines are stored in a fixed pool. Each priority has its own ring of
+ * pool indices, so enqueue, dequeue and eviction are O(1); only coalescing
+ * scans the (small) ring of the URC's priority.
+ */
+
+#include "MoeSimpleATInternal.h"
+
+static_assert(AT_URC_QUEUE_LEN > 0 && AT_URC_QUEUE_LEN <= 32, "AT_URC_QUEUE_LEN must be 1..32");
+static_assert(AT_URC_LINE_LEN > 0 && AT_URC_LINE_LEN <= 255, "AT_URC_LINE_LEN must be 1..255");
+
+static const uint8_t URC_PRIORITIES = URC_HIGH + 1;
+
+struct URCEntry {
+    uint8_t typeLen;               // Length of the coalescing key (text before ':')
+    uint8_t length;
+    char line[AT_URC_LINE_LEN + 1];
+};
+
+// Per-priority FIFO of pool indices
+struct URCRing {
+    uint8_t head;
+    uint8_t count;
+    uint8_t slots[AT_URC_QUEUE_LEN];
+};
+
+static URCEntry urcPool[AT_URC_QUEUE_LEN];
+static URCRing urcRings[URC_PRIORITIES];
+static uint32_t urcFreeMask = (AT_URC_QUEUE_LEN == 32) ? 0xFFFFFFFFUL : ((1UL << AT_URC_QUEUE_LEN) - 1);
+static URCOverflowPolicy urcPolicy = URC_DROP_OLDEST;
+static URCStats urcStats = { 0, 0, 0, 0, 0, 0 };
+
+// ----------------------------
+// Ring helpers
+// ----------------------------
+
+static uint8_t ringAt(const URCRing& r, uint8_t i) {
+    return r.slots[(r.head + i) % AT_URC_QUEUE_LEN];
+}
+
+static void ringPush(URCRing& r, uint8_t slot) {
+    r.slots[(r.head + r.count) % AT_URC_QUEUE_LEN] = slot;
+    r.count++;
+}
+
+static uint8_t ringPop(URCRing& r) {
+    uint8_t slot = r.slots[r.head];
+    r.head = (r.head + 1) % AT_URC_QUEUE_LEN;
+    r.count--;
+    return slot;
+}
+
+static void releaseSlot(uint8_t slot) {
+    urcFreeMask |= (1UL << slot);
+    urcStats.pending--;
+}
+
+static int acquireSlot() {
+    if (urcFreeMask == 0) return -1;
+    uint8_t slot = 0;
+    while (!(urcFreeMask & (1UL << slot))) slot++;
+    urcFreeMask &= ~(1UL << slot);
+    urcStats.pending++;
+    if (urcStats.pending > urcStats.highWater) urcStats.highWater = urcStats.pending;
+    return slot;
+}
+
+static uint8_t urcTypeLength(const char* line, uint8_t length) {
+    for (uint8_t i = 0; i < length; i++) {
+        if (line[i] == ':') return i;
+    }
+    return length;
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+bool postURC(const String& line, URCPriority priority) {
+    return postURC(line.c_str(), priority);
+}
+
+bool postURC(const char* line, URCPriority priority) {
+    if (priority > URC_HIGH) priority = URC_HIGH;
+    urcStats.posted++;
+
+    size_t lineLen = strlen(line);
+    uint8_t length = lineLen > AT_URC_LINE_LEN ? AT_URC_LINE_LEN : lineLen;
+    uint8_t typeLen = urcTypeLength(line, length);
+    URCRing& ring = urcRings[priority];
+
+    // Coalesce with a pending URC of the same type: latest value wins
+    for (uint8_t i = 0; i < ring.count; i++) {
+        URCEntry& e = urcPool[ringAt(ring, i)];
+        if (e.typeLen == typeLen && memcmp(e.line, line, typeLen) == 0) {
+            memcpy(e.line, line, length);
+            e.line[length] = '\0';
+            e.length = length;
+            urcStats.coalesced++;
+            return true;
+        }
+    }
+
+    int slot = acquireSlot();
+    if (slot < 0) {
+        if (urcPolicy == URC_DROP_NEWEST) {
+            urcStats.dropped++;
+            return false;
+        }
+        // Evict the oldest URC of the lowest priority that is not above ours
+        for (uint8_t p = 0; p <= priority && slot < 0; p++) {
+            if (urcRings[p].count > 0) {
+                slot = ringPop(urcRings[p]);
+            }
+        }
+        urcStats.dropped++;
+        if (slot < 0) {
+            return false;
+        }
+    }
+
+    URCEntry& e = urcPool[slot];
+    memcpy(e.line, line, length);
+    e.line[length] = '\0';
+    e.length = length;
+    e.typeLen = typeLen;
+    ringPush(ring, slot);
+    return true;
+}
+
+void setURCOverflowPolicy(URCOverflowPolicy policy) {
+    urcPolicy = policy;
+}
+
+URCStats getURCStats() {
+    return urcStats;
+}
+
+// ----------------------------
+// Delivery
+// ----------------------------
+
+void serviceURCQueue() {
+    if (urcStats.pending == 0 || !atOutput) return;
+
+    bool shell = inShellMode;
+    bool wrote = false;
+
+    for (uint8_t n = 0; n < AT_URC_MAX_PER_CALL; n++) {
+        int p = URC_HIGH;
+        while (p >= 0 && urcRings[p].count == 0) p--;
+        if (p < 0) break;
+
+        URCRing& ring = urcRings[p];
+        const URCEntry& e = urcPool[ring.slots[ring.head]];
+
+        // Never block on a slow host: leave the URC queued until the TX FIFO drains
+        if (atOutput->availableForWrite() < (int)e.length + 4) break;
+
+        if (shell && !wrote) {
+            atOutput->println();  // Break the pending prompt line
+        }
+        atOutput->write((const uint8_t*)e.line, e.length);
+        atOutput->println();
+        wrote = true;
+
+        releaseSlot(ringPop(ring));
+        urcStats.delivered++;
+    }
+
+    if (shell && wrote) {
+        redrawShellPrompt();
+    }
+}
+
+void handleURCATCommand(const char* cmd) {
+    if (strcmp(cmd, "AT+URC?") == 0) {
+        Print& out = beginATInfo();
+        out.print("+URC:");
+        out.print(urcStats.posted);
+        out.print(",");
+        out.print(urcStats.delivered);
+        out.print(",");
+        out.print(urcStats.coalesced);
+        out.print(",");
+        out.print(urcStats.dropped);
+        out.print(",");
+        out.print(urcStats.pending);
+        out.print(",");
+        out.println(urcStats.highWater);
+        sendATResult(AT_RESULT_OK);
+    }
+    else if (strncmp(cmd, "AT+URC=", 7) == 0) {
+        // AT+URC=<policy>: 0 = drop oldest, 1 = drop newest
+        char* end;
+        long policy = strtol(cmd + 7, &end, 10);
+        if (end == cmd + 7 || *end != '\0' || (policy != URC_DROP_OLDEST && policy != URC_DROP_NEWEST)) {
+            sendATResult(AT_RESULT_ERROR);
+            return;
+        }
+        setURCOverflowPolicy((URCOverflowPolicy)policy);
+        sendATResult(AT_RESULT_OK);
+    }
+    else {
+        sendATResult(AT_RESULT_ERROR);
+    }
+}
@@ -0,0 +1,635 @@
+/**
+ * MoeSimpleATUart.cpp - UART transport counters and line settings
+ *
+ * Everything read from atSerial passes noteSerialRx() (AT / shell / log
+ * input and the CMUX decoder) and everything written goes through the
+ * serial tap below, so the counters see the raw byte streams in every mode.
+ * The tap also feeds the trace recorder.
+ *
+ * Line settings changes (AT+UART=) are deferred to the end of
+ * handleATCommands() so that the response still goes out at the old rate.
+ */
+
+#include "MoeSimpleATInternal.h"
+
+static_assert(AT_UART_RATE_WINDOW_S > 0, "AT_UART_RATE_WINDOW_S must be at least 1");
+
+// Serial driver features; other cores (e.g. the host tests) can define them
+#if !defined(AT_UART_HAS_UPDATE_BAUD) && (defined(ESP32) || defined(ESP8266))
+    #define AT_UART_HAS_UPDATE_BAUD 1       // updateBaudRate() keeps the port open
+#endif
+#if !defined(AT_UART_HAS_LATCHED_ERRORS) && defined(ESP8266)
+    #define AT_UART_HAS_LATCHED_ERRORS 1    // hasOverrun() / hasRxError()
+#endif
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+    #define AT_UART_HAS_FLOW_CONTROL 1
+#endif
+
+static UARTStats uartStats;
+
+// Bytes per second of the last AT_UART_RATE_WINDOW_S seconds
+static uint32_t rxBuckets[AT_UART_RATE_WINDOW_S];
+static uint32_t txBuckets[AT_UART_RATE_WINDOW_S];
+static size_t bucketIndex = 0;        // Bucket of the current second
+static size_t bucketsFilled = 1;      // Seconds covered so far (up to the window)
+static unsigned long bucketStartMs = 0;
+
+static unsigned long lastLoopMs = 0;
+static bool loopSeen = false;
+
+// Set from the UART driver task on ESP32
+static volatile uint32_t pendingOverruns = 0;
+static volatile uint32_t pendingFramingErrors = 0;
+
+// ----------------------------
+// Serial tap
+// ----------------------------
+
+class SerialTap : public Print {
+public:
+    size_t write(uint8_t c) override {
+        if (!atSerial) return 0;
+        noteTx(c);
+        return atSerial->write(c);
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (!atSerial) return 0;
+        for (size_t i = 0; i < size; i++) {
+            noteTx(buffer[i]);
+        }
+        return atSerial->write(buffer, size);
+    }
+
+    int availableForWrite() override {
+        return atSerial ? atSerial->availableForWrite() : 0;
+    }
+
+    void flush() override {
+        if (atSerial) atSerial->flush();
+    }
+
+private:
+    static void noteTx(uint8_t c) {
+        uartStats.txBytes++;
+        txBuckets[bucketIndex]++;
+        if (c == '\n') uartStats.txLines++;
+        traceTxByte(c);
+    }
+};
+
+static SerialTap serialTap;
+
+Print* atSerialOutput() {
+    return &serialTap;
+}
+
+// ----------------------------
+// Hooks
+// ----------------------------
+
+void noteSerialRx(uint8_t c) {
+    uartStats.rxBytes++;
+    rxBuckets[bucketIndex]++;
+    if (c == '\n') uartStats.rxLines++;
+    traceRxByte(c);
+}
+
+// The interpreter also reports overflows of network clients' lines
+void noteRxDiscarded(size_t count) {
+    if (!inTCPSession()) uartStats.discarded += count;
+}
+
+void noteRxLineDropped() {
+    if (!inTCPSession()) uartStats.droppedLines++;
+}
+
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+static void onUARTError(hardwareSerial_error_t error) {
+    if (error == UART_FIFO_OVF_ERROR || error == UART_BUFFER_FULL_ERROR) {
+        pendingOverruns = pendingOverruns + 1;
+    }
+    else if (error == UART_FRAME_ERROR || error == UART_PARITY_ERROR) {
+        pendingFramingErrors = pendingFramingErrors + 1;
+    }
+}
+#endif
+
+void beginUARTStats() {
+    #if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+        if (atSerial) atSerial->onReceiveError(onUARTError);
+    #endif
+    bucketStartMs = millis();
+}
+
+// Move to the bucket of the current second, clearing the ones skipped
+static void rollRateWindow(unsigned long now) {
+    unsigned long elapsed = now - bucketStartMs;
+    if (elapsed < 1000) return;
+
+    unsigned long steps = elapsed / 1000;
+    if (steps > AT_UART_RATE_WINDOW_S) steps = AT_UART_RATE_WINDOW_S;
+    for (unsigned long i = 0; i < steps; i++) {
+        bucketIndex = (bucketIndex + 1) % AT_UART_RATE_WINDOW_S;
+        rxBuckets[bucketIndex] = 0;
+        txBuckets[bucketIndex] = 0;
+        if (bucketsFilled < AT_UART_RATE_WINDOW_S) bucketsFilled++;
+    }
+    bucketStartMs += (elapsed / 1000) * 1000;
+}
+
+// Average over the full seconds in the window plus the current partial one
+static uint32_t windowRate(const uint32_t* buckets, unsigned long now) {
+    uint32_t bytes = 0;
+    for (size_t i = 0; i < AT_UART_RATE_WINDOW_S; i++) {
+        bytes += buckets[i];
+    }
+    unsigned long spanMs = (bucketsFilled - 1) * 1000UL + (now - bucketStartMs);
+    if (spanMs == 0) return 0;
+    return (uint32_t)((uint64_t)bytes * 1000 / spanMs);
+}
+
+void serviceUARTStats() {
+    unsigned long now = millis();
+
+    // Time the sketch kept us from reading (our own sleeps are not counted)
+    if (loopSeen) {
+        unsigned long gap = now - lastLoopMs;
+        if (gap > uartStats.maxLoopGapMs) uartStats.maxLoopGapMs = gap;
+        if (gap >= AT_UART_SLOW_LOOP_MS) uartStats.slowLoops++;
+    }
+
+    if (atSerial) {
+        int backlog = atSerial->available();
+        if (backlog > 0 && (uint32_t)backlog > uartStats.maxBacklog) uartStats.maxBacklog = backlog;
+
+        #if defined(AT_UART_HAS_LATCHED_ERRORS)
+            // The ESP8266 core latches overruns and RX errors until read
+            if (atSerial->hasOverrun()) uartStats.overruns++;
+            if (atSerial->hasRxError()) uartStats.framingErrors++;
+        #endif
+    }
+
+    if (pendingOverruns || pendingFramingErrors) {
+        uint32_t overruns = pendingOverruns;
+        uint32_t framing = pendingFramingErrors;
+        pendingOverruns = pendingOverruns - overruns;
+        pendingFramingErrors = pendingFramingErrors - framing;
+        uartStats.overruns += overruns;
+        uartStats.framingErrors += framing;
+    }
+
+    rollRateWindow(now);
+}
+
+void endUARTStatsLoop() {
+    lastLoopMs = millis();
+    loopSeen = true;
+}
+
+// ----------------------------
+// User callable functions
+// ----------------------------
+
+UARTStats getUARTStats() {
+    unsigned long now = millis();
+    rollRateWindow(now);
+    UARTStats stats = uartStats;
+    stats.rxBps = windowRate(rxBuckets, now);
+    stats.txBps = windowRate(txBuckets, now);
+    return stats;
+}
+
+void resetUARTStats() {
+    uartStats = UARTStats();
+    for (size_t i = 0; i < AT_UART_RATE_WINDOW_S; i++) {
+        rxBuckets[i] = 0;
+        txBuckets[i] = 0;
+    }
+    bucketIndex = 0;
+    bucketsFilled = 1;
+    bucketStartMs = millis();
+    loopSeen = false;
+}
+
+// ----------------------------
+// Line settings
+// ----------------------------
+
+// Longest wait for input sent at the old settings before a switch goes ahead
+static const unsigned long SWITCH_RX_GRACE_MS = 100;
+
+static UARTConfig uartConfig = { (uint32_t)SERIAL_BAUD_RATE, 8, 1, 0, 0 };
+static UARTConfig pendingConfig;
+static bool switchPending = false;
+static unsigned long switchRequestMs = 0;
+
+// Stored as SETTING_UART_FORMAT
+struct SavedUARTFormat {
+    uint8_t dataBits;
+    uint8_t stopBits;
+    uint8_t parity;
+    uint8_t flowControl;
+};
+
+// Arduino serial formats by [data bits - MIN_DATA_BITS][parity][1 or 2 stop bits]
+#if defined(ESP32) || defined(ESP8266) || defined(SERIAL_5N1)
+static const uint8_t MIN_DATA_BITS = 5;
+static const uint32_t serialFormats[][3][2] = {
+    { { SERIAL_5N1, SERIAL_5N2 }, { SERIAL_5O1, SERIAL_5O2 }, { SERIAL_5E1, SERIAL_5E2 } },
+    { { SERIAL_6N1, SERIAL_6N2 }, { SERIAL_6O1, SERIAL_6O2 }, { SERIAL_6E1, SERIAL_6E2 } },
+    { { SERIAL_7N1, SERIAL_7N2 }, { SERIAL_7O1, SERIAL_7O2 }, { SERIAL_7E1, SERIAL_7E2 } },
+    { { SERIAL_8N1, SERIAL_8N2 }, { SERIAL_8O1, SERIAL_8O2 }, { SERIAL_8E1, SERIAL_8E2 } }
+};
+#else
+static const uint8_t MIN_DATA_BITS = 7;
+static const uint32_t serialFormats[][3][2] = {
+    { { SERIAL_7N1, SERIAL_7N2 }, { SERIAL_7O1, SERIAL_7O2 }, { SERIAL_7E1, SERIAL_7E2 } },
+    { { SERIAL_8N1, SERIAL_8N2 }, { SERIAL_8O1, SERIAL_8O2 }, { SERIAL_8E1, SERIAL_8E2 } }
+};
+#endif
+
+// Arduino serial format of a configuration, false if this board cannot do it
+static bool serialFormat(const UARTConfig& config, uint32_t* format) {
+    if (config.dataBits < MIN_DATA_BITS || config.dataBits > 8) return false;
+    if (config.stopBits != 1 && config.stopBits != 3) return false;  // No 1.5 stop bits in the Arduino API
+    if (config.parity > 2) return false;
+
+    *format = serialFormats[config.dataBits - MIN_DATA_BITS][config.parity][config.stopBits == 3 ? 1 : 0];
+    return true;
+}
+
+static bool flowControlSupported(uint8_t flowControl) {
+    if (flowControl == 0) return true;
+    if (flowControl > 3) return false;
+    #if defined(AT_UART_HAS_FLOW_CONTROL)
+        if ((flowControl & 1) && AT_UART_RTS_PIN < 0) return false;
+        if ((flowControl & 2) && AT_UART_CTS_PIN < 0) return false;
+        return true;
+    #else
+        return false;
+    #endif
+}
+
+static bool sameFormat(const UARTConfig& a, const UARTConfig& b) {
+    return a.dataBits == b.dataBits && a.stopBits == b.stopBits
+        && a.parity == b.parity && a.flowControl == b.flowControl;
+}
+
+// Reopen atSerial with new settings once pending output has been sent
+static void applyUARTConfig(const UARTConfig& next, bool reopen) {
+    uint32_t format = SERIAL_8N1;
+    if (!atSerial || !serialFormat(next, &format)) return;
+
+    atSerial->flush();
+
+    #if defined(AT_UART_HAS_UPDATE_BAUD)
+        // Only the divider changes: the driver and its buffered input survive
+        if (!reopen && sameFormat(next, uartConfig)) {
+            atSerial->updateBaudRate(next.baud);
+            uartConfig = next;
+            currentBaudRate = next.baud;
+            return;
+        }
+    #else
+        (void)reopen;
+    #endif
+
+    atSerial->end();
+    #if defined(ESP32)
+        if (AT_UART_RX_BUFFER > 0) atSerial->setRxBufferSize(AT_UART_RX_BUFFER);
+        if (AT_UART_TX_BUFFER > 0) atSerial->setTxBufferSize(AT_UART_TX_BUFFER);
+    #elif defined(ESP8266)
+        if (AT_UART_RX_BUFFER > 0) atSerial->setRxBufferSize(AT_UART_RX_BUFFER);
+    #endif
+
+    #if defined(ESP8266)
+        atSerial->begin(next.baud, (SerialConfig)format);
+    #else
+        atSerial->begin(next.baud, format);
+    #endif
+
+    #if defined(AT_UART_HAS_FLOW_CONTROL)
+        #if ESP_ARDUINO_VERSION_MAJOR >= 3
+            static const SerialHwFlowCtrl flowModes[] = {
+                UART_HW_FLOWCTRL_DISABLE, UART_HW_FLOWCTRL_RTS, UART_HW_FLOWCTRL_CTS, UART_HW_FLOWCTRL_CTS_RTS
+            };
+        #else
+            static const uint8_t flowModes[] = {
+                HW_FLOWCTRL_DISABLE, HW_FLOWCTRL_RTS, HW_FLOWCTRL_CTS, HW_FLOWCTRL_CTS_RTS
+            };
+        #endif
+        if (next.flowControl != 0) {
+            atSerial->setPins(-1, -1, AT_UART_CTS_PIN, AT_UART_RTS_PIN);
+        }
+        atSerial->setHwFlowCtrlMode(flowModes[next.flowControl]);
+    #endif
+
+    uartConfig = next;
+    currentBaudRate = next.baud;
+}
+
+// ----------------------------
+// Autobaud
+// ----------------------------
+
+// Rates tried in turn, starting from the current one
+static const uint32_t autobaudRates[] = { 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600 };
+static const size_t AUTOBAUD_RATE_COUNT = sizeof(autobaudRates) / sizeof(autobaudRates[0]);
+
+static bool hunting = false;
+static size_t huntIndex = 0;
+static char huntFirst = 0;          // 'A' / 'a' received at this rate, else 0
+static uint32_t huntErrors = 0;     // framingErrors when this rate was set
+
+static void setHuntRate(size_t index) {
+    huntIndex = index;
+    huntFirst = 0;
+
+    UARTConfig next = uartConfig;
+    next.baud = autobaudRates[index];
+    applyUARTConfig(next, false);
+
+    // Whatever arrived meanwhile was sampled at the wrong rate
+    size_t garbage = 0;
+    while (atSerial && atSerial->available() > 0) {
+        noteSerialRx((uint8_t)atSerial->read());
+        garbage++;
+    }
+    if (garbage > 0) noteRxDiscarded(garbage);
+    huntErrors = uartStats.framingErrors;
+}
+
+static void startAutobaud() {
+    size_t index = 0;
+    while (index < AUTOBAUD_RATE_COUNT && autobaudRates[index] != uartConfig.baud) {
+        index++;
+    }
+    hunting = true;
+    setHuntRate(index < AUTOBAUD_RATE_COUNT ? index : 0);
+}
+
+bool serviceAutobaud() {
+    if (!hunting) return false;
+    if (!atSerial) return true;
+
+    // Line errors mean the rate is wrong even if the bytes happen to look fine
+    if (uartStats.framingErrors != huntErrors) {
+        setHuntRate((huntIndex + 1) % AUTOBAUD_RATE_COUNT);
+        return true;
+    }
+
+    while (atSerial->available() > 0) {
+        char c = (char)atSerial->read();
+        noteSerialRx((uint8_t)c);
+
+        if (c == 'A' || c == 'a') {
+            huntFirst = c;
+        }
+        else if (huntFirst && (c == 'T' || c == 't')) {
+            // Locked: the interpreter sees the "AT" and answers it
+            hunting = false;
+            defaultAT.feed(huntFirst);
+            defaultAT.feed(c);
+            return false;
+        }
+        else if (c == '\r' || c == '\n') {
+            huntFirst = 0;
+        }
+        else {
+            noteRxDiscarded(1);
+            setHuntRate((huntIndex + 1) % AUTOBAUD_RATE_COUNT);
+            return true;
+        }
+    }
+    return true;
+}
+
+bool isUARTAutobaudActive() {
+    return hunting;
+}
+
+// ----------------------------
+// Switch-over
+// ----------------------------
+
+void beginUARTConfig() {
+    UARTConfig saved = uartConfig;
+    saved.baud = (uint32_t)currentBaudRate;
+
+    bool mounted = getSettingsStats().mounted || beginSettings();
+    long savedBaud = 0;
+    if (mounted && settingsRead(SETTING_UART_BAUD, &savedBaud, sizeof(savedBaud)) == sizeof(savedBaud)
+        && savedBaud >= 0) {
+        saved.baud = (uint32_t)savedBaud;
+    }
+    SavedUARTFormat format;
+    if (mounted && settingsRead(SETTING_UART_FORMAT, &format, sizeof(format)) == sizeof(format)) {
+        saved.dataBits = format.dataBits;
+        saved.stopBits = format.stopBits;
+        saved.parity = format.parity;
+        saved.flowControl = format.flowControl;
+    }
+
+    // A setting this build cannot apply (e.g. flow control pins removed) keeps the defaults
+    uint32_t unused;
+    if (!serialFormat(saved, &unused) || !flowControlSupported(saved.flowControl)) {
+        saved = uartConfig;
+        saved.baud = (uint32_t)currentBaudRate;
+    }
+
+    bool autobaud = saved.baud == 0;
+    if (autobaud) saved.baud = (uint32_t)currentBaudRate;
+
+    // The sketch opened atSerial with 8N1 and the core's buffer sizes
+    bool reopen = AT_UART_RX_BUFFER > 0 || AT_UART_TX_BUFFER > 0 || !sameFormat(saved, uartConfig);
+    if (reopen || saved.baud != (uint32_t)currentBaudRate) {
+        applyUARTConfig(saved, reopen);
+    } else {
+        uartConfig.baud = saved.baud;
+    }
+    if (autobaud) startAutobaud();
+}
+
+bool setUARTConfig(const UARTConfig& config, bool save) {
+    uint32_t format;
+    if (!serialFormat(config, &format) || !flowControlSupported(config.flowControl)) return false;
+    if (isCMUXActive()) return false;
+
+    if (save) {
+        long baud = (long)config.baud;
+        SavedUARTFormat saved = { config.dataBits, config.stopBits, config.parity, config.flowControl };
+        if (!settingsWrite(SETTING_UART_BAUD, &baud, sizeof(baud))
+            || !settingsWrite(SETTING_UART_FORMAT, &saved, sizeof(saved))) {
+            return false;
+        }
+    }
+
+    pendingConfig = config;
+    switchPending = true;
+    switchRequestMs = millis();
+    return true;
+}
+
+UARTConfig getUARTConfig() {
+    return uartConfig;
+}
+
+void serviceUARTConfig() {
+    if (!switchPending || !atSerial) return;
+
+    // Let the interpreter read what the host sent at the old settings first
+    if (atSerial->available() > 0 && millis() - switchRequestMs < SWITCH_RX_GRACE_MS) return;
+
+    switchPending = false;
+    hunting = false;
+    UARTConfig next = pendingConfig;
+    bool autobaud = next.baud == 0;
+    if (autobaud) next.baud = uartConfig.baud;
+    applyUARTConfig(next, false);
+    if (autobaud) startAutobaud();
+}
+
+// ----------------------------
+// Shell: uartstat
+// ----------------------------
+
+void handleUARTStatCommand(int argc, char* argv[], void*) {
+    if (argc == 2 && strcmp(argv[1], "-r") == 0) {
+        resetUARTStats();
+        return;
+    }
+    if (argc > 1) {
+        atOutput->println("Usage: uartstat [-r]");
+        return;
+    }
+
+    UARTStats s = getUARTStats();
+    atOutput->print("baud:        ");
+    atOutput->println(currentBaudRate);
+    atOutput->print("rx:          ");
+    atOutput->print(s.rxBytes);
+    atOutput->print(" bytes, ");
+    atOutput->print(s.rxLines);
+    atOutput->print(" lines, ");
+    atOutput->print(s.rxBps);
+    atOutput->println(" B/s");
+    atOutput->print("tx:          ");
+    atOutput->print(s.txBytes);
+    atOutput->print(" bytes, ");
+    atOutput->print(s.txLines);
+    atOutput->print(" lines, ");
+    atOutput->print(s.txBps);
+    atOutput->println(" B/s");
+    atOutput->print("max backlog: ");
+    atOutput->print(s.maxBacklog);
+    atOutput->println(" bytes");
+    atOutput->print("overruns:    ");
+    atOutput->println(s.overruns);
+    atOutput->print("rx errors:   ");
+    atOutput->println(s.framingErrors);
+    atOutput->print("discarded:   ");
+    atOutput->print(s.discarded);
+    atOutput->print(" bytes, ");
+    atOutput->print(s.droppedLines);
+    atOutput->println(" lines");
+    atOutput->print("loop gap:    ");
+    atOutput->print(s.maxLoopGapMs);
+    atOutput->print(" ms max, ");
+    atOutput->print(s.slowLoops);
+    atOutput->print(" over ");
+    atOutput->print(AT_UART_SLOW_LOOP_MS);
+    atOutput->println(" ms");
+}
+
+// ----------------------------
+// AT: AT+UART
+// ----------------------------
+
+void handleUARTATCommand(const char* cmd) {
+    if (strcmp(cmd, "AT+UART?") == 0) {
+        // +UART:<baud>,<databits>,<stopbits>,<parity>,<flow>
+        UARTConfig c = getUARTConfig();
+        const uint32_t values[] = { c.baud, c.dataBits, c.stopBits, c.parity, c.flowControl };
+        Print& out = beginATInfo();
+        out.print("+UART:");
+        for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+            if (i > 0) out.print(",");
+            out.print(values[i]);
+        }
+        out.println();
+        sendATResult(AT_RESULT_OK);
+        return;
+    }
+    if (strncmp(cmd, "AT+UART=", 8) != 0) {
+        sendATResult(AT_RESULT_ERROR);
+        return;
+    }
+
+    // <baud> alone keeps the current format
+    long values[5];
+    size_t count = 0;
+    const char* p = cmd + 8;
+    while (count < 5) {
+        char* end;
+        values[count++] = strtol(p, &end, 10);
+        if (end == p || values[count - 1] < 0) {
+            sendATResult(AT_RESULT_ERROR);
+            return;
+        }
+        p = end;
+        if (*p != ',') break;
+        p++;
+    }
+    if (*p != '\0' || (count != 1 && count != 5)) {
+        sendATResult(AT_RESULT_ERROR);
+        return;
+    }
+
+    UARTConfig next = getUARTConfig();
+    next.baud = (uint32_t)values[0];
+    if (count == 5) {
+        if (values[1] > 255 || values[2] > 255 || values[3] > 255 || values[4] > 255) {
+            sendATResult(AT_RESULT_ERROR);
+            return;
+        }
+        next.dataBits = (uint8_t)values[1];
+        next.stopBits = (uint8_t)values[2];
+        next.parity = (uint8_t)values[3];
+        next.flowControl = (uint8_t)values[4];
+    }
+
+    // Answered at the old settings, the switch follows at the end of the loop
+    sendATResult(setUARTConfig(next, true) ? AT_RESULT_OK : AT_RESULT_ERROR);
+}
+
+// ----------------------------
+// AT: AT+UARTSTAT
+// ----------------------------
+
+void handleUARTStatATCommand(const char* cmd) {
+    if (strcmp(cmd, "AT+UARTSTAT?") == 0) {
+        // +UARTSTAT:<rx>,<tx>,<rx lines>,<tx lines>,<rx B/s>,<tx B/s>,<max backlog>,
+        //           <overruns>,<rx errors>,<discarded>,<dropped lines>,<max gap ms>,<slow loops>
+        UARTStats s = getUARTStats();
+        const uint32_t values[] = {
+            s.rxBytes, s.txBytes, s.rxLines, s.txLines, s.rxBps, s.txBps, s.maxBacklog,
+            s.overruns, s.framingErrors, s.discarded, s.droppedLines, s.maxLoopGapMs, s.slowLoops
+        };
+        Print& out = beginATInfo();
+        out.print("+UARTSTAT:");
+        for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+            if (i > 0) out.print(",");
+            out.print(values[i]);
+        }
+        out.println();
+        sendATResult(AT_RESULT_OK);
+    }
+    else if (strcmp(cmd, "AT+UARTSTAT=0") == 0) {
+        resetUARTStats();
+        sendATResult(AT_RESULT_OK);
+    }
+    else {
+        sendATResult(AT_RESULT_ERROR);
+    }
+}